@@ -0,0 +1,414 @@
+/*
+* Parsing throughput of objpar.
+*
+* Build with the built-in number decoder:
+*     cc -O2 bench.c -o bench
+*
+* Build with the libc atof/atoi path for comparison:
+*     cc -O2 -DBENCH_LIBC bench.c -o bench_libc
+*
+* Build with threads to measure objpar_parallel scaling:
+*     cc -O2 -DOBJPAR_ENABLE_THREADS bench.c -o bench -lpthread
+*
+* Usage:
+*     bench [--json] [--iterations count] [--synthetic megabytes] [file.obj ...]
+*
+* Without files the OBJ files bundled in data/ are used. --synthetic adds a generated
+* triangle grid of the given size, it can be repeated. Sizes are limited by the 32 bit
+* buffer sizes of objpar, a few GB of text still fit. Every phase is run the given
+* number of times (by default enough to parse about 256MB) and the fastest run is
+* reported. The count phase is objpar_get_size, the fill phase is objpar minus the
+* count phase and the mesh phase is objpar_build_mesh. --json prints one JSON object
+* with all the results so runs can be compared across versions.
+*/
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#if defined(BENCH_LIBC)
+#include <stdlib.h>
+#define objpar_atoi atoi
+#define objpar_atof (float)atof
+#endif
+
+#include "objpar.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+#define BENCH_DEFAULT_BYTES (256.0 * 1024.0 * 1024.0)
+#define BENCH_MAX_INPUTS 64
+
+typedef struct bench_input
+{
+    const char* p_name;
+    char name[64];
+    void* p_data;
+    size_t size;
+} bench_input_t;
+
+typedef struct bench_result
+{
+    double count_seconds;
+    double parse_seconds;
+    double mesh_seconds;
+    double parallel_seconds[5];
+    unsigned int iterations;
+    size_t buffer_size;
+    size_t mesh_size;
+} bench_result_t;
+
+void* open_file(const char* p_file_name, size_t* p_file_size);
+void* generate_obj(size_t size);
+double get_time(void);
+double get_peak_memory(void);
+void run_input(const struct bench_input* p_input, unsigned int iterations, struct bench_result* p_result);
+
+int main(int argc, char** argv)
+{
+    struct bench_input inputs[BENCH_MAX_INPUTS];
+    struct bench_result results[BENCH_MAX_INPUTS];
+    unsigned int input_count;
+    unsigned int iterations;
+    unsigned int json;
+    unsigned int file_count;
+    unsigned int i;
+    const char* p_decoder;
+
+    input_count = 0;
+    iterations = 0;
+    json = 0;
+    file_count = 0;
+
+    for (i = 1; i < (unsigned int)argc && input_count < BENCH_MAX_INPUTS; ++i)
+    {
+        if (strcmp(argv[i], "--json") == 0)
+        {
+            json = 1;
+        }
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < (unsigned int)argc)
+        {
+            iterations = (unsigned int)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < (unsigned int)argc)
+        {
+            size_t megabytes = (size_t)atof(argv[++i]);
+            sprintf(inputs[input_count].name, "synthetic_%luMB", (unsigned long)megabytes);
+            inputs[input_count].p_name = inputs[input_count].name;
+            inputs[input_count].size = megabytes * 1024 * 1024;
+            inputs[input_count].p_data = generate_obj(inputs[input_count].size);
+            input_count += 1;
+        }
+        else
+        {
+            inputs[input_count].p_name = argv[i];
+            inputs[input_count].p_data = open_file(argv[i], &inputs[input_count].size);
+            input_count += 1;
+            file_count += 1;
+        }
+    }
+
+    if (file_count == 0)
+    {
+        static const char* p_default_files[] = {
+            "data/plane.obj", "data/cube.obj", "data/cube_nontri.obj", "data/monkey.obj", "data/teapot.obj"
+        };
+        for (i = 0; i < 5 && input_count < BENCH_MAX_INPUTS; ++i)
+        {
+            inputs[input_count].p_name = p_default_files[i];
+            inputs[input_count].p_data = open_file(p_default_files[i], &inputs[input_count].size);
+            input_count += 1;
+        }
+    }
+
+#if defined(BENCH_LIBC)
+    p_decoder = "libc";
+#else
+    p_decoder = "built-in";
+#endif
+
+    for (i = 0; i < input_count; ++i)
+    {
+        unsigned int input_iterations = iterations;
+        if (input_iterations == 0)
+        {
+            input_iterations = (unsigned int)(BENCH_DEFAULT_BYTES / (double)(inputs[i].size + 1));
+            if (input_iterations < 1)
+                input_iterations = 1;
+            if (input_iterations > 100000)
+                input_iterations = 100000;
+        }
+        run_input(&inputs[i], input_iterations, &results[i]);
+    }
+
+    if (json)
+    {
+        printf("{\n  \"decoder\": \"%s\",\n  \"threads\": %s,\n  \"peak_memory_mb\": %.2f,\n  \"inputs\": [\n",
+            p_decoder,
+#if defined(OBJPAR_ENABLE_THREADS)
+            "true",
+#else
+            "false",
+#endif
+            get_peak_memory() / (1024.0 * 1024.0));
+        for (i = 0; i < input_count; ++i)
+        {
+            struct bench_result* p_result = &results[i];
+            double megabytes = (double)inputs[i].size / (1024.0 * 1024.0);
+
+            printf("    { \"name\": \"%s\", \"bytes\": %lu, \"iterations\": %u, \"buffer_bytes\": %lu, \"mesh_bytes\": %lu,"
+                " \"count_ms\": %.4f, \"fill_ms\": %.4f, \"parse_ms\": %.4f, \"mesh_ms\": %.4f, \"parse_mb_s\": %.2f",
+                inputs[i].p_name, (unsigned long)inputs[i].size, p_result->iterations, (unsigned long)p_result->buffer_size, (unsigned long)p_result->mesh_size,
+                p_result->count_seconds * 1000.0, (p_result->parse_seconds - p_result->count_seconds) * 1000.0,
+                p_result->parse_seconds * 1000.0, p_result->mesh_seconds * 1000.0, megabytes / p_result->parse_seconds);
+#if defined(OBJPAR_ENABLE_THREADS)
+            {
+                unsigned int thread_index;
+                printf(", \"parallel_ms\": [");
+                for (thread_index = 0; thread_index < 5; ++thread_index)
+                {
+                    printf("%s%.4f", thread_index > 0 ? ", " : "", p_result->parallel_seconds[thread_index] * 1000.0);
+                }
+                printf("]");
+            }
+#endif
+            printf(" }%s\n", i + 1 < input_count ? "," : "");
+        }
+        printf("  ]\n}\n");
+    }
+    else
+    {
+        printf("Number decoder: %s\n", p_decoder);
+        for (i = 0; i < input_count; ++i)
+        {
+            struct bench_result* p_result = &results[i];
+            double megabytes = (double)inputs[i].size / (1024.0 * 1024.0);
+
+            printf("%s: %.3f ms per parse, %.2f MB/s (count %.3f ms, fill %.3f ms, mesh %.3f ms, %u runs)\n",
+                inputs[i].p_name, p_result->parse_seconds * 1000.0, megabytes / p_result->parse_seconds,
+                p_result->count_seconds * 1000.0, (p_result->parse_seconds - p_result->count_seconds) * 1000.0,
+                p_result->mesh_seconds * 1000.0, p_result->iterations);
+#if defined(OBJPAR_ENABLE_THREADS)
+            {
+                unsigned int thread_index;
+                for (thread_index = 0; thread_index < 5; ++thread_index)
+                {
+                    printf("%s: %u threads, %.3f ms per parse, %.2f MB/s\n", inputs[i].p_name, 1u << thread_index,
+                        p_result->parallel_seconds[thread_index] * 1000.0, megabytes / p_result->parallel_seconds[thread_index]);
+                }
+            }
+#endif
+        }
+        printf("Peak memory: %.2f MB\n", get_peak_memory() / (1024.0 * 1024.0));
+    }
+
+    for (i = 0; i < input_count; ++i)
+    {
+        free(inputs[i].p_data);
+    }
+    return 0;
+}
+
+void run_input(const struct bench_input* p_input, unsigned int iterations, struct bench_result* p_result)
+{
+    void* p_buffer;
+    void* p_mesh_buffer;
+    objpar_data_t obj_data;
+    objpar_mesh_t obj_mesh;
+    unsigned int iteration;
+    double start;
+    double seconds;
+
+    memset(p_result, 0, sizeof(struct bench_result));
+    p_result->iterations = iterations;
+    p_result->buffer_size = objpar_get_size(p_input->p_data, p_input->size);
+    p_buffer = malloc(p_result->buffer_size);
+    assert(p_buffer != NULL);
+    objpar((const char*)p_input->p_data, p_input->size, p_buffer, &obj_data);
+    p_result->mesh_size = objpar_get_mesh_size(&obj_data);
+    p_mesh_buffer = (p_result->mesh_size > 0 ? malloc(p_result->mesh_size) : NULL);
+
+    /* The fastest run is the least affected by the rest of the system */
+    p_result->count_seconds = 1e30;
+    p_result->parse_seconds = 1e30;
+    p_result->mesh_seconds = (p_mesh_buffer != NULL ? 1e30 : 0.0);
+
+    for (iteration = 0; iteration < iterations; ++iteration)
+    {
+        start = get_time();
+        objpar_get_size(p_input->p_data, p_input->size);
+        seconds = get_time() - start;
+        if (seconds < p_result->count_seconds)
+            p_result->count_seconds = seconds;
+
+        start = get_time();
+        objpar((const char*)p_input->p_data, p_input->size, p_buffer, &obj_data);
+        seconds = get_time() - start;
+        if (seconds < p_result->parse_seconds)
+            p_result->parse_seconds = seconds;
+
+        if (p_mesh_buffer != NULL)
+        {
+            start = get_time();
+            objpar_build_mesh(&obj_data, p_mesh_buffer, &obj_mesh);
+            seconds = get_time() - start;
+            if (seconds < p_result->mesh_seconds)
+                p_result->mesh_seconds = seconds;
+        }
+    }
+
+#if defined(OBJPAR_ENABLE_THREADS)
+    {
+        unsigned int thread_index;
+        for (thread_index = 0; thread_index < 5; ++thread_index)
+        {
+            p_result->parallel_seconds[thread_index] = 1e30;
+            for (iteration = 0; iteration < iterations; ++iteration)
+            {
+                start = get_time();
+                objpar_parallel((const char*)p_input->p_data, p_input->size, p_buffer, &obj_data, 1u << thread_index);
+                seconds = get_time() - start;
+                if (seconds < p_result->parallel_seconds[thread_index])
+                    p_result->parallel_seconds[thread_index] = seconds;
+            }
+        }
+    }
+#endif
+
+    free(p_mesh_buffer);
+    free(p_buffer);
+}
+
+void* generate_obj(size_t size)
+{
+    char* p_data;
+    size_t length;
+    unsigned int grid;
+    unsigned int row;
+    unsigned int column;
+    unsigned int seed;
+
+    /* A square grid of positions, texcoords and normals followed by two
+       triangles per cell. The grid size is estimated from about 190
+       bytes per grid point and the output is cut at the last full line. */
+    p_data = (char*)malloc(size + 256);
+    assert(p_data != NULL);
+    grid = 2;
+    while ((double)(grid + 1) * (grid + 1) * 190.0 < (double)size)
+        grid += 1;
+
+    length = 0;
+    seed = 12345;
+    for (row = 0; row < grid && length < size; ++row)
+    {
+        for (column = 0; column < grid && length < size; ++column)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            length += (size_t)sprintf(p_data + length, "v %f %f %f\n", (float)column * 0.01f, (float)(seed >> 16) * 1e-5f, (float)row * 0.01f);
+        }
+    }
+    for (row = 0; row < grid && length < size; ++row)
+    {
+        for (column = 0; column < grid && length < size; ++column)
+        {
+            length += (size_t)sprintf(p_data + length, "vt %f %f\n", (float)column / grid, (float)row / grid);
+        }
+    }
+    for (row = 0; row < grid && length < size; ++row)
+    {
+        for (column = 0; column < grid && length < size; ++column)
+        {
+            length += (size_t)sprintf(p_data + length, "vn %f %f %f\n", 0.0f, 1.0f, 0.0f);
+        }
+    }
+    for (row = 0; row + 1 < grid && length < size; ++row)
+    {
+        for (column = 0; column + 1 < grid && length < size; ++column)
+        {
+            unsigned int a = row * grid + column + 1;
+            unsigned int b = a + 1;
+            unsigned int c = a + grid;
+            unsigned int d = c + 1;
+            length += (size_t)sprintf(p_data + length, "f %u/%u/%u %u/%u/%u %u/%u/%u\nf %u/%u/%u %u/%u/%u %u/%u/%u\n",
+                a, a, a, c, c, c, b, b, b, b, b, b, c, c, c, d, d, d);
+        }
+    }
+
+    while (length > size)
+    {
+        length -= 1;
+        while (length > 0 && p_data[length - 1] != '\n')
+            length -= 1;
+    }
+    return p_data;
+}
+
+double get_time(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#endif
+}
+
+double get_peak_memory(void)
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return (double)counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return (double)usage.ru_maxrss;
+#else
+    return (double)usage.ru_maxrss * 1024.0;
+#endif
+#endif
+}
+
+void* open_file(const char* p_file_name, size_t* p_file_size)
+{
+    FILE* p_file;
+    void* p_file_data;
+    size_t size;
+    int err;
+
+#if defined(_MSC_VER)
+    fopen_s(&p_file, p_file_name, "rb");
+#else
+    p_file = fopen(p_file_name, "rb");
+#endif
+    assert(p_file != NULL);
+    fseek(p_file, 0L, SEEK_END);
+    size = ftell(p_file);
+    rewind(p_file);
+    p_file_data = malloc(size);
+#if defined(_MSC_VER)
+    fread_s(p_file_data, size, size, 1, p_file);
+#else
+    fread(p_file_data, size, 1, p_file);
+#endif
+    err = ferror(p_file);
+    assert(err == 0);
+    fclose(p_file);
+    *p_file_size = size;
+    return p_file_data;
+}
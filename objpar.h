@@ -11,18 +11,78 @@
 *
 * Simple Wavefront OBJ parser.
 * 
-* Currently it depends on stdlib's atoi and atof. You can provide your own implementation
-* by doing 
+* Numbers are decoded in place by a built-in decoder that doesn't depend on the C locale.
+* Floats are within 1 ULP of the correctly rounded result and exponents (1.5e-3) are
+* supported. On little endian targets digits are consumed 8 at a time, define OBJPAR_NO_SWAR
+* to disable it. You can provide your own implementation by doing
 *
 * `#define objpar_atoi my_atoi`
 * `#define objpar_atof my_atof`
 *
+* In that case every number is copied into a null terminated string before the call.
+*
+* Input that arrives in pieces can be parsed with objpar_stream_init, objpar_stream_feed and
+* objpar_stream_finish. Chunks can be split anywhere, complete lines are parsed as soon as
+* they are fed and the result is returned like objpar_single_pass. objpar_stream_read pulls the
+* input from a struct objpar_reader callback, like a gzip or zstd decompressor, in blocks of
+* OBJPAR_READ_BLOCK_SIZE. With OBJPAR_ENABLE_THREADS the blocks are read on a second thread
+* while the first parses them.
+*
+* objpar_visit parses without any output buffer. Records are handed to the callbacks of a
+* struct objpar_visitor in batches and every other directive is passed as a raw line.
+*
+* Defining OBJPAR_ENABLE_FILE adds objpar_file_open, objpar_file_parse and objpar_file_close.
+* The file is memory mapped and parsed straight from the mapping, pages that have already
+* been parsed are released so only the output stays resident.
+*
+* Parsed data and meshes can be stored in a binary cache with objpar_cache_write and loaded
+* back with objpar_cache_load. Loading only validates the header against the size and
+* objpar_hash of the source and points objpar_data and objpar_mesh into the cache, so a
+* cache mapped with objpar_file_open is usable without copying or parsing anything.
+*
+* Buffer sizes are objpar_size_t and computed in 64 bits. Counts and face indices are 32 bit,
+* inputs that would overflow them make the size query return 0 instead of wrapping around.
+*
+* Line breaks and spaces are searched 16 or 32 bytes at a time with SSE2 or AVX2 when the
+* compiler targets them. Define OBJPAR_NO_SIMD to use the scalar code instead.
+*
+* The single pass parser (objpar_single_pass) grows its own output using malloc and free.
+* These can be replaced the same way with
+*
+* `#define objpar_malloc my_malloc`
+* `#define objpar_free my_free`
+* `#define objpar_realloc my_realloc`
+*
+* or per call by passing a struct objpar_allocator to objpar_single_pass_ex and
+* objpar_stream_init_ex. objpar_realloc is optional, without it objpar_load_model keeps the
+* scratch at the end of the mesh buffer. objpar_arena is a bump allocator whose blocks are
+* reused after objpar_arena_reset, and objpar_load_model parses a file and builds its mesh
+* in one call without a sizing pass, so a batch of files can be loaded into the same memory.
+*
+* With OBJPAR_ENABLE_THREADS objpar_batch_load loads a list of files or buffers on a work
+* stealing pool and hands every model to a completion callback.
+*
 * For now it only supports:
 * - Geometric Vertices.
 * - Vertex Normals.
 * - Texture Vertices
 * - Faces
 *
+* Faces can have any number of corners and a file can mix them. Corners are stored back to
+* back in p_faces as v/vt/vn triples and face i uses the corners from p_face_offsets[i] to
+* p_face_offsets[i + 1]. face_width is the number of corners when every face has the same
+* number of them and 0 otherwise. Negative indices are resolved while parsing and
+* objpar_validate counts the indices that are out of range.
+*
+* o, g, usemtl, s and mtllib lines split the faces into objpar_group ranges with the same
+* object, group, material and smoothing group. Names are null terminated strings in p_names
+* and materials are numbered by first use. Meshes are built material by material and
+* objpar_mesh has one objpar_submesh draw range per material.
+*
+* MTL libraries are parsed with objpar_mtl into a table of objpar_material. Names are interned
+* in a hash table, objpar_mtl_find looks a material up and objpar_mtl_resolve maps every
+* usemtl material of a objpar_data to it.
+*
 * The function objpar_build_mesh will generate a flat array containing the vertex data
 * for the specified objpar_data structure.
 *
@@ -40,6 +100,50 @@
 * texcoord and normal offsets. With this information you can define your vertex input 
 * layout for different graphics API. If an offset has a value of -1 it means that it's 
 * not part of the vertex.
+*
+* objpar_build_indexed_mesh builds the same vertex layout but shares vertices between
+* corners that reference the same v/vt/vn triple. It writes an index buffer of 16 bit
+* indices when there are 65536 vertices or less and 32 bit indices otherwise. The buffer
+* size is provided by objpar_get_indexed_mesh_size, part of it is used as scratch memory.
+*
+* Faces with more than 3 corners are triangulated while the mesh is built. By default a
+* fan is used, which is exact for convex polygons. objpar_build_mesh_ex takes flags,
+* OBJPAR_MESH_EAR_CLIP triangulates concave polygons with ear clipping and
+* OBJPAR_MESH_INDEXED builds the indexed mesh.
+*
+* objpar_build_mesh_ex also takes a struct objpar_vertex_format to write half float positions
+* and texcoords, and octahedral or 10:10:10:2 normals directly. With OBJPAR_MESH_DEINTERLEAVE
+* every attribute gets its own tightly packed stream. Attribute i of a vertex is always at
+* p_vertices + offset + i * stride using the per attribute offset and stride of objpar_mesh.
+* With OBJPAR_ENABLE_THREADS objpar_build_mesh_parallel expands meshes without indices on
+* several threads into the same buffer.
+*
+* OBJPAR_MESH_GENERATE_NORMALS generates area and angle weighted normals that honor smoothing
+* groups for corners without a vn, OBJPAR_MESH_GENERATE_TANGENTS adds MikkTSpace style
+* tangents. Both are computed once per shared vertex before the mesh is expanded. The
+* square roots and arc cosines they need don't depend on libm, you can provide your own with
+*
+* `#define objpar_sqrt my_sqrt`
+* `#define objpar_acos my_acos`
+*
+* objpar_optimize_mesh reorders the triangles of an indexed mesh for the post-transform
+* vertex cache and then the vertices in the order the triangles use them. objpar_mesh_stats
+* reports the ACMR and ATVR of a mesh for a cache of a given size.
+*
+* objpar_build_meshlets splits a mesh into objpar_meshlets clusters of a bounded number of
+* vertices and triangles, each with a bounding sphere and a normal cone for culling.
+*
+* Changes
+* -------
+* - objpar, objpar_parallel, objpar_file_parse, objpar_mtl, objpar_build_mesh,
+*   objpar_build_indexed_mesh, objpar_build_mesh_ex, objpar_cache_write and the
+*   objpar_get_*size macros return objpar_size_t (size_t) instead of unsigned int. Code that
+*   stores the size in an unsigned int keeps working below 4 GB but should use size_t.
+*   A size of 0 is still the error value, it is now also returned when a count would need
+*   2^32 - 1 or more elements or the buffer doesn't fit in size_t.
+* - struct objpar_vertex_format has a tangent_format member. A format filled member by
+*   member has to set it, zero initialized formats get OBJPAR_FORMAT_FLOAT. Caches are
+*   version 3 and older ones are rejected by objpar_cache_load.
 * 
 *
 * Repo: https://github.com/bitnenfer/objpar/
@@ -56,19 +160,196 @@ extern "C"
 {
 #endif
 
-#if !defined(objpar_atoi) || !defined(objpar_atof)
+#if !defined(objpar_malloc) || !defined(objpar_free)
 #include <stdlib.h>
-#define objpar_atoi atoi
-#define objpar_atof (float)atof
+#define objpar_malloc malloc
+#define objpar_free free
+#if !defined(objpar_realloc)
+#define objpar_realloc realloc
+#endif
+#endif
+
+#include <string.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if !defined(OBJPAR_NO_SWAR) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86) || \
+    defined(__aarch64__) || defined(_M_ARM64) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__))
+#define OBJPAR_SWAR 1
+#endif
+
+#if !defined(OBJPAR_NO_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define OBJPAR_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OBJPAR_SSE2 1
+#endif
+#endif
+
+#if defined(OBJPAR_ENABLE_THREADS) || defined(OBJPAR_ENABLE_FILE)
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#if defined(OBJPAR_ENABLE_THREADS)
+#include <pthread.h>
+#endif
+#if defined(OBJPAR_ENABLE_FILE)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+#endif
 #endif
 
+/* long long is not part of C89, the compilers that offer it as an
+   extension are asked for it in a way -pedantic accepts. Where none is
+   known long is used, and the SWAR decoder is left out if it is too short. */
+#if defined(_MSC_VER)
+typedef unsigned __int64 objpar_internal_u64;
+#elif (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L) || (defined(__cplusplus) && __cplusplus >= 201103L)
+typedef unsigned long long objpar_internal_u64;
+#elif defined(__GNUC__) || defined(__clang__)
+__extension__ typedef unsigned long long objpar_internal_u64;
+#else
+#include <limits.h>
+typedef unsigned long objpar_internal_u64;
+#if ULONG_MAX <= 0xFFFFFFFFUL
+#undef OBJPAR_SWAR
+#endif
+#endif
+
+/* 64 bit constants are built from two 32 bit halves, there is no
+   portable suffix for them in C89. */
+#define OBJPAR_INTERNAL_U64(high, low) ((((objpar_internal_u64)(high)) << 32) | (objpar_internal_u64)(low))
+
+typedef size_t objpar_size_t;
+typedef objpar_internal_u64 objpar_hash_t;
+
 #define OBJPAR_NULL(type) ((type*)0)
 
+/* Every function is static so the header can be included anywhere, the
+   ones a file doesn't call shouldn't warn there. */
+#if !defined(OBJPAR_API)
+#if defined(__GNUC__) || defined(__clang__)
+#define OBJPAR_API static __attribute__((unused))
+#else
+#define OBJPAR_API static
+#endif
+#endif
+
 #define OBJPAR_V_IDX 0
 #define OBJPAR_VT_IDX 1
 #define OBJPAR_VN_IDX 2
+#define OBJPAR_CHUNK_SIZE 65536
+#define OBJPAR_MAX_CHUNK_SIZE (64 * 1024 * 1024)
+#define OBJPAR_FACE_CORNERS 16
+#define OBJPAR_ALL_CORNERS 0xFFFFFFFF
+#if !defined(OBJPAR_MAX_THREADS)
+#define OBJPAR_MAX_THREADS 64
+#endif
+#if !defined(OBJPAR_MIN_PARALLEL_SIZE)
+#define OBJPAR_MIN_PARALLEL_SIZE 65536
+#endif
+#if !defined(OBJPAR_READ_BLOCK_SIZE)
+#define OBJPAR_READ_BLOCK_SIZE (1024 * 1024)
+#endif
+#define OBJPAR_READ_ERROR ((objpar_size_t)-1)
+#define OBJPAR_INTERNAL_READ_BLOCKS 4
+#if !defined(OBJPAR_MIN_PARALLEL_CORNERS)
+#define OBJPAR_MIN_PARALLEL_CORNERS 65536
+#endif
+#if !defined(OBJPAR_VISIT_BATCH_SIZE)
+#define OBJPAR_VISIT_BATCH_SIZE 256
+#endif
+#define OBJPAR_INTERNAL_COUNT_RANGE ((objpar_size_t)1 << 30)
+#define OBJPAR_CACHE_MAGIC 0x434A424F
+#define OBJPAR_CACHE_VERSION 3
+#define OBJPAR_CACHE_ALIGNMENT 64
+#define OBJPAR_INTERNAL_CACHE_ARRAYS 12
+#if !defined(OBJPAR_FILE_WINDOW_SIZE)
+#define OBJPAR_FILE_WINDOW_SIZE (64 * 1024 * 1024)
+#endif
 #define objpar_get_size(string, string_size) objpar((const char*)string, string_size, NULL, NULL)
 #define objpar_get_mesh_size(obj_data) objpar_build_mesh(obj_data, NULL, NULL)
+#define objpar_get_indexed_mesh_size(obj_data) objpar_build_indexed_mesh(obj_data, NULL, NULL)
+#define objpar_get_mesh_ex_size(obj_data, flags, p_format) objpar_build_mesh_ex(obj_data, NULL, NULL, flags, p_format)
+#define objpar_get_cache_size(obj_data, obj_mesh) objpar_cache_write(obj_data, obj_mesh, 0, 0, NULL)
+#define objpar_get_mtl_size(pp_strings, p_sizes, library_count) objpar_mtl(pp_strings, p_sizes, library_count, NULL, NULL)
+#define objpar_get_optimize_size(obj_mesh) objpar_optimize_mesh(obj_mesh, 0, NULL)
+#define objpar_get_mesh_stats_size(obj_mesh) objpar_mesh_stats(obj_mesh, 0, NULL, NULL)
+#define objpar_get_meshlets_size(obj_data, obj_mesh, max_vertices, max_triangles) objpar_build_meshlets(obj_data, obj_mesh, max_vertices, max_triangles, NULL, NULL)
+#if !defined(OBJPAR_VERTEX_CACHE_SIZE)
+#define OBJPAR_VERTEX_CACHE_SIZE 16
+#endif
+#define OBJPAR_INTERNAL_MAX_CACHE_SIZE 65536
+#define OBJPAR_MESHLET_MAX_VERTICES 64
+#define OBJPAR_MESHLET_MAX_TRIANGLES 124
+#if !defined(OBJPAR_ARENA_BLOCK_SIZE)
+#define OBJPAR_ARENA_BLOCK_SIZE (16 * 1024 * 1024)
+#endif
+#define OBJPAR_INTERNAL_ARENA_ALIGNMENT 16
+#define OBJPAR_LOAD_OK 0
+#define OBJPAR_LOAD_READ_ERROR 1
+#define OBJPAR_LOAD_PARSE_ERROR 2
+#define OBJPAR_LOAD_MESH_ERROR 3
+#define OBJPAR_MESH_INDEXED 0x1
+#define OBJPAR_MESH_EAR_CLIP 0x2
+#define OBJPAR_MESH_DEINTERLEAVE 0x4
+#define OBJPAR_MESH_GENERATE_NORMALS 0x8
+#define OBJPAR_MESH_GENERATE_TANGENTS 0x10
+#define OBJPAR_FORMAT_FLOAT 0
+#define OBJPAR_FORMAT_HALF 1
+#define OBJPAR_FORMAT_OCT16 2
+#define OBJPAR_FORMAT_SNORM_10_10_10_2 3
+#define OBJPAR_NONE 0xFFFFFFFF
+#define OBJPAR_MAP_AMBIENT 0
+#define OBJPAR_MAP_DIFFUSE 1
+#define OBJPAR_MAP_SPECULAR 2
+#define OBJPAR_MAP_SHININESS 3
+#define OBJPAR_MAP_DISSOLVE 4
+#define OBJPAR_MAP_EMISSIVE 5
+#define OBJPAR_MAP_BUMP 6
+#define OBJPAR_MAP_DISPLACEMENT 7
+#define OBJPAR_MAP_COUNT 8
+#define OBJPAR_INTERNAL_MTL_NEWMTL 1
+#define OBJPAR_INTERNAL_MTL_COLOR 2
+#define OBJPAR_INTERNAL_MTL_NS 3
+#define OBJPAR_INTERNAL_MTL_NI 4
+#define OBJPAR_INTERNAL_MTL_D 5
+#define OBJPAR_INTERNAL_MTL_TR 6
+#define OBJPAR_INTERNAL_MTL_ILLUM 7
+#define OBJPAR_INTERNAL_MTL_MAP 8
+#define OBJPAR_INTERNAL_OBJECT 1
+#define OBJPAR_INTERNAL_GROUP 2
+#define OBJPAR_INTERNAL_MATERIAL 3
+#define OBJPAR_INTERNAL_SMOOTHING 4
+#define OBJPAR_INTERNAL_LIBRARY 5
+#define OBJPAR_INTERNAL_EXPAND_FLOAT 0x1
+#define OBJPAR_INTERNAL_EXPAND_TEXCOORD 0x2
+#define OBJPAR_INTERNAL_EXPAND_NORMAL 0x4
+#define OBJPAR_INTERNAL_EXPAND_FACE_WIDTH 64
+#define OBJPAR_INTERNAL_EXPAND_SCRATCH ((OBJPAR_INTERNAL_EXPAND_FACE_WIDTH - 2) * 3 + OBJPAR_INTERNAL_EXPAND_FACE_WIDTH * 3)
+#define OBJPAR_ABS(x) ((x) < 0 ? -(x) : (x))
+#define objpar_parallel_get_size(string, string_size, thread_count) objpar_parallel((const char*)string, string_size, NULL, NULL, thread_count)
+#define objpar_file_get_size(p_file) objpar_file_parse(p_file, NULL, NULL)
+
+/* Faces between two o, g, usemtl or s lines. Names are offsets into
+   p_names of objpar_data, material is an index into p_materials. Unset
+   names and materials are OBJPAR_NONE, smoothing is 0 when off. */
+typedef struct objpar_group
+{
+    unsigned int face_begin;
+    unsigned int face_count;
+    unsigned int object;
+    unsigned int group;
+    unsigned int material;
+    unsigned int smoothing;
+} objpar_group_t;
 
 typedef struct objpar_data
 {
@@ -77,6 +358,11 @@ typedef struct objpar_data
     float* p_texcoords;
     float* p_normals;
     unsigned int* p_faces;
+    unsigned int* p_face_offsets;
+    struct objpar_group* p_groups;
+    unsigned int* p_materials;
+    unsigned int* p_libraries;
+    char* p_names;
     
     /* Sizes */
     unsigned int position_count;
@@ -87,9 +373,23 @@ typedef struct objpar_data
     unsigned int normal_width;
     unsigned int texcoord_width;
     unsigned int face_width;
+    unsigned int corner_count;
+    unsigned int group_count;
+    unsigned int material_count;
+    unsigned int library_count;
+    unsigned int names_size;
 
 } objpar_data_t;
 
+/* Range of the mesh drawn with one material. first and count are indices
+   for indexed meshes and vertices otherwise. */
+typedef struct objpar_submesh
+{
+    unsigned int first;
+    unsigned int count;
+    unsigned int material;
+} objpar_submesh_t;
+
 typedef struct objpar_mesh
 {
     void* p_vertices;
@@ -98,94 +398,610 @@ typedef struct objpar_mesh
     int position_offset;
     int texcoord_offset;
     int normal_offset;
+
+    /* Only set with OBJPAR_MESH_GENERATE_TANGENTS. Tangents are x, y, z
+       and the bitangent sign in w. */
+    int tangent_offset;
+
+    /* Bytes between two vertices of each attribute. Same as vertex_stride
+       unless the mesh was built with OBJPAR_MESH_DEINTERLEAVE, in that
+       case the offsets point to the start of each stream. */
+    unsigned int position_stride;
+    unsigned int texcoord_stride;
+    unsigned int normal_stride;
+    unsigned int tangent_stride;
+    unsigned int position_format;
+    unsigned int texcoord_format;
+    unsigned int normal_format;
+    unsigned int tangent_format;
+
+    /* Only set by objpar_build_indexed_mesh */
+    void* p_indices;
+    unsigned int index_count;
+    unsigned int index_size;
+
+    /* One range per material in the order they are first used, faces
+       without a material come last. */
+    struct objpar_submesh* p_submeshes;
+    unsigned int submesh_count;
 } objpar_mesh_t;
 
-/* Declaration */
-static unsigned int objpar(const char* p_string, unsigned int string_size, void* p_buffer, struct objpar_data* p_data);
-static unsigned int objpar_build_mesh(const struct objpar_data* p_data, void* p_buffer, struct objpar_mesh* p_mesh);
-static unsigned int objpar_internal_v(const char* p_string, unsigned int* p_index, unsigned int string_size, float** pp_vbuff, unsigned int vertex_width);
-static unsigned int objpar_internal_vn(const char* p_string, unsigned int* p_index, unsigned int string_size, float** pp_nbuff, unsigned int normal_width);
-static unsigned int objpar_internal_vt(const char* p_string, unsigned int* p_index, unsigned int string_size, float** pp_tbuff, unsigned int texcoord_width);
-static unsigned int objpar_internal_f(const char* p_string, unsigned int* p_index, unsigned int string_size, unsigned int** pp_fbuff, unsigned int face_width);
-static unsigned int objpar_internal_comment(const char* p_string, unsigned int* p_index, unsigned int string_size);
-static unsigned int objpar_internal_newline(const char* p_string, unsigned int* p_index, unsigned int string_size, unsigned int* p_space_count);
+/* Post-transform vertex cache statistics of a mesh drawn with a FIFO cache.
+   acmr is the number of vertices transformed per triangle, 3 for a
+   triangle soup and as low as 0.5 for a perfect regular grid. atvr is the
+   number of times each vertex is transformed, 1 is optimal. */
+typedef struct objpar_mesh_stats
+{
+    unsigned int transform_count;
+    unsigned int triangle_count;
+    float acmr;
+    float atvr;
+} objpar_mesh_stats_t;
 
-/* Definition */
-unsigned int objpar(const char* p_string, unsigned int string_size, void* p_buffer, struct objpar_data* p_data)
+/* Cluster of at most max_vertices vertices and max_triangles triangles of
+   one submesh. Corner k of triangle i is mesh vertex
+   p_vertices[vertex_offset + p_triangles[triangle_offset + i * 3 + k]] of
+   objpar_meshlets. center and radius bound the positions. The meshlet
+   faces away from a camera at p when
+   dot(center - p, cone_axis) >= cone_cutoff * length(center - p) + radius,
+   cone_cutoff is 1 when the normals are too spread out to ever cull. */
+typedef struct objpar_meshlet
 {
-    unsigned int index;
+    unsigned int vertex_offset;
+    unsigned int triangle_offset;
+    unsigned int vertex_count;
+    unsigned int triangle_count;
+    unsigned int material;
+    float center[3];
+    float radius;
+    float cone_axis[3];
+    float cone_cutoff;
+} objpar_meshlet_t;
+
+/* Meshlets of a mesh. p_vertices are indices into the vertex buffer of
+   objpar_mesh and p_triangles 8 bit indices into p_vertices. */
+typedef struct objpar_meshlets
+{
+    struct objpar_meshlet* p_meshlets;
+    unsigned int* p_vertices;
+    unsigned char* p_triangles;
+    unsigned int meshlet_count;
     unsigned int vertex_count;
+    unsigned int triangle_count;
+} objpar_meshlets_t;
+
+/* Output format of each vertex attribute, OBJPAR_FORMAT_*. Positions and
+   texcoords can be FLOAT or HALF, normals can also be OCT16 or
+   SNORM_10_10_10_2 and tangents SNORM_10_10_10_2 with the sign in w. */
+typedef struct objpar_vertex_format
+{
+    unsigned int position_format;
+    unsigned int texcoord_format;
+    unsigned int normal_format;
+    unsigned int tangent_format;
+} objpar_vertex_format_t;
+
+/* Material of a MTL library. name and maps are offsets into p_names of
+   objpar_mtl_data, maps are indexed with OBJPAR_MAP_* and are OBJPAR_NONE
+   when unset. Tr is stored as dissolve = 1 - Tr. */
+typedef struct objpar_material
+{
+    unsigned int name;
+    unsigned int illum;
+    float ambient[3];
+    float diffuse[3];
+    float specular[3];
+    float emissive[3];
+    float shininess;
+    float dissolve;
+    float ior;
+    unsigned int maps[OBJPAR_MAP_COUNT];
+} objpar_material_t;
+
+/* Materials of one or more MTL libraries. p_table maps the hash of a
+   name to a material index and is only used by objpar_mtl_find. */
+typedef struct objpar_mtl_data
+{
+    struct objpar_material* p_materials;
+    unsigned int* p_table;
+    char* p_names;
+    unsigned int material_count;
+    unsigned int table_size;
+    unsigned int names_size;
+} objpar_mtl_data_t;
+
+#if defined(OBJPAR_ENABLE_FILE)
+/* Read only view of a file mapped into memory */
+typedef struct objpar_file
+{
+    const char* p_string;
+    objpar_size_t size;
+} objpar_file_t;
+#endif
+
+/* Callbacks of objpar_visit. Every callback receives up to batch_size
+   records of one kind, widths are taken from the first record of each
+   kind. Faces come as corners (v/vt/vn triples) and count + 1 offsets
+   into them. Kinds with a NULL callback are skipped without parsing. */
+typedef struct objpar_visitor
+{
+    void* p_user_data;
+    unsigned int batch_size;
+    void (*p_positions)(void* p_user_data, const float* p_positions, unsigned int count, unsigned int width);
+    void (*p_normals)(void* p_user_data, const float* p_normals, unsigned int count, unsigned int width);
+    void (*p_texcoords)(void* p_user_data, const float* p_texcoords, unsigned int count, unsigned int width);
+    void (*p_faces)(void* p_user_data, const unsigned int* p_faces, const unsigned int* p_face_offsets, unsigned int count);
+    void (*p_directive)(void* p_user_data, const char* p_line, objpar_size_t length);
+} objpar_visitor_t;
+
+typedef struct objpar_internal_visit
+{
+    const struct objpar_visitor* p_visitor;
+    float* p_positions;
+    float* p_normals;
+    float* p_texcoords;
+    unsigned int* p_faces;
+    unsigned int* p_face_offsets;
+    unsigned int position_count;
     unsigned int normal_count;
     unsigned int texcoord_count;
     unsigned int face_count;
-    unsigned int vertex_width;
+    unsigned int position_width;
     unsigned int normal_width;
     unsigned int texcoord_width;
-    unsigned int face_width;
-    unsigned int vertex_buffer_size;
-    unsigned int normal_buffer_size;
-    unsigned int texcoord_buffer_size;
-    unsigned int face_buffer_size;
-    unsigned int total_buffer_size;
-    unsigned int face_comp_count;
-    float* p_vertices;
+    unsigned int corner_count;
+    unsigned int corner_capacity;
+    unsigned int failed;
+    struct objpar_data totals;
+} objpar_internal_visit_t;
+
+/* Normals and tangents generated by objpar_build_mesh_ex. Every corner of
+   p_faces has a slot in a table keyed by v/smoothing/face for normals and
+   by v/vt/normal for tangents, so a vertex shared by many faces is only
+   computed once. Table vectors are stored as separate x, y and z arrays
+   of table_size floats. */
+typedef struct objpar_internal_mesh_gen
+{
+    unsigned int* p_corner_normals;
+    unsigned int* p_corner_tangents;
+    unsigned int* p_normal_keys;
+    unsigned int* p_tangent_keys;
     float* p_normals;
-    float* p_texcoords;
-    unsigned int* p_faces;
-    void* p_curr_buffer;
+    float* p_tangents;
+    objpar_size_t table_size;
+    unsigned int table_mask;
+    unsigned int normal_width;
+} objpar_internal_mesh_gen_t;
 
-    index = 0;
-    vertex_count = 0;
-    normal_count = 0;
-    texcoord_count = 0;
-    face_count = 0;
-    vertex_width = 0;
-    normal_width= 0;
-    texcoord_width = 0;
-    face_width= 0;
-    total_buffer_size = 0;
-    face_comp_count = 3;
-    p_vertices = OBJPAR_NULL(float);
-    p_normals = OBJPAR_NULL(float);
-    p_texcoords = OBJPAR_NULL(float);
-    p_faces = OBJPAR_NULL(unsigned int);
-    p_curr_buffer = OBJPAR_NULL(void);
+/* Corners corner_begin to corner_end of a mesh built without indices. The
+   range starts at face of group, and material is the position of the
+   group's material in the build order. kernel is a combination of
+   OBJPAR_INTERNAL_EXPAND_* for float layouts that are copied with fixed
+   widths, 0 goes through objpar_internal_mesh_vertex. */
+typedef struct objpar_internal_expand
+{
+    const struct objpar_data* p_data;
+    const struct objpar_group* p_groups;
+    const struct objpar_mesh* p_layout;
+    const struct objpar_internal_mesh_gen* p_gen;
+    unsigned int* p_scratch;
+    unsigned int group_count;
+    unsigned int flags;
+    unsigned int kernel;
+    unsigned int material;
+    unsigned int group;
+    unsigned int face;
+    unsigned int corner_begin;
+    unsigned int corner_end;
+    float zero[3];
+} objpar_internal_expand_t;
 
-    /* First count elements to avoid reallocation */
-    while (index < string_size)
-    {
-        unsigned int count;
+/* Triangle reordering state of objpar_optimize_mesh. p_adjacency lists the
+   triangles of each vertex from p_offsets[v] to p_offsets[v + 1], p_live
+   counts the ones not emitted yet and p_stamps is the time a vertex entered
+   the simulated cache. p_stack holds the vertices of emitted triangles,
+   most recent last, to restart from when a fan runs out of triangles. */
+typedef struct objpar_internal_tipsify
+{
+    unsigned int* p_offsets;
+    unsigned int* p_adjacency;
+    unsigned int* p_live;
+    unsigned int* p_stamps;
+    unsigned int* p_stack;
+    unsigned int* p_order;
+    unsigned char* p_emitted;
+    unsigned int cache_size;
+    unsigned int time;
+} objpar_internal_tipsify_t;
 
-        if ((count = objpar_internal_v(p_string, &index, string_size, OBJPAR_NULL(float*), 0)))
-        {
-            vertex_count += 1;
-            vertex_width = count;
-        }
-        else if ((count = objpar_internal_vn(p_string, &index, string_size, OBJPAR_NULL(float*), 0)))
-        {
-            normal_count += 1;
-            normal_width = count;
-        }
-        else if ((count = objpar_internal_vt(p_string, &index, string_size, OBJPAR_NULL(float*), 0)))
-        {
-            texcoord_count += 1;
-            texcoord_width = count;
-        }
-        else if ((count = objpar_internal_f(p_string, &index, string_size, OBJPAR_NULL(unsigned int*), 0)))
-        {
-            face_count += 1;
-            face_width = count;
-        }
-        else if (objpar_internal_comment(p_string, &index, string_size));
-        else objpar_internal_newline(p_string, &index, string_size, 0);
-    }
+/* Header of a binary cache. It's followed by the arrays of objpar_data
+   and objpar_mesh, each one aligned to OBJPAR_CACHE_ALIGNMENT bytes.
+   Offsets are in bytes from the start of the cache, pointers in the
+   stored structures are left as NULL. */
+typedef struct objpar_internal_cache_header
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int header_size;
+    unsigned int has_mesh;
+    objpar_internal_u64 source_size;
+    objpar_internal_u64 source_hash;
+    objpar_internal_u64 offsets[OBJPAR_INTERNAL_CACHE_ARRAYS];
+    struct objpar_data data;
+    struct objpar_mesh mesh;
+} objpar_internal_cache_header_t;
+
+/* Memory callbacks for the parsers that grow their own output. p_realloc
+   receives the size of the block it grows so arenas can copy it without
+   keeping headers, it can be NULL and is then done with p_alloc, memcpy
+   and p_free. p_free can be NULL when memory is released all at once. */
+typedef struct objpar_allocator
+{
+    void* p_user_data;
+    void* (*p_alloc)(void* p_user_data, objpar_size_t size);
+    void* (*p_realloc)(void* p_user_data, void* p_memory, objpar_size_t old_size, objpar_size_t new_size);
+    void (*p_free)(void* p_user_data, void* p_memory);
+} objpar_allocator_t;
+
+typedef struct objpar_internal_block
+{
+    struct objpar_internal_block* p_next;
+    objpar_size_t size;
+    objpar_size_t capacity;
+} objpar_internal_block_t;
+
+/* Bump allocator, allocator is set up by objpar_arena_init to allocate
+   from it. Blocks come from objpar_malloc and are kept by
+   objpar_arena_reset, so loading one file after another reuses the
+   memory of the previous one. p_last can grow in place. */
+typedef struct objpar_arena
+{
+    struct objpar_allocator allocator;
+    struct objpar_internal_block* p_first;
+    struct objpar_internal_block* p_current;
+    void* p_last;
+    objpar_size_t block_size;
+} objpar_arena_t;
+
+/* Parsed data and mesh of objpar_load_model, both buffers come from the
+   allocator that was passed to it. */
+typedef struct objpar_model
+{
+    struct objpar_data data;
+    struct objpar_mesh mesh;
+    void* p_data_buffer;
+    void* p_mesh_buffer;
+} objpar_model_t;
+
+/* Growable output used by the single pass and streaming parsers. Records
+   are appended to a list of chunks and copied once into the final buffer. */
+typedef struct objpar_internal_chunk
+{
+    struct objpar_internal_chunk* p_next;
+    unsigned int size;
+    unsigned int capacity;
+} objpar_internal_chunk_t;
+
+typedef struct objpar_internal_arena
+{
+    struct objpar_internal_chunk* p_first;
+    struct objpar_internal_chunk* p_last;
+    objpar_size_t size;
+} objpar_internal_arena_t;
+
+typedef struct objpar_internal_builder
+{
+    struct objpar_internal_arena vertex_arena;
+    struct objpar_internal_arena normal_arena;
+    struct objpar_internal_arena texcoord_arena;
+    struct objpar_internal_arena face_arena;
+    struct objpar_internal_arena offset_arena;
+    struct objpar_internal_arena group_arena;
+    struct objpar_internal_arena name_arena;
+    struct objpar_data counts;
+    unsigned int position_stride;
+    unsigned int normal_stride;
+    unsigned int texcoord_stride;
+    const struct objpar_allocator* p_allocator;
+    unsigned int mixed_faces;
+    unsigned int failed;
+} objpar_internal_builder_t;
+
+/* Resumable parser state. Complete lines are parsed as soon as they are
+   fed, a line split between two chunks is kept in p_line. */
+typedef struct objpar_stream
+{
+    struct objpar_internal_builder builder;
+    char* p_line;
+    objpar_size_t line_size;
+    objpar_size_t line_capacity;
+} objpar_stream_t;
+
+/* Input of objpar_stream_read, usually a decompressor. p_read writes up
+   to size bytes to p_block and returns how many it wrote, 0 at the end
+   of the input and OBJPAR_READ_ERROR when it fails. */
+typedef struct objpar_reader
+{
+    void* p_user_data;
+    objpar_size_t (*p_read)(void* p_user_data, void* p_block, objpar_size_t size);
+} objpar_reader_t;
+
+#if defined(OBJPAR_ENABLE_THREADS)
+#if defined(_WIN32)
+typedef HANDLE objpar_internal_thread_t;
+typedef SRWLOCK objpar_internal_mutex_t;
+typedef CONDITION_VARIABLE objpar_internal_cond_t;
+#else
+typedef pthread_t objpar_internal_thread_t;
+typedef pthread_mutex_t objpar_internal_mutex_t;
+typedef pthread_cond_t objpar_internal_cond_t;
+#endif
+
+typedef struct objpar_internal_task
+{
+    void (*p_func)(void* p_arg);
+    void* p_arg;
+    objpar_internal_thread_t thread;
+    unsigned int started;
+} objpar_internal_task_t;
+
+/* A newline aligned slice of the input and the data parsed from it */
+typedef struct objpar_internal_range
+{
+    const char* p_string;
+    objpar_size_t begin;
+    objpar_size_t end;
+    struct objpar_data data;
+    unsigned int counted;
+} objpar_internal_range_t;
+
+/* A MTL library and the materials parsed from it */
+typedef struct objpar_internal_mtl_range
+{
+    const char* p_string;
+    objpar_size_t size;
+    struct objpar_mtl_data data;
+} objpar_internal_mtl_range_t;
+
+/* File of objpar_batch_load. p_path is opened with objpar_file_open and
+   needs OBJPAR_ENABLE_FILE, otherwise p_string is parsed. */
+typedef struct objpar_batch_item
+{
+    const char* p_path;
+    const char* p_string;
+    objpar_size_t string_size;
+} objpar_batch_item_t;
+
+/* Files are loaded with objpar_load_model and p_complete is called from
+   the worker thread with an OBJPAR_LOAD_* status for every item, so it
+   must be thread safe. Without p_allocator each worker loads into its own
+   objpar_arena of arena_block_size blocks and the model is only valid
+   during the callback. With it the callback owns the model and releases
+   it with objpar_free_model, p_allocator must be thread safe then. */
+typedef struct objpar_batch
+{
+    const struct objpar_batch_item* p_items;
+    unsigned int item_count;
+    unsigned int thread_count;
+    unsigned int flags;
+    const struct objpar_vertex_format* p_format;
+    const struct objpar_allocator* p_allocator;
+    objpar_size_t arena_block_size;
+    void* p_user_data;
+    void (*p_complete)(void* p_user_data, unsigned int item, unsigned int status, struct objpar_model* p_model);
+} objpar_batch_t;
+
+/* Worker of objpar_batch_load. range packs the first item it has left in
+   the low 32 bits and the end in the high 32 bits, so the owner popping
+   from the front and a thief taking the back half agree with one compare
+   and swap. */
+typedef struct objpar_internal_worker
+{
+    const struct objpar_batch* p_batch;
+    struct objpar_internal_worker* p_workers;
+    volatile objpar_internal_u64 range;
+    struct objpar_arena arena;
+    unsigned int worker_count;
+    unsigned int index;
+    unsigned int loaded_count;
+} objpar_internal_worker_t;
+
+/* Ring of blocks between the reader thread of objpar_stream_read and the
+   parser. Block i is filled while produced - consumed < block count and
+   parsed while produced > consumed, both counters only grow. status is
+   set by the reader when it stops, stop by the parser when it fails. */
+typedef struct objpar_internal_pipe
+{
+    const struct objpar_reader* p_reader;
+    char* p_blocks;
+    objpar_size_t sizes[OBJPAR_INTERNAL_READ_BLOCKS];
+    objpar_internal_mutex_t mutex;
+    objpar_internal_cond_t cond;
+    unsigned int produced;
+    unsigned int consumed;
+    unsigned int status;
+    unsigned int stop;
+} objpar_internal_pipe_t;
+#endif
+
+/* Declaration */
+OBJPAR_API objpar_size_t objpar(const char* p_string, objpar_size_t string_size, void* p_buffer, struct objpar_data* p_data);
+OBJPAR_API void* objpar_single_pass(const char* p_string, objpar_size_t string_size, struct objpar_data* p_data);
+OBJPAR_API void* objpar_single_pass_ex(const char* p_string, objpar_size_t string_size, const struct objpar_allocator* p_allocator, struct objpar_data* p_data);
+OBJPAR_API void objpar_stream_init(struct objpar_stream* p_stream);
+OBJPAR_API void objpar_stream_init_ex(struct objpar_stream* p_stream, const struct objpar_allocator* p_allocator);
+OBJPAR_API unsigned int objpar_stream_feed(struct objpar_stream* p_stream, const void* p_chunk, objpar_size_t chunk_size);
+OBJPAR_API void* objpar_stream_finish(struct objpar_stream* p_stream, struct objpar_data* p_data);
+OBJPAR_API void* objpar_stream_read(const struct objpar_reader* p_reader, const struct objpar_allocator* p_allocator, struct objpar_data* p_data);
+#if defined(OBJPAR_ENABLE_THREADS)
+OBJPAR_API objpar_size_t objpar_parallel(const char* p_string, objpar_size_t string_size, void* p_buffer, struct objpar_data* p_data, unsigned int thread_count);
+OBJPAR_API unsigned int objpar_batch_load(const struct objpar_batch* p_batch);
+OBJPAR_API objpar_size_t objpar_build_mesh_parallel(const struct objpar_data* p_data, void* p_buffer, struct objpar_mesh* p_mesh, unsigned int flags, const struct objpar_vertex_format* p_format, unsigned int thread_count);
+#endif
+#if defined(OBJPAR_ENABLE_FILE)
+OBJPAR_API unsigned int objpar_file_open(const char* p_file_name, struct objpar_file* p_file);
+OBJPAR_API objpar_size_t objpar_file_parse(struct objpar_file* p_file, void* p_buffer, struct objpar_data* p_data);
+OBJPAR_API void objpar_file_close(struct objpar_file* p_file);
+#endif
+OBJPAR_API unsigned int objpar_visit(const char* p_string, objpar_size_t string_size, const struct objpar_visitor* p_visitor);
+OBJPAR_API objpar_size_t objpar_validate(const struct objpar_data* p_data);
+OBJPAR_API objpar_size_t objpar_mtl(const char* const* pp_strings, const objpar_size_t* p_sizes, unsigned int library_count, void* p_buffer, struct objpar_mtl_data* p_mtl);
+OBJPAR_API unsigned int objpar_mtl_find(const struct objpar_mtl_data* p_mtl, const char* p_name);
+OBJPAR_API unsigned int objpar_mtl_resolve(const struct objpar_mtl_data* p_mtl, const struct objpar_data* p_data, unsigned int* p_remap);
+OBJPAR_API objpar_size_t objpar_build_mesh(const struct objpar_data* p_data, void* p_buffer, struct objpar_mesh* p_mesh);
+OBJPAR_API objpar_size_t objpar_build_indexed_mesh(const struct objpar_data* p_data, void* p_buffer, struct objpar_mesh* p_mesh);
+OBJPAR_API objpar_size_t objpar_build_mesh_ex(const struct objpar_data* p_data, void* p_buffer, struct objpar_mesh* p_mesh, unsigned int flags, const struct objpar_vertex_format* p_format);
+OBJPAR_API objpar_size_t objpar_optimize_mesh(struct objpar_mesh* p_mesh, unsigned int cache_size, void* p_scratch);
+OBJPAR_API objpar_size_t objpar_mesh_stats(const struct objpar_mesh* p_mesh, unsigned int cache_size, void* p_scratch, struct objpar_mesh_stats* p_stats);
+OBJPAR_API unsigned int objpar_load_model(const char* p_string, objpar_size_t string_size, unsigned int flags, const struct objpar_vertex_format* p_format, const struct objpar_allocator* p_allocator, struct objpar_model* p_model);
+OBJPAR_API void objpar_free_model(const struct objpar_allocator* p_allocator, struct objpar_model* p_model);
+static unsigned int objpar_internal_load(const char* p_path, const char* p_string, objpar_size_t string_size, unsigned int flags, const struct objpar_vertex_format* p_format, const struct objpar_allocator* p_allocator, struct objpar_model* p_model);
+OBJPAR_API void objpar_arena_init(struct objpar_arena* p_arena, objpar_size_t block_size);
+OBJPAR_API void objpar_arena_reset(struct objpar_arena* p_arena);
+OBJPAR_API void objpar_arena_release(struct objpar_arena* p_arena);
+OBJPAR_API objpar_size_t objpar_build_meshlets(const struct objpar_data* p_data, const struct objpar_mesh* p_mesh, unsigned int max_vertices, unsigned int max_triangles, void* p_buffer, struct objpar_meshlets* p_meshlets);
+OBJPAR_API objpar_hash_t objpar_hash(const void* p_data, objpar_size_t size);
+OBJPAR_API objpar_size_t objpar_cache_write(const struct objpar_data* p_data, const struct objpar_mesh* p_mesh, objpar_size_t source_size, objpar_hash_t source_hash, void* p_buffer);
+OBJPAR_API unsigned int objpar_cache_load(const void* p_cache, objpar_size_t cache_size, objpar_size_t source_size, objpar_hash_t source_hash, struct objpar_data* p_data, struct objpar_mesh* p_mesh);
+static unsigned int objpar_internal_count(const char* p_string, objpar_size_t begin, objpar_size_t end, struct objpar_data* p_counts);
+static objpar_size_t objpar_internal_layout(const struct objpar_data* p_counts, void* p_buffer, struct objpar_data* p_data);
+static unsigned int objpar_internal_merge(struct objpar_data* p_counts, const struct objpar_data* p_range_counts);
+static unsigned int objpar_internal_add(unsigned int* p_count, unsigned int count);
+static void objpar_internal_count_range(const char* p_string, objpar_size_t begin, objpar_size_t end, struct objpar_data* p_counts);
+static void objpar_internal_fill(const char* p_string, objpar_size_t begin, objpar_size_t end, struct objpar_data* p_cursor);
+static unsigned int objpar_internal_v(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size, float** pp_vbuff, unsigned int vertex_width);
+static unsigned int objpar_internal_vn(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size, float** pp_nbuff, unsigned int normal_width);
+static unsigned int objpar_internal_vt(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size, float** pp_tbuff, unsigned int texcoord_width);
+static unsigned int objpar_internal_f(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size, unsigned int** pp_fbuff, unsigned int** pp_obuff, unsigned int* p_corner, unsigned int corner_limit, const struct objpar_data* p_counts);
+static unsigned int objpar_internal_g(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size, struct objpar_group** pp_gbuff, char** pp_nbuff, unsigned int* p_names_size, unsigned int face);
+static void objpar_internal_groups(struct objpar_data* p_data);
+static unsigned int objpar_internal_name_table_size(unsigned int name_count);
+static unsigned int* objpar_internal_name_slot(unsigned int* p_table, unsigned int table_size, const char* p_names, const unsigned int* p_name_offsets, unsigned int name_stride, const char* p_name);
+static unsigned int objpar_internal_comment(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size);
+static unsigned int objpar_internal_newline(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size, unsigned int* p_space_count);
+static objpar_size_t objpar_internal_line_end(const char* p_string, objpar_size_t index, objpar_size_t end);
+static objpar_size_t objpar_internal_line_spaces(const char* p_string, objpar_size_t index, objpar_size_t end, unsigned int* p_space_count);
+static objpar_size_t objpar_internal_line_tokens(const char* p_string, objpar_size_t index, objpar_size_t end, unsigned int* p_token_count);
+static unsigned int objpar_internal_ctz(unsigned int mask);
+static unsigned int objpar_internal_popcount(unsigned int mask);
+static objpar_size_t objpar_internal_floats(const char* p_string, objpar_size_t index, objpar_size_t string_size, float* p_values, unsigned int width, unsigned int* p_space_count);
+#if defined(objpar_atof) || defined(objpar_atoi)
+static objpar_size_t objpar_internal_token(const char* p_string, objpar_size_t index, objpar_size_t string_size, char* p_str, unsigned int str_capacity);
+#endif
+static float objpar_internal_read_float(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size);
+static unsigned int objpar_internal_read_uint(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size);
+static unsigned int objpar_internal_relative(const struct objpar_data* p_counts, unsigned int slot, unsigned int offset);
+static unsigned int objpar_internal_digits(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size, objpar_internal_u64* p_value, unsigned int* p_dropped);
+static float objpar_internal_atof(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size);
+#if defined(OBJPAR_SWAR)
+static unsigned int objpar_internal_digits8(const char* p_string, unsigned int* p_count);
+#endif
+static void* objpar_internal_arena_push(struct objpar_internal_arena* p_arena, const struct objpar_allocator* p_allocator, unsigned int size);
+static void* objpar_internal_arena_copy(struct objpar_internal_arena* p_arena, void* p_buffer);
+static void* objpar_internal_arena_narrow(struct objpar_internal_arena* p_arena, void* p_buffer, unsigned int stride, unsigned int width, unsigned int unit);
+static unsigned int objpar_internal_arena_widen(struct objpar_internal_arena* p_arena, const struct objpar_allocator* p_allocator, unsigned int* p_stride, unsigned int width, unsigned int unit);
+static void* objpar_internal_arena_last(struct objpar_internal_arena* p_arena, unsigned int size);
+static void objpar_internal_arena_pop(struct objpar_internal_arena* p_arena, unsigned int size);
+static void objpar_internal_arena_release(struct objpar_internal_arena* p_arena, const struct objpar_allocator* p_allocator);
+static void* objpar_internal_alloc(const struct objpar_allocator* p_allocator, objpar_size_t size);
+static void* objpar_internal_realloc(const struct objpar_allocator* p_allocator, void* p_memory, objpar_size_t old_size, objpar_size_t new_size);
+static void objpar_internal_free(const struct objpar_allocator* p_allocator, void* p_memory);
+static void* objpar_internal_bump_alloc(void* p_user_data, objpar_size_t size);
+static void* objpar_internal_bump_realloc(void* p_user_data, void* p_memory, objpar_size_t old_size, objpar_size_t new_size);
+static unsigned int objpar_internal_mesh_layout(const struct objpar_data* p_data, const struct objpar_vertex_format* p_format, unsigned int flags, unsigned int capacity, struct objpar_mesh* p_mesh);
+static unsigned int objpar_internal_attribute_size(unsigned int width, unsigned int format);
+static void objpar_internal_mesh_attribute(const float* p_source, unsigned int count, unsigned int width, unsigned int index, unsigned int format, float pad, char* p_vertex);
+static void objpar_internal_mesh_vertex(const struct objpar_data* p_data, const struct objpar_mesh* p_layout, const unsigned int* p_corner, unsigned int vertex);
+static objpar_size_t objpar_internal_build_mesh(const struct objpar_data* p_data, void* p_buffer, struct objpar_mesh* p_mesh, unsigned int flags, const struct objpar_vertex_format* p_format, unsigned int range_count);
+static unsigned int objpar_internal_mesh_expand(const struct objpar_internal_expand* p_expand, unsigned int corner_count, unsigned int max_face_width, unsigned int range_count, struct objpar_submesh* p_submeshes);
+static unsigned int objpar_internal_expand_kernel(const struct objpar_data* p_data, const struct objpar_mesh* p_layout);
+static void objpar_internal_expand_next(const struct objpar_data* p_data, const struct objpar_group* p_groups, unsigned int group_count, unsigned int* p_material, unsigned int* p_group);
+static void objpar_internal_expand_range(const struct objpar_internal_expand* p_range);
+static void objpar_internal_expand_corner(const struct objpar_internal_expand* p_range, const unsigned int* p_corner, objpar_size_t face_corner, unsigned int vertex);
+static unsigned short objpar_internal_half(float value);
+static int objpar_internal_snorm(float value, float scale);
+static void objpar_internal_cache_sizes(const struct objpar_internal_cache_header* p_header, objpar_internal_u64* p_sizes);
+static objpar_internal_u64 objpar_internal_cache_align(objpar_internal_u64 offset);
+static unsigned int objpar_internal_triangulate(const struct objpar_data* p_data, const unsigned int* p_face, unsigned int corner_count, unsigned int flags, unsigned int* p_scratch);
+static void objpar_internal_mesh_position(const struct objpar_data* p_data, unsigned int index, float* p_position);
+static float objpar_internal_cross(const float* p_a, const float* p_b, const float* p_c);
+static unsigned int objpar_internal_mesh_hash(const unsigned int* p_corner);
+static unsigned int objpar_internal_mesh_gen_size(const struct objpar_data* p_data, unsigned int flags, objpar_internal_u64* p_size, objpar_size_t* p_table_size);
+static void objpar_internal_mesh_gen_layout(const struct objpar_data* p_data, unsigned int flags, objpar_size_t table_size, void* p_buffer, struct objpar_internal_mesh_gen* p_gen);
+static void objpar_internal_mesh_generate(const struct objpar_data* p_data, const struct objpar_group* p_groups, unsigned int group_count, unsigned int flags, unsigned int* p_scratch, struct objpar_internal_mesh_gen* p_gen);
+static unsigned int objpar_internal_mesh_gen_slot(unsigned int* p_keys, unsigned int mask, const unsigned int* p_key);
+static void objpar_internal_mesh_gen_key(const struct objpar_data* p_data, const struct objpar_internal_mesh_gen* p_gen, const unsigned int* p_corner, objpar_size_t corner, unsigned int* p_key);
+static void objpar_internal_mesh_gen_normal(const struct objpar_data* p_data, const struct objpar_internal_mesh_gen* p_gen, unsigned int normal, float* p_normal);
+static void objpar_internal_mesh_gen_vertex(const struct objpar_internal_mesh_gen* p_gen, const struct objpar_mesh* p_layout, objpar_size_t corner, unsigned int vertex);
+static void objpar_internal_normalize(float* p_x, float* p_y, float* p_z, objpar_size_t count);
+static float objpar_internal_angle(const float* p_a, const float* p_b, const float* p_c);
+static float objpar_internal_sqrt(float value);
+static float objpar_internal_acos(float value);
+static unsigned int objpar_internal_mesh_index(const struct objpar_mesh* p_mesh, objpar_size_t index);
+static void objpar_internal_mesh_set_index(struct objpar_mesh* p_mesh, objpar_size_t index, unsigned int vertex);
+static void objpar_internal_mesh_tipsify(struct objpar_mesh* p_mesh, struct objpar_internal_tipsify* p_state, unsigned int first, unsigned int count);
+static unsigned int objpar_internal_mesh_transforms(const struct objpar_mesh* p_mesh, const unsigned int* p_order, unsigned int first, unsigned int count, unsigned int cache_size, unsigned int* p_stamps);
+static void objpar_internal_mesh_permute(char* p_vertices, const char* p_copy, int offset, unsigned int stride, const unsigned int* p_remap, unsigned int vertex_count);
+static void objpar_internal_mesh_read_position(const struct objpar_mesh* p_mesh, unsigned int width, unsigned int vertex, float* p_position);
+static float objpar_internal_half_float(unsigned short value);
+static void objpar_internal_meshlet_close(const struct objpar_mesh* p_mesh, unsigned int width, const struct objpar_meshlets* p_meshlets, struct objpar_meshlet* p_meshlet, unsigned int* p_local);
+static unsigned int objpar_internal_meshlet_normal(const struct objpar_mesh* p_mesh, unsigned int width, const unsigned int* p_vertices, const unsigned char* p_triangle, float* p_normal);
+static void* objpar_internal_visit_alloc(struct objpar_internal_visit* p_state, objpar_size_t size);
+static unsigned int objpar_internal_visit_faces(struct objpar_internal_visit* p_state, unsigned int batch_size, unsigned int corner_count);
+static void objpar_internal_visit_flush(struct objpar_internal_visit* p_state);
+static void objpar_internal_mtl_parse(const char* p_string, objpar_size_t string_size, struct objpar_mtl_data* p_cursor);
+static unsigned int objpar_internal_mtl_key(const char* p_string, objpar_size_t* p_index, objpar_size_t line_end, unsigned int* p_slot);
+static objpar_size_t objpar_internal_mtl_options(const char* p_string, objpar_size_t index, objpar_size_t line_end);
+static unsigned int* objpar_internal_mtl_slot(const struct objpar_mtl_data* p_mtl, const char* p_name);
+static void objpar_internal_builder_init(struct objpar_internal_builder* p_builder, const struct objpar_allocator* p_allocator);
+static void objpar_internal_builder_parse(struct objpar_internal_builder* p_builder, const char* p_string, objpar_size_t begin, objpar_size_t end);
+static void* objpar_internal_builder_finish(struct objpar_internal_builder* p_builder, struct objpar_data* p_data);
+static unsigned int objpar_internal_stream_carry(struct objpar_stream* p_stream, const char* p_string, objpar_size_t size);
+static unsigned int objpar_internal_read_serial(const struct objpar_reader* p_reader, struct objpar_stream* p_stream, char* p_block);
+#if defined(OBJPAR_ENABLE_FILE)
+static objpar_size_t objpar_internal_window_end(const char* p_string, objpar_size_t begin, objpar_size_t string_size);
+static void objpar_internal_file_release(struct objpar_file* p_file, objpar_size_t begin, objpar_size_t end);
+#endif
+#if defined(OBJPAR_ENABLE_THREADS)
+static unsigned int objpar_internal_split(const char* p_string, objpar_size_t string_size, unsigned int range_count, struct objpar_internal_range* p_ranges);
+static unsigned int objpar_internal_thread_count(unsigned int thread_count);
+static void objpar_internal_run_tasks(struct objpar_internal_task* p_tasks, unsigned int task_count);
+static void objpar_internal_start_task(struct objpar_internal_task* p_task);
+static void objpar_internal_join_task(struct objpar_internal_task* p_task);
+static unsigned int objpar_internal_read_parallel(const struct objpar_reader* p_reader, struct objpar_stream* p_stream, char* p_blocks);
+static void objpar_internal_read_task(void* p_arg);
+static void objpar_internal_lock(objpar_internal_mutex_t* p_mutex);
+static void objpar_internal_unlock(objpar_internal_mutex_t* p_mutex);
+static void objpar_internal_wait(objpar_internal_cond_t* p_cond, objpar_internal_mutex_t* p_mutex);
+static void objpar_internal_wake(objpar_internal_cond_t* p_cond);
+static void objpar_internal_count_task(void* p_arg);
+static void objpar_internal_fill_task(void* p_arg);
+static void objpar_internal_mtl_task(void* p_arg);
+static void objpar_internal_batch_task(void* p_arg);
+static void objpar_internal_expand_task(void* p_arg);
+static unsigned int objpar_internal_batch_next(struct objpar_internal_worker* p_worker);
+static unsigned int objpar_internal_cas(volatile objpar_internal_u64* p_value, objpar_internal_u64 expected, objpar_internal_u64 desired);
+static objpar_internal_u64 objpar_internal_load_u64(volatile objpar_internal_u64* p_value);
+#if defined(_WIN32)
+static DWORD WINAPI objpar_internal_thread_entry(LPVOID p_arg);
+#else
+static void* objpar_internal_thread_entry(void* p_arg);
+#endif
+#endif
 
-    vertex_buffer_size = (sizeof(float) * vertex_width) * vertex_count;
-    normal_buffer_size = (sizeof(float) * normal_width) * normal_count;
-    texcoord_buffer_size = (sizeof(float) * texcoord_width) * texcoord_count;
-    face_buffer_size = ((sizeof(unsigned int) * face_comp_count) * face_width) * face_count;
+/* Definition */
+objpar_size_t objpar(const char* p_string, objpar_size_t string_size, void* p_buffer, struct objpar_data* p_data)
+{
+    struct objpar_data counts;
+    struct objpar_data cursor;
+    objpar_size_t total_buffer_size;
 
-    total_buffer_size = (vertex_buffer_size + normal_buffer_size + texcoord_buffer_size + face_buffer_size);
+    /* First count elements to avoid reallocation */
+    if (!objpar_internal_count(p_string, 0, string_size, &counts))
+    {
+        return 0;
+    }
+    total_buffer_size = objpar_internal_layout(&counts, OBJPAR_NULL(void), OBJPAR_NULL(struct objpar_data));
 
     if (p_buffer == OBJPAR_NULL(void) ||
         p_data == OBJPAR_NULL(void))
@@ -198,489 +1014,5972 @@ unsigned int objpar(const char* p_string, unsigned int string_size, void* p_buff
         return 0;
     }
 
-    p_curr_buffer = p_buffer;
+    objpar_internal_layout(&counts, p_buffer, p_data);
+    cursor = *p_data;
+    cursor.position_count = 0;
+    cursor.normal_count = 0;
+    cursor.texcoord_count = 0;
+    cursor.face_count = 0;
+    cursor.corner_count = 0;
+    cursor.names_size = 0;
+    objpar_internal_fill(p_string, 0, string_size, &cursor);
+    objpar_internal_groups(p_data);
+    return 1;
+}
+
+#if defined(OBJPAR_ENABLE_THREADS)
+objpar_size_t objpar_parallel(const char* p_string, objpar_size_t string_size, void* p_buffer, struct objpar_data* p_data, unsigned int thread_count)
+{
+    struct objpar_internal_range ranges[OBJPAR_MAX_THREADS];
+    struct objpar_internal_task tasks[OBJPAR_MAX_THREADS];
+    struct objpar_data counts;
+    unsigned int range_count;
+    objpar_size_t total_buffer_size;
+    unsigned int position_offset;
+    unsigned int normal_offset;
+    unsigned int texcoord_offset;
+    unsigned int face_offset;
+    unsigned int corner_offset;
+    unsigned int group_offset;
+    unsigned int names_offset;
+    unsigned int i;
+
+    range_count = objpar_internal_split(p_string, string_size, objpar_internal_thread_count(thread_count), ranges);
 
-    if (vertex_count > 0)
+    for (i = 0; i < range_count; ++i)
     {
-        p_vertices = (float*)p_curr_buffer;
-        p_curr_buffer = (void*)((char*)p_curr_buffer + vertex_buffer_size);
+        tasks[i].p_func = objpar_internal_count_task;
+        tasks[i].p_arg = &ranges[i];
     }
-    if (normal_count > 0)
+    objpar_internal_run_tasks(tasks, range_count);
+
+    memset(&counts, 0, sizeof(counts));
+    for (i = 0; i < range_count; ++i)
     {
-        p_normals = (float*)p_curr_buffer;
-        p_curr_buffer = (void*)((char*)p_curr_buffer + normal_buffer_size);
+        if (!ranges[i].counted || !objpar_internal_merge(&counts, &ranges[i].data))
+        {
+            return 0;
+        }
     }
-    if (texcoord_count > 0)
+
+    total_buffer_size = objpar_internal_layout(&counts, OBJPAR_NULL(void), OBJPAR_NULL(struct objpar_data));
+
+    if (p_buffer == OBJPAR_NULL(void) ||
+        p_data == OBJPAR_NULL(void))
     {
-        p_texcoords = (float*)p_curr_buffer;
-        p_curr_buffer = (void*)((char*)p_curr_buffer + texcoord_buffer_size);
+        return total_buffer_size;
     }
-    if (face_count > 0)
+
+    if (total_buffer_size == 0)
     {
-        p_faces = (unsigned int*)p_curr_buffer;
-        p_curr_buffer = (void*)((char*)p_curr_buffer + face_buffer_size);
+        return 0;
     }
 
-    p_data->p_positions = p_vertices;
-    p_data->p_normals = p_normals;
-    p_data->p_texcoords = p_texcoords;
-    p_data->p_faces = p_faces;
-    p_data->position_count = vertex_count;
-    p_data->normal_count = normal_count;
-    p_data->texcoord_count = texcoord_count;
-    p_data->face_count = face_count;
-    p_data->position_width = vertex_width;
-    p_data->normal_width = normal_width;
-    p_data->texcoord_width = texcoord_width;
-    p_data->face_width = face_width;
-
-    index = 0;
-    vertex_count = 0;
-    normal_count = 0;
-    texcoord_count = 0;
-    face_count = 0;
+    objpar_internal_layout(&counts, p_buffer, p_data);
 
-    while (index < string_size)
+    /* Prefix sum of the chunk counts gives the first record of each chunk */
+    position_offset = 0;
+    normal_offset = 0;
+    texcoord_offset = 0;
+    face_offset = 0;
+    corner_offset = 0;
+    group_offset = 0;
+    names_offset = 0;
+    for (i = 0; i < range_count; ++i)
     {
-        if (objpar_internal_v(p_string, &index, string_size, &p_vertices, vertex_width));
-        else if (objpar_internal_vn(p_string, &index, string_size, &p_normals, normal_width));
-        else if (objpar_internal_vt(p_string, &index, string_size, &p_texcoords, texcoord_width));
-        else if (objpar_internal_f(p_string, &index, string_size, &p_faces, face_width));
-        else if (objpar_internal_comment(p_string, &index, string_size));
-        else objpar_internal_newline(p_string, &index, string_size, OBJPAR_NULL(unsigned int));
+        struct objpar_data* p_range = &ranges[i].data;
+        unsigned int position_count = p_range->position_count;
+        unsigned int normal_count = p_range->normal_count;
+        unsigned int texcoord_count = p_range->texcoord_count;
+        unsigned int face_count = p_range->face_count;
+        unsigned int corner_count = p_range->corner_count;
+        unsigned int group_count = p_range->group_count;
+        unsigned int names_size = p_range->names_size;
+
+        *p_range = *p_data;
+        if (position_count > 0)
+            p_range->p_positions = p_data->p_positions + (objpar_size_t)position_offset * p_data->position_width;
+        if (normal_count > 0)
+            p_range->p_normals = p_data->p_normals + (objpar_size_t)normal_offset * p_data->normal_width;
+        if (texcoord_count > 0)
+            p_range->p_texcoords = p_data->p_texcoords + (objpar_size_t)texcoord_offset * p_data->texcoord_width;
+        if (face_count > 0)
+        {
+            p_range->p_faces = p_data->p_faces + (objpar_size_t)corner_offset * 3;
+            p_range->p_face_offsets = p_data->p_face_offsets + face_offset;
+        }
+        if (group_count > 0)
+            p_range->p_groups = p_data->p_groups + group_offset;
+        if (names_size > 0)
+            p_range->p_names = p_data->p_names + names_offset;
+        p_range->position_count = position_offset;
+        p_range->normal_count = normal_offset;
+        p_range->texcoord_count = texcoord_offset;
+        p_range->face_count = face_offset;
+        p_range->corner_count = corner_offset;
+        p_range->names_size = names_offset;
+
+        position_offset += position_count;
+        normal_offset += normal_count;
+        texcoord_offset += texcoord_count;
+        face_offset += face_count;
+        corner_offset += corner_count;
+        group_offset += group_count;
+        names_offset += names_size;
+
+        tasks[i].p_func = objpar_internal_fill_task;
     }
+    objpar_internal_run_tasks(tasks, range_count);
+    objpar_internal_groups(p_data);
+
     return 1;
 }
+#endif
 
-unsigned int objpar_build_mesh(const struct objpar_data* p_data, void* p_buffer, struct objpar_mesh* p_mesh)
+#if defined(OBJPAR_ENABLE_FILE)
+unsigned int objpar_file_open(const char* p_file_name, struct objpar_file* p_file)
 {
-    unsigned int* p_faces;
-    unsigned int offset_size;
-    unsigned int stride;
-    unsigned int position_count;
-    unsigned int texcoord_count;
-    unsigned int normal_count;
-    unsigned int position_width;
-    unsigned int texcoord_width;
-    unsigned int normal_width;
-    unsigned int face_width;
-    unsigned int component_offset;
-    unsigned int vertex_component_count;
-    unsigned int vertex_count;
-    unsigned int index;
-    void* p_current;
-    float* p_positions;
-    float* p_texcoords;
-    float* p_normals;
+#if defined(_WIN32)
+    HANDLE file;
+    HANDLE mapping;
+    LARGE_INTEGER size;
+
+    p_file->p_string = OBJPAR_NULL(const char);
+    p_file->size = 0;
+
+    file = CreateFileA(p_file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return 0;
 
-    if (p_data->face_width != 3)
+    if (!GetFileSizeEx(file, &size) || (objpar_internal_u64)size.QuadPart > (objpar_internal_u64)(objpar_size_t)-1)
     {
-        /* To build a mesh this function requires the obj file to have
-        triangulated faces in advance. */
+        CloseHandle(file);
         return 0;
     }
 
-    position_count = p_data->position_count;
-    texcoord_count = p_data->texcoord_count;
-    normal_count = p_data->normal_count;
-    position_width = p_data->position_width;
-    texcoord_width = p_data->texcoord_width;
-    normal_width = p_data->normal_width;
-    face_width = p_data->face_width;
-
-    vertex_component_count = (position_count > 0 ? 1 : 0) + (texcoord_count > 0 ? 1 : 0) + (normal_count > 0 ? 1 : 0);
-    offset_size = (position_count > 0 ? position_width : 0) + (texcoord_count > 0 ? texcoord_width : 0) + (normal_count > 0 ? normal_width : 0);
-    stride = offset_size * sizeof(float);
-    vertex_count = p_data->face_count;
-
-    if (p_buffer == OBJPAR_NULL(void) ||
-        p_mesh == OBJPAR_NULL(void))
+    if (size.QuadPart > 0)
     {
-        return stride * face_width * vertex_count;
+        /* The view keeps the mapping alive, both handles can be closed */
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL)
+        {
+            p_file->p_string = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        if (p_file->p_string == OBJPAR_NULL(const char))
+        {
+            CloseHandle(file);
+            return 0;
+        }
     }
+    CloseHandle(file);
+    p_file->size = (objpar_size_t)size.QuadPart;
+    return 1;
+#else
+    int descriptor;
+    struct stat info;
+    void* p_memory;
 
-    component_offset = 0;
-    p_faces = p_data->p_faces;
+    p_file->p_string = OBJPAR_NULL(const char);
+    p_file->size = 0;
 
-    p_mesh->vertex_stride = stride;
-    p_mesh->position_offset = -1;
-    p_mesh->texcoord_offset = -1;
-    p_mesh->normal_offset = -1;
-    p_mesh->p_vertices = p_buffer;
-    p_mesh->vertex_count = vertex_count * face_width;
-    
-    if (position_count > 0)
-    {
-        p_mesh->position_offset = component_offset++ * p_data->position_width * sizeof(float);
-    }
-    if (texcoord_count > 0)
+    descriptor = open(p_file_name, O_RDONLY);
+    if (descriptor < 0)
+        return 0;
+
+    if (fstat(descriptor, &info) != 0 || (objpar_internal_u64)info.st_size > (objpar_internal_u64)(objpar_size_t)-1)
     {
-        p_mesh->texcoord_offset = component_offset++ * p_data->texcoord_width * sizeof(float);
+        close(descriptor);
+        return 0;
     }
-    if (normal_count > 0)
+
+    if (info.st_size > 0)
     {
-        p_mesh->normal_offset = component_offset++ * p_data->normal_width * sizeof(float);
+        /* The mapping stays valid after the descriptor is closed */
+        p_memory = mmap(NULL, (objpar_size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (p_memory == MAP_FAILED)
+        {
+            close(descriptor);
+            return 0;
+        }
+#if defined(MADV_SEQUENTIAL)
+        madvise(p_memory, (objpar_size_t)info.st_size, MADV_SEQUENTIAL);
+#endif
+        p_file->p_string = (const char*)p_memory;
     }
+    close(descriptor);
+    p_file->size = (objpar_size_t)info.st_size;
+    return 1;
+#endif
+}
 
-    p_current = p_buffer;
-    p_positions = p_data->p_positions;
-    p_texcoords = p_data->p_texcoords;
-    p_normals = p_data->p_normals;
+objpar_size_t objpar_file_parse(struct objpar_file* p_file, void* p_buffer, struct objpar_data* p_data)
+{
+    struct objpar_data counts;
+    struct objpar_data window_counts;
+    struct objpar_data cursor;
+    objpar_size_t total_buffer_size;
+    objpar_size_t begin;
+    objpar_size_t end;
 
+    /* The mapping is walked in windows. Once a window has been parsed its
+       pages are dropped, so only the output stays resident. */
+    memset(&counts, 0, sizeof(counts));
+    for (begin = 0; begin < p_file->size; begin = end)
     {
-        unsigned int count = vertex_count * face_width * 3;
-        for (index = 0; index < count; index += 3)
+        end = objpar_internal_window_end(p_file->p_string, begin, p_file->size);
+        if (!objpar_internal_count(p_file->p_string, begin, end, &window_counts) ||
+            !objpar_internal_merge(&counts, &window_counts))
         {
-            if (position_count > 0)
-            {
-                unsigned int idx;
-                unsigned int j;
-                float* p_position = (float*)p_current;
-
-                idx = (p_faces[index + OBJPAR_V_IDX] - 1);
-                idx *= position_width;
-
-                for (j = 0; j < position_width; ++j)
-                {
-                    p_position[j] = p_positions[idx + j];
-                }
+            objpar_internal_file_release(p_file, begin, end);
+            return 0;
+        }
+        objpar_internal_file_release(p_file, begin, end);
+    }
 
-                p_current = (void*)(p_position + position_width);
-            }
-            if (texcoord_count > 0)
-            {
-                unsigned int idx;
-                unsigned int j;
-                float* p_texcoord = (float*)p_current;
+    total_buffer_size = objpar_internal_layout(&counts, OBJPAR_NULL(void), OBJPAR_NULL(struct objpar_data));
 
-                idx = (p_faces[index + OBJPAR_VT_IDX] - 1) * texcoord_width;
+    if (p_buffer == OBJPAR_NULL(void) ||
+        p_data == OBJPAR_NULL(void))
+    {
+        return total_buffer_size;
+    }
 
-                for (j = 0; j < texcoord_width; ++j)
-                {
-                    p_texcoord[j] = p_texcoords[idx + j];
+    if (total_buffer_size == 0)
+    {
+        return 0;
+    }
+
+    objpar_internal_layout(&counts, p_buffer, p_data);
+    cursor = *p_data;
+    cursor.position_count = 0;
+    cursor.normal_count = 0;
+    cursor.texcoord_count = 0;
+    cursor.face_count = 0;
+    cursor.corner_count = 0;
+    cursor.names_size = 0;
+    for (begin = 0; begin < p_file->size; begin = end)
+    {
+        end = objpar_internal_window_end(p_file->p_string, begin, p_file->size);
+        objpar_internal_fill(p_file->p_string, begin, end, &cursor);
+        objpar_internal_file_release(p_file, begin, end);
+    }
+    objpar_internal_groups(p_data);
+    return 1;
+}
+
+void objpar_file_close(struct objpar_file* p_file)
+{
+    if (p_file->p_string != OBJPAR_NULL(const char))
+    {
+#if defined(_WIN32)
+        UnmapViewOfFile((LPCVOID)p_file->p_string);
+#else
+        munmap((void*)p_file->p_string, p_file->size);
+#endif
+    }
+    p_file->p_string = OBJPAR_NULL(const char);
+    p_file->size = 0;
+}
+#endif
+
+void* objpar_single_pass(const char* p_string, objpar_size_t string_size, struct objpar_data* p_data)
+{
+    return objpar_single_pass_ex(p_string, string_size, OBJPAR_NULL(const struct objpar_allocator), p_data);
+}
+
+void* objpar_single_pass_ex(const char* p_string, objpar_size_t string_size, const struct objpar_allocator* p_allocator, struct objpar_data* p_data)
+{
+    struct objpar_internal_builder builder;
+
+    objpar_internal_builder_init(&builder, p_allocator);
+    objpar_internal_builder_parse(&builder, p_string, 0, string_size);
+    return objpar_internal_builder_finish(&builder, p_data);
+}
+
+void objpar_stream_init(struct objpar_stream* p_stream)
+{
+    objpar_stream_init_ex(p_stream, OBJPAR_NULL(const struct objpar_allocator));
+}
+
+void objpar_stream_init_ex(struct objpar_stream* p_stream, const struct objpar_allocator* p_allocator)
+{
+    objpar_internal_builder_init(&p_stream->builder, p_allocator);
+    p_stream->p_line = OBJPAR_NULL(char);
+    p_stream->line_size = 0;
+    p_stream->line_capacity = 0;
+}
+
+unsigned int objpar_stream_feed(struct objpar_stream* p_stream, const void* p_chunk, objpar_size_t chunk_size)
+{
+    const char* p_string;
+    objpar_size_t begin;
+    objpar_size_t end;
+
+    p_string = (const char*)p_chunk;
+    begin = 0;
+
+    /* Finish the line that was split by the previous chunk */
+    if (p_stream->line_size > 0)
+    {
+        begin = objpar_internal_line_end(p_string, 0, chunk_size);
+        if (begin < chunk_size)
+            begin += 1;
+        if (!objpar_internal_stream_carry(p_stream, p_string, begin))
+            return 0;
+        if (p_stream->p_line[p_stream->line_size - 1] == '\n' || p_stream->p_line[p_stream->line_size - 1] == '\r')
+        {
+            objpar_internal_builder_parse(&p_stream->builder, p_stream->p_line, 0, p_stream->line_size);
+            p_stream->line_size = 0;
+        }
+    }
+
+    /* Parse every complete line and keep the rest for the next chunk */
+    end = chunk_size;
+    while (end > begin && p_string[end - 1] != '\n' && p_string[end - 1] != '\r')
+        --end;
+
+    objpar_internal_builder_parse(&p_stream->builder, p_string, begin, end);
+
+    if (!objpar_internal_stream_carry(p_stream, p_string + end, chunk_size - end))
+        return 0;
+
+    return !p_stream->builder.failed;
+}
+
+void* objpar_stream_finish(struct objpar_stream* p_stream, struct objpar_data* p_data)
+{
+    void* p_buffer;
+
+    if (p_stream->line_size > 0)
+    {
+        objpar_internal_builder_parse(&p_stream->builder, p_stream->p_line, 0, p_stream->line_size);
+    }
+
+    p_buffer = objpar_internal_builder_finish(&p_stream->builder, p_data);
+
+    if (p_stream->p_line != OBJPAR_NULL(char))
+    {
+        objpar_internal_free(p_stream->builder.p_allocator, p_stream->p_line);
+    }
+    p_stream->p_line = OBJPAR_NULL(char);
+    p_stream->line_size = 0;
+    p_stream->line_capacity = 0;
+    return p_buffer;
+}
+
+void* objpar_stream_read(const struct objpar_reader* p_reader, const struct objpar_allocator* p_allocator, struct objpar_data* p_data)
+{
+    struct objpar_stream stream;
+    char* p_blocks;
+    void* p_buffer;
+    unsigned int success;
+
+    /* With threads the input is read into a ring of blocks on its own
+       thread while this one parses the blocks that are ready, otherwise
+       one block is read and parsed at a time. Either way only the blocks,
+       the stream line and the output are in memory. */
+#if defined(OBJPAR_ENABLE_THREADS)
+    p_blocks = (char*)objpar_internal_alloc(p_allocator, (objpar_size_t)OBJPAR_READ_BLOCK_SIZE * OBJPAR_INTERNAL_READ_BLOCKS);
+#else
+    p_blocks = (char*)objpar_internal_alloc(p_allocator, OBJPAR_READ_BLOCK_SIZE);
+#endif
+    if (p_blocks == OBJPAR_NULL(char))
+    {
+        return OBJPAR_NULL(void);
+    }
+
+    objpar_stream_init_ex(&stream, p_allocator);
+#if defined(OBJPAR_ENABLE_THREADS)
+    success = objpar_internal_read_parallel(p_reader, &stream, p_blocks);
+#else
+    success = objpar_internal_read_serial(p_reader, &stream, p_blocks);
+#endif
+    objpar_internal_free(p_allocator, p_blocks);
+
+    p_buffer = objpar_stream_finish(&stream, p_data);
+    if (!success && p_buffer != OBJPAR_NULL(void))
+    {
+        objpar_internal_free(p_allocator, p_buffer);
+        p_buffer = OBJPAR_NULL(void);
+    }
+    return p_buffer;
+}
+
+unsigned int objpar_load_model(const char* p_string, objpar_size_t string_size, unsigned int flags, const struct objpar_vertex_format* p_format, const struct objpar_allocator* p_allocator, struct objpar_model* p_model)
+{
+    if (objpar_internal_load(OBJPAR_NULL(const char), p_string, string_size, flags, p_format, p_allocator, p_model) != OBJPAR_LOAD_OK)
+    {
+        objpar_free_model(p_allocator, p_model);
+        return 0;
+    }
+    return 1;
+}
+
+unsigned int objpar_internal_load(const char* p_path, const char* p_string, objpar_size_t string_size, unsigned int flags, const struct objpar_vertex_format* p_format, const struct objpar_allocator* p_allocator, struct objpar_model* p_model)
+{
+    objpar_size_t mesh_size;
+    objpar_size_t vertex_offset;
+    objpar_size_t index_offset;
+    objpar_size_t used_size;
+    char* p_mesh_buffer;
+#if defined(OBJPAR_ENABLE_FILE)
+    struct objpar_file file;
+#endif
+
+    memset(p_model, 0, sizeof(struct objpar_model));
+    if (p_path != OBJPAR_NULL(const char))
+    {
+#if defined(OBJPAR_ENABLE_FILE)
+        /* The model doesn't point into the text, so the mapping is closed
+           as soon as it's parsed. */
+        if (!objpar_file_open(p_path, &file))
+            return OBJPAR_LOAD_READ_ERROR;
+        p_model->p_data_buffer = objpar_single_pass_ex(file.p_string, file.size, p_allocator, &p_model->data);
+        objpar_file_close(&file);
+#else
+        return OBJPAR_LOAD_READ_ERROR;
+#endif
+    }
+    else
+    {
+        p_model->p_data_buffer = objpar_single_pass_ex(p_string, string_size, p_allocator, &p_model->data);
+    }
+
+    /* The text is parsed once into growable chunks and compacted, the mesh
+       size only depends on the face offsets, so nothing is scanned twice. */
+    if (p_model->p_data_buffer == OBJPAR_NULL(void))
+    {
+        return OBJPAR_LOAD_PARSE_ERROR;
+    }
+
+    mesh_size = objpar_build_mesh_ex(&p_model->data, OBJPAR_NULL(void), OBJPAR_NULL(struct objpar_mesh), flags, p_format);
+    if (mesh_size > 0)
+    {
+        p_model->p_mesh_buffer = objpar_internal_alloc(p_allocator, mesh_size);
+    }
+    if (p_model->p_mesh_buffer == OBJPAR_NULL(void) ||
+        !objpar_build_mesh_ex(&p_model->data, p_model->p_mesh_buffer, &p_model->mesh, flags, p_format))
+    {
+        return OBJPAR_LOAD_MESH_ERROR;
+    }
+
+    /* Only [submeshes][indices][vertices] are kept, the hash table, the
+       triangulation scratch and the generated normals behind them were
+       only needed while building. The buffer is shrunk when the allocator
+       can resize it, copying it into a smaller block isn't worth it. */
+    p_mesh_buffer = (char*)p_model->p_mesh_buffer;
+    vertex_offset = (objpar_size_t)((char*)p_model->mesh.p_vertices - p_mesh_buffer);
+    index_offset = 0;
+    if (p_model->mesh.p_indices != OBJPAR_NULL(void))
+        index_offset = (objpar_size_t)((char*)p_model->mesh.p_indices - p_mesh_buffer);
+    used_size = vertex_offset + (objpar_size_t)p_model->mesh.vertex_count * p_model->mesh.vertex_stride;
+    if (used_size < mesh_size)
+    {
+        if (p_allocator != OBJPAR_NULL(const struct objpar_allocator))
+        {
+            if (p_allocator->p_realloc != 0)
+                p_mesh_buffer = (char*)p_allocator->p_realloc(p_allocator->p_user_data, p_mesh_buffer, mesh_size, used_size);
+        }
+#if defined(objpar_realloc)
+        else
+        {
+            p_mesh_buffer = (char*)objpar_realloc(p_mesh_buffer, used_size);
+        }
+#endif
+        /* A failed resize leaves the old buffer in use */
+        if (p_mesh_buffer != OBJPAR_NULL(char))
+        {
+            p_model->p_mesh_buffer = p_mesh_buffer;
+            p_model->mesh.p_submeshes = (struct objpar_submesh*)(void*)p_mesh_buffer;
+            p_model->mesh.p_vertices = (void*)(p_mesh_buffer + vertex_offset);
+            if (index_offset > 0)
+                p_model->mesh.p_indices = (void*)(p_mesh_buffer + index_offset);
+        }
+    }
+    return OBJPAR_LOAD_OK;
+}
+
+#if defined(OBJPAR_ENABLE_THREADS)
+unsigned int objpar_batch_load(const struct objpar_batch* p_batch)
+{
+    struct objpar_internal_task tasks[OBJPAR_MAX_THREADS];
+    struct objpar_internal_worker workers[OBJPAR_MAX_THREADS];
+    unsigned int worker_count;
+    unsigned int loaded_count;
+    unsigned int i;
+
+    if (p_batch->item_count == 0)
+    {
+        return 0;
+    }
+
+    /* Every worker starts with an even share of the items and steals half
+       of another share when its own runs out, so a few large files don't
+       leave the other threads idle. A worker only holds one file at a
+       time, which bounds the memory in flight to one model per thread. */
+    worker_count = objpar_internal_thread_count(p_batch->thread_count);
+    if (worker_count > p_batch->item_count)
+        worker_count = p_batch->item_count;
+
+    for (i = 0; i < worker_count; ++i)
+    {
+        objpar_internal_u64 begin = (objpar_internal_u64)p_batch->item_count * i / worker_count;
+        objpar_internal_u64 end = (objpar_internal_u64)p_batch->item_count * (i + 1) / worker_count;
+
+        workers[i].p_batch = p_batch;
+        workers[i].p_workers = workers;
+        workers[i].range = begin | (end << 32);
+        workers[i].worker_count = worker_count;
+        workers[i].index = i;
+        workers[i].loaded_count = 0;
+        objpar_arena_init(&workers[i].arena, p_batch->arena_block_size);
+        tasks[i].p_func = objpar_internal_batch_task;
+        tasks[i].p_arg = &workers[i];
+    }
+    objpar_internal_run_tasks(tasks, worker_count);
+
+    loaded_count = 0;
+    for (i = 0; i < worker_count; ++i)
+    {
+        loaded_count += workers[i].loaded_count;
+        objpar_arena_release(&workers[i].arena);
+    }
+    return loaded_count;
+}
+#endif
+
+void objpar_free_model(const struct objpar_allocator* p_allocator, struct objpar_model* p_model)
+{
+    if (p_model->p_mesh_buffer != OBJPAR_NULL(void))
+        objpar_internal_free(p_allocator, p_model->p_mesh_buffer);
+    if (p_model->p_data_buffer != OBJPAR_NULL(void))
+        objpar_internal_free(p_allocator, p_model->p_data_buffer);
+    memset(p_model, 0, sizeof(struct objpar_model));
+}
+
+void objpar_arena_init(struct objpar_arena* p_arena, objpar_size_t block_size)
+{
+    memset(p_arena, 0, sizeof(struct objpar_arena));
+    p_arena->allocator.p_user_data = p_arena;
+    p_arena->allocator.p_alloc = objpar_internal_bump_alloc;
+    p_arena->allocator.p_realloc = objpar_internal_bump_realloc;
+    p_arena->block_size = (block_size > 0 ? block_size : OBJPAR_ARENA_BLOCK_SIZE);
+}
+
+void objpar_arena_reset(struct objpar_arena* p_arena)
+{
+    p_arena->p_current = p_arena->p_first;
+    p_arena->p_last = OBJPAR_NULL(void);
+    if (p_arena->p_first != OBJPAR_NULL(struct objpar_internal_block))
+        p_arena->p_first->size = 0;
+}
+
+void objpar_arena_release(struct objpar_arena* p_arena)
+{
+    struct objpar_internal_block* p_block;
+
+    p_block = p_arena->p_first;
+    while (p_block != OBJPAR_NULL(struct objpar_internal_block))
+    {
+        struct objpar_internal_block* p_next = p_block->p_next;
+        objpar_free(p_block);
+        p_block = p_next;
+    }
+    p_arena->p_first = OBJPAR_NULL(struct objpar_internal_block);
+    p_arena->p_current = OBJPAR_NULL(struct objpar_internal_block);
+    p_arena->p_last = OBJPAR_NULL(void);
+}
+
+unsigned int objpar_visit(const char* p_string, objpar_size_t string_size, const struct objpar_visitor* p_visitor)
+{
+    struct objpar_internal_visit state;
+    objpar_size_t index;
+    unsigned int batch_size;
+
+    memset(&state, 0, sizeof(state));
+    state.p_visitor = p_visitor;
+    batch_size = (p_visitor->batch_size > 0 ? p_visitor->batch_size : OBJPAR_VISIT_BATCH_SIZE);
+    index = 0;
+
+    /* Records are parsed into small batches with the same record parsers
+       objpar uses and handed to the callbacks once a batch is full. Kinds
+       without a callback are skipped without being parsed. */
+    while (index < string_size && !state.failed)
+    {
+        char c0;
+        char c1;
+        objpar_size_t probe;
+
+        c0 = p_string[index];
+        c1 = (index + 1 < string_size ? p_string[index + 1] : 0);
+        probe = index;
+
+        if (c0 == 'v' && c1 == ' ' && p_visitor->p_positions != 0)
+        {
+            float* p_position;
+            if (state.p_positions == OBJPAR_NULL(float))
+            {
+                state.position_width = objpar_internal_v(p_string, &probe, string_size, OBJPAR_NULL(float*), 0);
+                state.p_positions = (float*)objpar_internal_visit_alloc(&state, sizeof(float) * state.position_width * batch_size);
+                if (state.p_positions == OBJPAR_NULL(float))
+                    break;
+            }
+            p_position = state.p_positions + state.position_count * state.position_width;
+            objpar_internal_v(p_string, &index, string_size, &p_position, state.position_width);
+            state.totals.position_count += 1;
+            if (++state.position_count == batch_size)
+                objpar_internal_visit_flush(&state);
+        }
+        else if (c0 == 'v' && c1 == 'n' && p_visitor->p_normals != 0)
+        {
+            float* p_normal;
+            if (state.p_normals == OBJPAR_NULL(float))
+            {
+                state.normal_width = objpar_internal_vn(p_string, &probe, string_size, OBJPAR_NULL(float*), 0);
+                state.p_normals = (float*)objpar_internal_visit_alloc(&state, sizeof(float) * state.normal_width * batch_size);
+                if (state.p_normals == OBJPAR_NULL(float))
+                    break;
+            }
+            p_normal = state.p_normals + state.normal_count * state.normal_width;
+            objpar_internal_vn(p_string, &index, string_size, &p_normal, state.normal_width);
+            state.totals.normal_count += 1;
+            if (++state.normal_count == batch_size)
+                objpar_internal_visit_flush(&state);
+        }
+        else if (c0 == 'v' && c1 == 't' && p_visitor->p_texcoords != 0)
+        {
+            float* p_texcoord;
+            if (state.p_texcoords == OBJPAR_NULL(float))
+            {
+                state.texcoord_width = objpar_internal_vt(p_string, &probe, string_size, OBJPAR_NULL(float*), 0);
+                state.p_texcoords = (float*)objpar_internal_visit_alloc(&state, sizeof(float) * state.texcoord_width * batch_size);
+                if (state.p_texcoords == OBJPAR_NULL(float))
+                    break;
+            }
+            p_texcoord = state.p_texcoords + state.texcoord_count * state.texcoord_width;
+            objpar_internal_vt(p_string, &index, string_size, &p_texcoord, state.texcoord_width);
+            state.totals.texcoord_count += 1;
+            if (++state.texcoord_count == batch_size)
+                objpar_internal_visit_flush(&state);
+        }
+        else if (c0 == 'f' && c1 == ' ' && p_visitor->p_faces != 0)
+        {
+            unsigned int* p_face;
+            unsigned int* p_offset;
+            unsigned int corner_count;
+
+            if (state.p_faces == OBJPAR_NULL(unsigned int) && !objpar_internal_visit_faces(&state, batch_size, 0))
+                break;
+            p_face = state.p_faces + state.corner_count * 3;
+            p_offset = state.p_face_offsets + state.face_count;
+            if (!objpar_internal_f(p_string, &index, string_size, &p_face, &p_offset, &state.corner_count, state.corner_capacity - state.corner_count, &state.totals))
+            {
+                /* The face doesn't fit in what is left of the batch */
+                corner_count = objpar_internal_f(p_string, &probe, string_size, OBJPAR_NULL(unsigned int*), OBJPAR_NULL(unsigned int*), OBJPAR_NULL(unsigned int), 0, OBJPAR_NULL(struct objpar_data));
+                objpar_internal_visit_flush(&state);
+                if (!objpar_internal_visit_faces(&state, batch_size, corner_count))
+                    break;
+                p_face = state.p_faces;
+                p_offset = state.p_face_offsets;
+                objpar_internal_f(p_string, &index, string_size, &p_face, &p_offset, &state.corner_count, state.corner_capacity, &state.totals);
+            }
+            if (++state.face_count == batch_size)
+                objpar_internal_visit_flush(&state);
+        }
+        else if ((c0 == 'v' && (c1 == ' ' || c1 == 'n' || c1 == 't')) || (c0 == 'f' && c1 == ' ') ||
+                 c0 == '\n' || c0 == '\r' || c0 == ' ' || c0 == '\t')
+        {
+            /* Skipped vertex elements are still counted so negative face
+               indices resolve the same way they do in objpar. */
+            if (c0 == 'v' && c1 == ' ')
+                state.totals.position_count += 1;
+            else if (c0 == 'v' && c1 == 'n')
+                state.totals.normal_count += 1;
+            else if (c0 == 'v' && c1 == 't')
+                state.totals.texcoord_count += 1;
+            objpar_internal_newline(p_string, &index, string_size, OBJPAR_NULL(unsigned int));
+        }
+        else if (objpar_internal_comment(p_string, &index, string_size));
+        else
+        {
+            objpar_size_t line_end = objpar_internal_line_end(p_string, index, string_size);
+            objpar_size_t length = line_end - index;
+
+            if (length > 0 && p_string[line_end - 1] == '\r')
+                length -= 1;
+
+            /* Pending records are delivered first so the callbacks see
+               them in file order relative to the directive. */
+            if (p_visitor->p_directive != 0)
+            {
+                objpar_internal_visit_flush(&state);
+                p_visitor->p_directive(p_visitor->p_user_data, p_string + index, length);
+            }
+            index = line_end + 1;
+        }
+    }
+
+    if (!state.failed)
+        objpar_internal_visit_flush(&state);
+
+    if (state.p_positions != OBJPAR_NULL(float))
+        objpar_free(state.p_positions);
+    if (state.p_normals != OBJPAR_NULL(float))
+        objpar_free(state.p_normals);
+    if (state.p_texcoords != OBJPAR_NULL(float))
+        objpar_free(state.p_texcoords);
+    if (state.p_faces != OBJPAR_NULL(unsigned int))
+        objpar_free(state.p_faces);
+
+    return !state.failed;
+}
+
+objpar_size_t objpar_validate(const struct objpar_data* p_data)
+{
+    const unsigned int* p_faces;
+    unsigned int limits[3];
+    unsigned int biases[3];
+    objpar_size_t invalid_count;
+    objpar_size_t index;
+    objpar_size_t size;
+
+    /* A position index is valid in [1, position_count], texcoord and
+       normal indices in [0, count] where 0 means missing. Subtracting the
+       bias turns both into the unsigned compare index - bias < limit. */
+    limits[OBJPAR_V_IDX] = p_data->position_count;
+    limits[OBJPAR_VT_IDX] = p_data->texcoord_count + 1;
+    limits[OBJPAR_VN_IDX] = p_data->normal_count + 1;
+    biases[OBJPAR_V_IDX] = 1;
+    biases[OBJPAR_VT_IDX] = 0;
+    biases[OBJPAR_VN_IDX] = 0;
+
+    p_faces = p_data->p_faces;
+    size = (objpar_size_t)p_data->corner_count * 3;
+    invalid_count = 0;
+    index = 0;
+
+#if defined(OBJPAR_SSE2)
+    {
+        /* 4 corners are 3 vectors, each one with the v/vt/vn pattern
+           rotated by one lane. SSE2 only has a signed compare, so both
+           sides are moved into the signed range first. */
+        const __m128i sign = _mm_set1_epi32((int)0x80000000u);
+        __m128i limit[3];
+        __m128i bias[3];
+        __m128i valid = _mm_setzero_si128();
+        unsigned int lanes[4];
+        unsigned int j;
+
+        for (j = 0; j < 3; ++j)
+        {
+            limit[j] = _mm_xor_si128(_mm_setr_epi32((int)limits[(j * 4) % 3], (int)limits[(j * 4 + 1) % 3], (int)limits[(j * 4 + 2) % 3], (int)limits[(j * 4 + 3) % 3]), sign);
+            bias[j] = _mm_setr_epi32((int)biases[(j * 4) % 3], (int)biases[(j * 4 + 1) % 3], (int)biases[(j * 4 + 2) % 3], (int)biases[(j * 4 + 3) % 3]);
+        }
+        for (; index + 12 <= size; index += 12)
+        {
+            for (j = 0; j < 3; ++j)
+            {
+                __m128i value = _mm_loadu_si128((const __m128i*)(p_faces + index + j * 4));
+                value = _mm_xor_si128(_mm_sub_epi32(value, bias[j]), sign);
+                /* Lanes are all ones when valid, so this counts down */
+                valid = _mm_add_epi32(valid, _mm_cmpgt_epi32(limit[j], value));
+            }
+        }
+        _mm_storeu_si128((__m128i*)lanes, valid);
+        invalid_count = index - ((objpar_size_t)(0u - lanes[0]) + (0u - lanes[1]) + (0u - lanes[2]) + (0u - lanes[3]));
+    }
+#endif
+
+    for (; index < size; ++index)
+    {
+        unsigned int slot = (unsigned int)(index % 3);
+        if (p_faces[index] - biases[slot] >= limits[slot])
+            invalid_count += 1;
+    }
+    return invalid_count;
+}
+
+objpar_size_t objpar_mtl(const char* const* pp_strings, const objpar_size_t* p_sizes, unsigned int library_count, void* p_buffer, struct objpar_mtl_data* p_mtl)
+{
+    struct objpar_mtl_data counts;
+    struct objpar_mtl_data library_counts;
+    struct objpar_mtl_data cursor;
+    objpar_internal_u64 total_buffer_size;
+    objpar_size_t material_buffer_size;
+    unsigned int table_size;
+    unsigned int library;
+    unsigned int material;
+#if defined(OBJPAR_ENABLE_THREADS)
+    struct objpar_internal_mtl_range ranges[OBJPAR_MAX_THREADS];
+    struct objpar_internal_task tasks[OBJPAR_MAX_THREADS];
+    unsigned int wave_size;
+    unsigned int wave_count;
+    unsigned int i;
+
+    wave_size = objpar_internal_thread_count(0);
+#endif
+
+    /* Every library is counted first, then written after the previous
+       ones so all of them share one material array and one name arena. */
+    memset(&counts, 0, sizeof(counts));
+    for (library = 0; library < library_count; ++library)
+    {
+        /* A library of OBJPAR_INTERNAL_COUNT_RANGE bytes can't overflow
+           its own counts, the sums over all libraries are checked */
+        if (p_sizes[library] > OBJPAR_INTERNAL_COUNT_RANGE)
+        {
+            return 0;
+        }
+        memset(&library_counts, 0, sizeof(library_counts));
+        objpar_internal_mtl_parse(pp_strings[library], p_sizes[library], &library_counts);
+        if (!objpar_internal_add(&counts.material_count, library_counts.material_count) ||
+            !objpar_internal_add(&counts.names_size, library_counts.names_size))
+        {
+            return 0;
+        }
+    }
+
+    if (counts.material_count >= 0x40000000u)
+    {
+        /* The name table would need more than 2^31 slots */
+        return 0;
+    }
+    /* objpar_mtl_find needs at least one empty slot, even without materials */
+    table_size = objpar_internal_name_table_size(counts.material_count > 0 ? counts.material_count : 1);
+    material_buffer_size = sizeof(struct objpar_material) * (objpar_size_t)counts.material_count;
+
+    total_buffer_size = (objpar_internal_u64)sizeof(struct objpar_material) * counts.material_count + (objpar_internal_u64)table_size * sizeof(unsigned int) + counts.names_size;
+    if (total_buffer_size > (objpar_size_t)-1)
+    {
+        return 0;
+    }
+
+    if (p_buffer == OBJPAR_NULL(void) ||
+        p_mtl == OBJPAR_NULL(void))
+    {
+        return (objpar_size_t)total_buffer_size;
+    }
+
+    /* Buffer layout: [materials][table][names] */
+    memset(p_mtl, 0, sizeof(struct objpar_mtl_data));
+    p_mtl->p_materials = (struct objpar_material*)p_buffer;
+    p_mtl->p_table = (unsigned int*)((char*)p_buffer + material_buffer_size);
+    p_mtl->p_names = (char*)(p_mtl->p_table + table_size);
+    p_mtl->table_size = table_size;
+
+    cursor = *p_mtl;
+#if defined(OBJPAR_ENABLE_THREADS)
+    if (library_count > 1)
+    {
+        /* Libraries are parsed in waves of one library per thread. Each
+           wave is counted again so every library knows where its
+           materials and names start. */
+        for (library = 0; library < library_count; library += wave_count)
+        {
+            wave_count = library_count - library;
+            if (wave_count > wave_size)
+                wave_count = wave_size;
+
+            for (i = 0; i < wave_count; ++i)
+            {
+                ranges[i].p_string = pp_strings[library + i];
+                ranges[i].size = p_sizes[library + i];
+                memset(&ranges[i].data, 0, sizeof(struct objpar_mtl_data));
+                tasks[i].p_func = objpar_internal_mtl_task;
+                tasks[i].p_arg = &ranges[i];
+            }
+            objpar_internal_run_tasks(tasks, wave_count);
+
+            for (i = 0; i < wave_count; ++i)
+            {
+                unsigned int material_count = ranges[i].data.material_count;
+                unsigned int names_size = ranges[i].data.names_size;
+
+                ranges[i].data = cursor;
+                cursor.p_materials += material_count;
+                cursor.p_names += names_size;
+                cursor.material_count += material_count;
+                cursor.names_size += names_size;
+            }
+            objpar_internal_run_tasks(tasks, wave_count);
+        }
+    }
+    else
+#endif
+    {
+        for (library = 0; library < library_count; ++library)
+        {
+            objpar_internal_mtl_parse(pp_strings[library], p_sizes[library], &cursor);
+        }
+    }
+
+    p_mtl->material_count = counts.material_count;
+    p_mtl->names_size = counts.names_size;
+
+    /* Names are interned in an open addressing table of material indices.
+       When a name is defined twice the first definition wins. */
+    memset(p_mtl->p_table, 0xFF, table_size * sizeof(unsigned int));
+    for (material = 0; material < p_mtl->material_count; ++material)
+    {
+        unsigned int* p_slot = objpar_internal_mtl_slot(p_mtl, p_mtl->p_names + p_mtl->p_materials[material].name);
+        if (*p_slot == OBJPAR_NONE)
+            *p_slot = material;
+    }
+    return 1;
+}
+
+unsigned int objpar_mtl_find(const struct objpar_mtl_data* p_mtl, const char* p_name)
+{
+    return *objpar_internal_mtl_slot(p_mtl, p_name);
+}
+
+unsigned int objpar_mtl_resolve(const struct objpar_mtl_data* p_mtl, const struct objpar_data* p_data, unsigned int* p_remap)
+{
+    unsigned int found_count;
+    unsigned int material;
+
+    found_count = 0;
+    for (material = 0; material < p_data->material_count; ++material)
+    {
+        p_remap[material] = objpar_mtl_find(p_mtl, p_data->p_names + p_data->p_materials[material]);
+        if (p_remap[material] != OBJPAR_NONE)
+            found_count += 1;
+    }
+    return found_count;
+}
+
+objpar_size_t objpar_build_mesh(const struct objpar_data* p_data, void* p_buffer, struct objpar_mesh* p_mesh)
+{
+    return objpar_build_mesh_ex(p_data, p_buffer, p_mesh, 0, OBJPAR_NULL(struct objpar_vertex_format));
+}
+
+objpar_size_t objpar_build_indexed_mesh(const struct objpar_data* p_data, void* p_buffer, struct objpar_mesh* p_mesh)
+{
+    return objpar_build_mesh_ex(p_data, p_buffer, p_mesh, OBJPAR_MESH_INDEXED, OBJPAR_NULL(struct objpar_vertex_format));
+}
+
+objpar_size_t objpar_build_mesh_ex(const struct objpar_data* p_data, void* p_buffer, struct objpar_mesh* p_mesh, unsigned int flags, const struct objpar_vertex_format* p_format)
+{
+    return objpar_internal_build_mesh(p_data, p_buffer, p_mesh, flags, p_format, 1);
+}
+
+#if defined(OBJPAR_ENABLE_THREADS)
+objpar_size_t objpar_build_mesh_parallel(const struct objpar_data* p_data, void* p_buffer, struct objpar_mesh* p_mesh, unsigned int flags, const struct objpar_vertex_format* p_format, unsigned int thread_count)
+{
+    return objpar_internal_build_mesh(p_data, p_buffer, p_mesh, flags, p_format, objpar_internal_thread_count(thread_count));
+}
+#endif
+
+objpar_size_t objpar_internal_build_mesh(const struct objpar_data* p_data, void* p_buffer, struct objpar_mesh* p_mesh, unsigned int flags, const struct objpar_vertex_format* p_format, unsigned int range_count)
+{
+    unsigned int* p_faces;
+    unsigned int* p_indices;
+    unsigned int* p_table;
+    unsigned int* p_scratch;
+    unsigned int* p_triangles;
+    struct objpar_submesh* p_submeshes;
+    const struct objpar_group* p_groups;
+    struct objpar_group whole;
+    struct objpar_mesh layout;
+    struct objpar_internal_mesh_gen gen;
+    struct objpar_internal_expand expand;
+    unsigned int stride;
+    unsigned int max_face_width;
+    unsigned int corner_count;
+    objpar_internal_u64 total_corner_count;
+    objpar_internal_u64 total_buffer_size;
+    objpar_internal_u64 gen_size;
+    objpar_size_t index_region_size;
+    objpar_size_t table_size;
+    objpar_size_t gen_table_size;
+    unsigned int table_mask;
+    objpar_size_t scratch_size;
+    objpar_size_t submesh_region_size;
+    unsigned int group_count;
+    unsigned int submesh_count;
+    unsigned int material;
+    unsigned int vertex_count;
+    unsigned int corner;
+    unsigned int face;
+    unsigned int group;
+    char* p_vertices;
+
+    /* Any simple polygon with n corners becomes n - 2 triangles with both
+       fan and ear clipping, so the output size is known before building.
+       Faces with less than 3 corners are skipped. */
+    total_corner_count = 0;
+    max_face_width = 3;
+    for (face = 0; face < p_data->face_count; ++face)
+    {
+        unsigned int face_width = p_data->p_face_offsets[face + 1] - p_data->p_face_offsets[face];
+        if (face_width >= 3)
+            total_corner_count += (objpar_internal_u64)(face_width - 2) * 3;
+        if (face_width > max_face_width)
+            max_face_width = face_width;
+    }
+
+    if (total_corner_count == 0)
+    {
+        /* Points and lines don't produce triangles. */
+        return 0;
+    }
+    if (total_corner_count >= OBJPAR_NONE)
+    {
+        /* Indices and submesh ranges are 32 bit. */
+        return 0;
+    }
+    corner_count = (unsigned int)total_corner_count;
+
+    stride = objpar_internal_mesh_layout(p_data, p_format, flags, corner_count, &layout);
+    if (stride == 0)
+    {
+        /* Unsupported format for one of the attributes */
+        return 0;
+    }
+    if ((flags & OBJPAR_MESH_DEINTERLEAVE) &&
+        (objpar_internal_u64)corner_count * stride > 0x7FFFFFFF)
+    {
+        /* Stream offsets are stored as int. */
+        return 0;
+    }
+    scratch_size = ((objpar_size_t)(max_face_width - 2) * 3 + max_face_width) * sizeof(unsigned int) + (objpar_size_t)max_face_width * 2 * sizeof(float);
+    submesh_region_size = ((objpar_size_t)p_data->material_count + 1) * sizeof(struct objpar_submesh);
+    index_region_size = 0;
+    table_size = 0;
+    table_mask = 0;
+
+    if (flags & OBJPAR_MESH_INDEXED)
+    {
+        /* The table keeps at most half of its slots in use so probe
+           sequences stay short. Slots are addressed with a 32 bit hash,
+           so larger meshes have to be built without indices. */
+        if (corner_count >= 0x80000000u)
+            return 0;
+        table_size = 16;
+        while (table_size < (objpar_size_t)corner_count * 2 && table_size < 0x80000000u)
+            table_size *= 2;
+        table_mask = (unsigned int)(table_size - 1);
+        index_region_size = (objpar_size_t)corner_count * sizeof(unsigned int);
+    }
+
+    if (!objpar_internal_mesh_gen_size(p_data, flags, &gen_size, &gen_table_size))
+    {
+        return 0;
+    }
+
+    total_buffer_size = (objpar_internal_u64)submesh_region_size + index_region_size + (objpar_internal_u64)corner_count * stride + (objpar_internal_u64)table_size * 4 * sizeof(unsigned int) + scratch_size + gen_size;
+    if (total_buffer_size > (objpar_size_t)-1)
+    {
+        /* Doesn't fit in the address space */
+        return 0;
+    }
+
+    /* Buffer layout: [submeshes][indices][vertices][table][scratch][gen].
+       The vertex region is sized for the worst case where no corner is
+       shared, the table, the triangulation scratch and the generated
+       normals and tangents are only used while building. */
+    if (p_buffer == OBJPAR_NULL(void) ||
+        p_mesh == OBJPAR_NULL(void))
+    {
+        return (objpar_size_t)total_buffer_size;
+    }
+
+    p_faces = p_data->p_faces;
+    p_submeshes = (struct objpar_submesh*)p_buffer;
+    p_indices = (unsigned int*)((char*)p_buffer + submesh_region_size);
+    p_vertices = (char*)p_indices + index_region_size;
+    p_table = (unsigned int*)(p_vertices + (objpar_size_t)corner_count * stride);
+    p_scratch = p_table + table_size * 4;
+    p_triangles = p_scratch;
+    objpar_internal_mesh_gen_layout(p_data, flags, gen_table_size, (char*)p_scratch + scratch_size, &gen);
+
+    if (flags & OBJPAR_MESH_INDEXED)
+    {
+        /* Each slot holds the v/vt/vn key inline next to the vertex index,
+           so a lookup touches a single cache line instead of chasing the
+           first corner that produced the vertex. */
+        memset(p_table, 0xFF, table_size * 4 * sizeof(unsigned int));
+    }
+
+    layout.p_vertices = p_vertices;
+    vertex_count = 0;
+    corner = 0;
+    submesh_count = 0;
+
+    p_groups = p_data->p_groups;
+    group_count = p_data->group_count;
+    if (group_count == 0)
+    {
+        whole.face_begin = 0;
+        whole.face_count = p_data->face_count;
+        whole.object = OBJPAR_NONE;
+        whole.group = OBJPAR_NONE;
+        whole.material = OBJPAR_NONE;
+        whole.smoothing = 0;
+        p_groups = &whole;
+        group_count = 1;
+    }
+
+    if (gen_size > 0)
+    {
+        objpar_internal_mesh_generate(p_data, p_groups, group_count, flags, p_scratch, &gen);
+    }
+
+    /* Faces are emitted material by material, so each material ends up as
+       a single range the renderer can draw without sorting the faces. */
+    if (!(flags & OBJPAR_MESH_INDEXED))
+    {
+        /* Without indices every corner is written on its own and can be
+           expanded in parallel. */
+        expand.p_data = p_data;
+        expand.p_groups = p_groups;
+        expand.p_layout = &layout;
+        expand.p_gen = (gen_size > 0 ? &gen : OBJPAR_NULL(const struct objpar_internal_mesh_gen));
+        expand.p_scratch = p_scratch;
+        expand.group_count = group_count;
+        expand.flags = flags;
+        expand.kernel = (gen_size > 0 ? 0 : objpar_internal_expand_kernel(p_data, &layout));
+        expand.zero[0] = 0.0f;
+        expand.zero[1] = 0.0f;
+        expand.zero[2] = 0.0f;
+        submesh_count = objpar_internal_mesh_expand(&expand, corner_count, max_face_width, range_count, p_submeshes);
+    }
+    else
+    {
+        for (material = 0; material <= p_data->material_count; ++material)
+        {
+            unsigned int material_index = (material < p_data->material_count ? material : OBJPAR_NONE);
+            unsigned int first = corner;
+
+            for (group = 0; group < group_count; ++group)
+            {
+                if (p_groups[group].material != material_index)
+                    continue;
+
+                for (face = p_groups[group].face_begin; face < p_groups[group].face_begin + p_groups[group].face_count; ++face)
+                {
+                    const unsigned int* p_face;
+                    unsigned int triangle_corner_count;
+                    unsigned int index;
+
+                    p_face = &p_faces[(objpar_size_t)p_data->p_face_offsets[face] * 3];
+                    triangle_corner_count = objpar_internal_triangulate(p_data, p_face, p_data->p_face_offsets[face + 1] - p_data->p_face_offsets[face], flags, p_scratch) * 3;
+
+                    for (index = 0; index < triangle_corner_count; ++index, ++corner)
+                    {
+                        const unsigned int* p_corner;
+                        const unsigned int* p_key;
+                        unsigned int key[3];
+                        objpar_size_t face_corner;
+                        unsigned int slot;
+
+                        p_corner = &p_face[p_triangles[index] * 3];
+                        face_corner = (objpar_size_t)p_data->p_face_offsets[face] + p_triangles[index];
+
+                        /* Generated normals replace vn in the key so corners only
+                           share a vertex when they share the generated normal. */
+                        p_key = p_corner;
+                        if (gen_size > 0)
+                        {
+                            objpar_internal_mesh_gen_key(p_data, &gen, p_corner, face_corner, key);
+                            p_key = key;
+                        }
+                        slot = objpar_internal_mesh_hash(p_key) & table_mask;
+
+                        for (;;)
+                        {
+                            unsigned int* p_slot = &p_table[(objpar_size_t)slot * 4];
+
+                            if (p_slot[3] == 0xFFFFFFFF)
+                            {
+                                p_slot[0] = p_key[OBJPAR_V_IDX];
+                                p_slot[1] = p_key[OBJPAR_VT_IDX];
+                                p_slot[2] = p_key[OBJPAR_VN_IDX];
+                                p_slot[3] = vertex_count;
+                                objpar_internal_mesh_vertex(p_data, &layout, p_corner, vertex_count);
+                                if (gen_size > 0)
+                                    objpar_internal_mesh_gen_vertex(&gen, &layout, face_corner, vertex_count);
+                                p_indices[corner] = vertex_count++;
+                                break;
+                            }
+                            if (p_slot[0] == p_key[OBJPAR_V_IDX] &&
+                                p_slot[1] == p_key[OBJPAR_VT_IDX] &&
+                                p_slot[2] == p_key[OBJPAR_VN_IDX])
+                            {
+                                p_indices[corner] = p_slot[3];
+                                break;
+                            }
+                            slot = (slot + 1) & table_mask;
+                        }
+                    }
+                }
+            }
+
+            if (corner > first)
+            {
+                p_submeshes[submesh_count].first = first;
+                p_submeshes[submesh_count].count = corner - first;
+                p_submeshes[submesh_count].material = material_index;
+                submesh_count += 1;
+            }
+        }
+    }
+
+    if ((flags & OBJPAR_MESH_INDEXED) && (flags & OBJPAR_MESH_DEINTERLEAVE))
+    {
+        /* Streams were placed for the worst case, move them next to each
+           other now that the number of unique vertices is known. */
+        struct objpar_mesh compact;
+
+        objpar_internal_mesh_layout(p_data, p_format, flags, vertex_count, &compact);
+        if (compact.texcoord_offset > 0)
+            memmove(p_vertices + compact.texcoord_offset, p_vertices + layout.texcoord_offset, (objpar_size_t)vertex_count * compact.texcoord_stride);
+        if (compact.normal_offset > 0)
+            memmove(p_vertices + compact.normal_offset, p_vertices + layout.normal_offset, (objpar_size_t)vertex_count * compact.normal_stride);
+        if (compact.tangent_offset > 0)
+            memmove(p_vertices + compact.tangent_offset, p_vertices + layout.tangent_offset, (objpar_size_t)vertex_count * compact.tangent_stride);
+        layout = compact;
+        layout.p_vertices = p_vertices;
+    }
+
+    *p_mesh = layout;
+    p_mesh->vertex_count = corner_count;
+    p_mesh->p_indices = OBJPAR_NULL(void);
+    p_mesh->index_count = 0;
+    p_mesh->index_size = 0;
+    p_mesh->p_submeshes = p_submeshes;
+    p_mesh->submesh_count = submesh_count;
+
+    if (flags & OBJPAR_MESH_INDEXED)
+    {
+        p_mesh->vertex_count = vertex_count;
+        p_mesh->p_indices = p_indices;
+        p_mesh->index_count = corner_count;
+        p_mesh->index_size = sizeof(unsigned int);
+
+        if (vertex_count <= 65536)
+        {
+            /* Narrow in place. Entry i is written at byte 2i after entry i was
+               read from byte 4i, so nothing is overwritten before it's read.
+               memcpy keeps the compiler from assuming the two views don't alias. */
+            char* p_bytes = (char*)p_indices;
+            for (corner = 0; corner < corner_count; ++corner)
+            {
+                unsigned int wide_index;
+                unsigned short short_index;
+
+                memcpy(&wide_index, p_bytes + (objpar_size_t)corner * sizeof(unsigned int), sizeof(unsigned int));
+                short_index = (unsigned short)wide_index;
+                memcpy(p_bytes + (objpar_size_t)corner * sizeof(unsigned short), &short_index, sizeof(unsigned short));
+            }
+            p_mesh->index_size = sizeof(unsigned short);
+        }
+    }
+
+    return 1;
+}
+
+objpar_size_t objpar_optimize_mesh(struct objpar_mesh* p_mesh, unsigned int cache_size, void* p_scratch)
+{
+    struct objpar_internal_tipsify state;
+    struct objpar_submesh whole;
+    const struct objpar_submesh* p_submeshes;
+    unsigned int* p_remap;
+    char* p_vertices;
+    char* p_copy;
+    objpar_internal_u64 order_size;
+    objpar_internal_u64 fetch_size;
+    unsigned int submesh_count;
+    unsigned int triangle_count;
+    unsigned int index_count;
+    unsigned int vertex_count;
+    unsigned int submesh;
+    unsigned int index;
+    unsigned int vertex;
+    unsigned int next;
+
+    if (p_mesh->index_size == 0 || p_mesh->index_count < 3 || p_mesh->vertex_count == 0)
+    {
+        /* A triangle soup has no vertex to reuse, build it indexed. */
+        return 0;
+    }
+    vertex_count = p_mesh->vertex_count;
+    triangle_count = p_mesh->index_count / 3;
+    index_count = triangle_count * 3;
+
+    /* Scratch layout: [offsets][adjacency][live][stamps][stack][order][emitted]
+       while the triangles are reordered and [remap][vertices] while the
+       vertices are, so the larger of both is needed. */
+    order_size = ((objpar_internal_u64)vertex_count * 3 + 1 + (objpar_internal_u64)index_count * 3) * sizeof(unsigned int) + triangle_count;
+    fetch_size = (objpar_internal_u64)vertex_count * (sizeof(unsigned int) + p_mesh->vertex_stride);
+    if (fetch_size > order_size)
+        order_size = fetch_size;
+    if (order_size > (objpar_size_t)-1)
+    {
+        /* Doesn't fit in the address space */
+        return 0;
+    }
+    if (p_scratch == OBJPAR_NULL(void))
+    {
+        return (objpar_size_t)order_size;
+    }
+
+    p_submeshes = p_mesh->p_submeshes;
+    submesh_count = p_mesh->submesh_count;
+    if (submesh_count == 0 || p_submeshes == OBJPAR_NULL(struct objpar_submesh))
+    {
+        whole.first = 0;
+        whole.count = index_count;
+        whole.material = OBJPAR_NONE;
+        p_submeshes = &whole;
+        submesh_count = 1;
+    }
+    for (submesh = 0; submesh < submesh_count; ++submesh)
+    {
+        /* Triangles never move between draw ranges */
+        if (p_submeshes[submesh].first % 3 != 0 || p_submeshes[submesh].count % 3 != 0 ||
+            p_submeshes[submesh].first > index_count || p_submeshes[submesh].count > index_count - p_submeshes[submesh].first)
+            return 0;
+    }
+
+    if (cache_size == 0)
+        cache_size = OBJPAR_VERTEX_CACHE_SIZE;
+    if (cache_size > OBJPAR_INTERNAL_MAX_CACHE_SIZE)
+        cache_size = OBJPAR_INTERNAL_MAX_CACHE_SIZE;
+
+    state.p_offsets = (unsigned int*)p_scratch;
+    state.p_adjacency = state.p_offsets + (objpar_size_t)vertex_count + 1;
+    state.p_live = state.p_adjacency + index_count;
+    state.p_stamps = state.p_live + vertex_count;
+    state.p_stack = state.p_stamps + vertex_count;
+    state.p_order = state.p_stack + index_count;
+    state.p_emitted = (unsigned char*)(state.p_order + index_count);
+    state.cache_size = cache_size;
+    state.time = cache_size + 1;
+
+    /* Triangles of each vertex are grouped with a counting sort, p_live is
+       used as the fill cursor and cleared again for the submeshes. */
+    memset(state.p_offsets, 0, ((objpar_size_t)vertex_count + 1) * sizeof(unsigned int));
+    memset(state.p_live, 0, (objpar_size_t)vertex_count * sizeof(unsigned int));
+    memset(state.p_stamps, 0, (objpar_size_t)vertex_count * sizeof(unsigned int));
+    memset(state.p_emitted, 0, triangle_count);
+    for (index = 0; index < index_count; ++index)
+    {
+        vertex = objpar_internal_mesh_index(p_mesh, index);
+        if (vertex >= vertex_count)
+            return 0;
+        state.p_offsets[vertex + 1] += 1;
+    }
+    for (vertex = 0; vertex < vertex_count; ++vertex)
+    {
+        state.p_offsets[vertex + 1] += state.p_offsets[vertex];
+    }
+    for (index = 0; index < index_count; ++index)
+    {
+        vertex = objpar_internal_mesh_index(p_mesh, index);
+        state.p_adjacency[state.p_offsets[vertex] + state.p_live[vertex]] = index / 3;
+        state.p_live[vertex] += 1;
+    }
+    memset(state.p_live, 0, (objpar_size_t)vertex_count * sizeof(unsigned int));
+
+    for (submesh = 0; submesh < submesh_count; ++submesh)
+    {
+        objpar_internal_mesh_tipsify(p_mesh, &state, p_submeshes[submesh].first, p_submeshes[submesh].count);
+    }
+
+    /* Vertices are renumbered in the order the new index buffer first uses
+       them, so fetching them walks the vertex buffer forward. Vertices no
+       triangle uses keep their relative order at the end. */
+    p_remap = (unsigned int*)p_scratch;
+    p_copy = (char*)(p_remap + vertex_count);
+    p_vertices = (char*)p_mesh->p_vertices;
+    memset(p_remap, 0xFF, (objpar_size_t)vertex_count * sizeof(unsigned int));
+    next = 0;
+    for (index = 0; index < index_count; ++index)
+    {
+        vertex = objpar_internal_mesh_index(p_mesh, index);
+        if (p_remap[vertex] == OBJPAR_NONE)
+            p_remap[vertex] = next++;
+        objpar_internal_mesh_set_index(p_mesh, index, p_remap[vertex]);
+    }
+    for (vertex = 0; vertex < vertex_count; ++vertex)
+    {
+        if (p_remap[vertex] == OBJPAR_NONE)
+            p_remap[vertex] = next++;
+    }
+
+    /* Interleaved and de-interleaved vertices both take vertex_count *
+       vertex_stride bytes from p_vertices. */
+    memcpy(p_copy, p_vertices, (objpar_size_t)vertex_count * p_mesh->vertex_stride);
+    if ((p_mesh->position_offset < 0 || p_mesh->position_stride == p_mesh->vertex_stride) &&
+        (p_mesh->texcoord_offset < 0 || p_mesh->texcoord_stride == p_mesh->vertex_stride) &&
+        (p_mesh->normal_offset < 0 || p_mesh->normal_stride == p_mesh->vertex_stride) &&
+        (p_mesh->tangent_offset < 0 || p_mesh->tangent_stride == p_mesh->vertex_stride))
+    {
+        objpar_internal_mesh_permute(p_vertices, p_copy, 0, p_mesh->vertex_stride, p_remap, vertex_count);
+    }
+    else
+    {
+        objpar_internal_mesh_permute(p_vertices, p_copy, p_mesh->position_offset, p_mesh->position_stride, p_remap, vertex_count);
+        objpar_internal_mesh_permute(p_vertices, p_copy, p_mesh->texcoord_offset, p_mesh->texcoord_stride, p_remap, vertex_count);
+        objpar_internal_mesh_permute(p_vertices, p_copy, p_mesh->normal_offset, p_mesh->normal_stride, p_remap, vertex_count);
+        objpar_internal_mesh_permute(p_vertices, p_copy, p_mesh->tangent_offset, p_mesh->tangent_stride, p_remap, vertex_count);
+    }
+
+    return 1;
+}
+
+objpar_size_t objpar_mesh_stats(const struct objpar_mesh* p_mesh, unsigned int cache_size, void* p_scratch, struct objpar_mesh_stats* p_stats)
+{
+    unsigned int* p_stamps;
+    unsigned int index_count;
+    unsigned int transform_count;
+    unsigned int index;
+
+    /* Corners of a triangle soup are their own vertices */
+    index_count = (p_mesh->index_size > 0 ? p_mesh->index_count : p_mesh->vertex_count);
+    if (index_count < 3 || p_mesh->vertex_count == 0)
+    {
+        return 0;
+    }
+    if (p_scratch == OBJPAR_NULL(void) ||
+        p_stats == OBJPAR_NULL(struct objpar_mesh_stats))
+    {
+        return (objpar_size_t)p_mesh->vertex_count * sizeof(unsigned int);
+    }
+
+    if (cache_size == 0)
+        cache_size = OBJPAR_VERTEX_CACHE_SIZE;
+    if (cache_size > OBJPAR_INTERNAL_MAX_CACHE_SIZE)
+        cache_size = OBJPAR_INTERNAL_MAX_CACHE_SIZE;
+
+    index_count -= index_count % 3;
+    for (index = 0; index < index_count; ++index)
+    {
+        if (objpar_internal_mesh_index(p_mesh, index) >= p_mesh->vertex_count)
+            return 0;
+    }
+    p_stamps = (unsigned int*)p_scratch;
+    memset(p_stamps, 0, (objpar_size_t)p_mesh->vertex_count * sizeof(unsigned int));
+    transform_count = objpar_internal_mesh_transforms(p_mesh, OBJPAR_NULL(unsigned int), 0, index_count, cache_size, p_stamps);
+
+    p_stats->transform_count = transform_count;
+    p_stats->triangle_count = index_count / 3;
+    p_stats->acmr = (float)transform_count / (float)p_stats->triangle_count;
+    p_stats->atvr = (float)transform_count / (float)p_mesh->vertex_count;
+    return 1;
+}
+
+objpar_size_t objpar_build_meshlets(const struct objpar_data* p_data, const struct objpar_mesh* p_mesh, unsigned int max_vertices, unsigned int max_triangles, void* p_buffer, struct objpar_meshlets* p_meshlets)
+{
+    struct objpar_submesh whole;
+    const struct objpar_submesh* p_submeshes;
+    struct objpar_meshlet* p_meshlet;
+    unsigned int* p_local;
+    objpar_internal_u64 meshlet_capacity;
+    objpar_internal_u64 vertex_capacity;
+    objpar_internal_u64 total_buffer_size;
+    objpar_size_t meshlet_region_size;
+    objpar_size_t vertex_region_size;
+    objpar_size_t triangle_region_size;
+    unsigned int submesh_count;
+    unsigned int index_count;
+    unsigned int submesh;
+    unsigned int index;
+
+    if (max_vertices == 0)
+        max_vertices = OBJPAR_MESHLET_MAX_VERTICES;
+    if (max_triangles == 0)
+        max_triangles = OBJPAR_MESHLET_MAX_TRIANGLES;
+    if (max_vertices < 3 || max_vertices > 256 || max_triangles > 512)
+    {
+        /* Local indices are 8 bit */
+        return 0;
+    }
+
+    /* Corners of a triangle soup are their own vertices */
+    index_count = (p_mesh->index_size > 0 ? p_mesh->index_count : p_mesh->vertex_count);
+    index_count -= index_count % 3;
+    if (index_count == 0 || p_data->position_count == 0 || p_mesh->position_offset < 0)
+    {
+        return 0;
+    }
+
+    p_submeshes = p_mesh->p_submeshes;
+    submesh_count = p_mesh->submesh_count;
+    if (submesh_count == 0 || p_submeshes == OBJPAR_NULL(struct objpar_submesh))
+    {
+        whole.first = 0;
+        whole.count = index_count;
+        whole.material = OBJPAR_NONE;
+        p_submeshes = &whole;
+        submesh_count = 1;
+    }
+
+    /* A meshlet is only closed early when the next triangle brings more
+       vertices than fit, so it has at least max_vertices - 2 of them and
+       needs max_vertices / 3 triangles for that. Every submesh can end
+       with one more partial meshlet. */
+    meshlet_capacity = (objpar_internal_u64)(index_count / 3) / (max_triangles < max_vertices / 3 ? max_triangles : max_vertices / 3) + submesh_count;
+    vertex_capacity = meshlet_capacity * max_vertices;
+    if (vertex_capacity > index_count)
+        vertex_capacity = index_count;
+    total_buffer_size = meshlet_capacity * sizeof(struct objpar_meshlet) + vertex_capacity * sizeof(unsigned int) +
+        (((objpar_internal_u64)index_count + 3) & ~(objpar_internal_u64)3) + (objpar_internal_u64)p_mesh->vertex_count * sizeof(unsigned int);
+    if (total_buffer_size > (objpar_size_t)-1)
+    {
+        /* Doesn't fit in the address space */
+        return 0;
+    }
+
+    /* Buffer layout: [meshlets][vertices][triangles][scratch]. The
+       scratch maps a mesh vertex to its index in the open meshlet. */
+    if (p_buffer == OBJPAR_NULL(void) ||
+        p_meshlets == OBJPAR_NULL(struct objpar_meshlets))
+    {
+        return (objpar_size_t)total_buffer_size;
+    }
+
+    meshlet_region_size = (objpar_size_t)meshlet_capacity * sizeof(struct objpar_meshlet);
+    vertex_region_size = (objpar_size_t)vertex_capacity * sizeof(unsigned int);
+    triangle_region_size = ((objpar_size_t)index_count + 3) & ~(objpar_size_t)3;
+    p_meshlets->p_meshlets = (struct objpar_meshlet*)p_buffer;
+    p_meshlets->p_vertices = (unsigned int*)((char*)p_buffer + meshlet_region_size);
+    p_meshlets->p_triangles = (unsigned char*)p_meshlets->p_vertices + vertex_region_size;
+    p_meshlets->meshlet_count = 0;
+    p_meshlets->vertex_count = 0;
+    p_meshlets->triangle_count = 0;
+    p_local = (unsigned int*)(p_meshlets->p_triangles + triangle_region_size);
+    memset(p_local, 0xFF, (objpar_size_t)p_mesh->vertex_count * sizeof(unsigned int));
+
+    /* Triangles are taken in index buffer order, so meshlets follow the
+       locality of the mesh. Running objpar_optimize_mesh first gives
+       tighter clusters. */
+    for (submesh = 0; submesh < submesh_count; ++submesh)
+    {
+        unsigned int first = p_submeshes[submesh].first;
+        unsigned int count = p_submeshes[submesh].count;
+
+        if (first % 3 != 0 || count % 3 != 0 || first > index_count || count > index_count - first)
+            return 0;
+
+        p_meshlet = OBJPAR_NULL(struct objpar_meshlet);
+        for (index = first; index < first + count; index += 3)
+        {
+            unsigned int corners[3];
+            unsigned int new_count;
+            unsigned int corner;
+
+            corners[0] = objpar_internal_mesh_index(p_mesh, index);
+            corners[1] = objpar_internal_mesh_index(p_mesh, index + 1);
+            corners[2] = objpar_internal_mesh_index(p_mesh, index + 2);
+            if (corners[0] >= p_mesh->vertex_count || corners[1] >= p_mesh->vertex_count || corners[2] >= p_mesh->vertex_count)
+                return 0;
+            new_count = (p_local[corners[0]] == OBJPAR_NONE) +
+                (p_local[corners[1]] == OBJPAR_NONE && corners[1] != corners[0]) +
+                (p_local[corners[2]] == OBJPAR_NONE && corners[2] != corners[0] && corners[2] != corners[1]);
+
+            if (p_meshlet != OBJPAR_NULL(struct objpar_meshlet) &&
+                (p_meshlet->vertex_count + new_count > max_vertices || p_meshlet->triangle_count == max_triangles))
+            {
+                objpar_internal_meshlet_close(p_mesh, p_data->position_width, p_meshlets, p_meshlet, p_local);
+                p_meshlet = OBJPAR_NULL(struct objpar_meshlet);
+            }
+            if (p_meshlet == OBJPAR_NULL(struct objpar_meshlet))
+            {
+                p_meshlet = &p_meshlets->p_meshlets[p_meshlets->meshlet_count++];
+                memset(p_meshlet, 0, sizeof(struct objpar_meshlet));
+                p_meshlet->vertex_offset = p_meshlets->vertex_count;
+                p_meshlet->triangle_offset = p_meshlets->triangle_count * 3;
+                p_meshlet->material = p_submeshes[submesh].material;
+            }
+
+            for (corner = 0; corner < 3; ++corner)
+            {
+                unsigned int vertex = corners[corner];
+
+                if (p_local[vertex] == OBJPAR_NONE)
+                {
+                    p_local[vertex] = p_meshlet->vertex_count++;
+                    p_meshlets->p_vertices[p_meshlets->vertex_count++] = vertex;
+                }
+                p_meshlets->p_triangles[(objpar_size_t)p_meshlets->triangle_count * 3 + corner] = (unsigned char)p_local[vertex];
+            }
+            p_meshlet->triangle_count += 1;
+            p_meshlets->triangle_count += 1;
+        }
+        if (p_meshlet != OBJPAR_NULL(struct objpar_meshlet))
+        {
+            objpar_internal_meshlet_close(p_mesh, p_data->position_width, p_meshlets, p_meshlet, p_local);
+        }
+    }
+
+    return 1;
+}
+
+objpar_hash_t objpar_hash(const void* p_data, objpar_size_t size)
+{
+    const unsigned char* p_bytes;
+    objpar_internal_u64 hash;
+    objpar_internal_u64 word;
+    objpar_size_t index;
+
+    /* FNV-1a over 8 byte words instead of single bytes so hashing a source
+       file is cheap next to parsing it, with a final avalanche so the
+       trailing bytes affect every bit. */
+    p_bytes = (const unsigned char*)p_data;
+    hash = OBJPAR_INTERNAL_U64(0xCBF29CE4UL, 0x84222325UL) ^ (objpar_internal_u64)size;
+    for (index = 0; index + 8 <= size; index += 8)
+    {
+        memcpy(&word, p_bytes + index, sizeof(word));
+        hash = (hash ^ word) * OBJPAR_INTERNAL_U64(0x00000100UL, 0x000001B3UL);
+        hash ^= hash >> 29;
+    }
+    for (; index < size; ++index)
+    {
+        hash = (hash ^ p_bytes[index]) * OBJPAR_INTERNAL_U64(0x00000100UL, 0x000001B3UL);
+    }
+    hash ^= hash >> 33;
+    hash *= OBJPAR_INTERNAL_U64(0xFF51AFD7UL, 0xED558CCDUL);
+    hash ^= hash >> 33;
+    return hash;
+}
+
+objpar_size_t objpar_cache_write(const struct objpar_data* p_data, const struct objpar_mesh* p_mesh, objpar_size_t source_size, objpar_hash_t source_hash, void* p_buffer)
+{
+    struct objpar_internal_cache_header header;
+    objpar_internal_u64 sizes[OBJPAR_INTERNAL_CACHE_ARRAYS];
+    const void* p_arrays[OBJPAR_INTERNAL_CACHE_ARRAYS];
+    objpar_internal_u64 total_size;
+    unsigned int i;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = OBJPAR_CACHE_MAGIC;
+    header.version = OBJPAR_CACHE_VERSION;
+    header.header_size = sizeof(header);
+    header.source_size = (objpar_internal_u64)source_size;
+    header.source_hash = source_hash;
+    header.data = *p_data;
+    header.data.p_positions = OBJPAR_NULL(float);
+    header.data.p_texcoords = OBJPAR_NULL(float);
+    header.data.p_normals = OBJPAR_NULL(float);
+    header.data.p_faces = OBJPAR_NULL(unsigned int);
+    header.data.p_face_offsets = OBJPAR_NULL(unsigned int);
+    header.data.p_groups = OBJPAR_NULL(struct objpar_group);
+    header.data.p_materials = OBJPAR_NULL(unsigned int);
+    header.data.p_libraries = OBJPAR_NULL(unsigned int);
+    header.data.p_names = OBJPAR_NULL(char);
+    if (p_mesh != OBJPAR_NULL(struct objpar_mesh))
+    {
+        header.has_mesh = 1;
+        header.mesh = *p_mesh;
+        header.mesh.p_vertices = OBJPAR_NULL(void);
+        header.mesh.p_indices = OBJPAR_NULL(void);
+        header.mesh.p_submeshes = OBJPAR_NULL(struct objpar_submesh);
+    }
+
+    objpar_internal_cache_sizes(&header, sizes);
+    p_arrays[0] = p_data->p_positions;
+    p_arrays[1] = p_data->p_texcoords;
+    p_arrays[2] = p_data->p_normals;
+    p_arrays[3] = p_data->p_faces;
+    p_arrays[4] = p_data->p_face_offsets;
+    p_arrays[5] = (header.has_mesh ? p_mesh->p_vertices : OBJPAR_NULL(void));
+    p_arrays[6] = (header.has_mesh ? p_mesh->p_indices : OBJPAR_NULL(void));
+    p_arrays[7] = p_data->p_groups;
+    p_arrays[8] = p_data->p_materials;
+    p_arrays[9] = p_data->p_libraries;
+    p_arrays[10] = p_data->p_names;
+    p_arrays[11] = (header.has_mesh ? p_mesh->p_submeshes : OBJPAR_NULL(struct objpar_submesh));
+
+    /* Every array starts on an OBJPAR_CACHE_ALIGNMENT boundary so the
+       loader can point straight into the mapped file. */
+    total_size = objpar_internal_cache_align(sizeof(header));
+    for (i = 0; i < OBJPAR_INTERNAL_CACHE_ARRAYS; ++i)
+    {
+        header.offsets[i] = (sizes[i] > 0 ? total_size : 0);
+        total_size = objpar_internal_cache_align(total_size + sizes[i]);
+    }
+
+    if (total_size > (objpar_size_t)-1)
+    {
+        return 0;
+    }
+
+    if (p_buffer == OBJPAR_NULL(void))
+    {
+        return (objpar_size_t)total_size;
+    }
+
+    memset(p_buffer, 0, (objpar_size_t)total_size);
+    memcpy(p_buffer, &header, sizeof(header));
+    for (i = 0; i < OBJPAR_INTERNAL_CACHE_ARRAYS; ++i)
+    {
+        if (sizes[i] > 0)
+            memcpy((char*)p_buffer + header.offsets[i], p_arrays[i], (objpar_size_t)sizes[i]);
+    }
+    return 1;
+}
+
+unsigned int objpar_cache_load(const void* p_cache, objpar_size_t cache_size, objpar_size_t source_size, objpar_hash_t source_hash, struct objpar_data* p_data, struct objpar_mesh* p_mesh)
+{
+    struct objpar_internal_cache_header header;
+    objpar_internal_u64 sizes[OBJPAR_INTERNAL_CACHE_ARRAYS];
+    void* p_arrays[OBJPAR_INTERNAL_CACHE_ARRAYS];
+    unsigned int i;
+
+    /* Only the header is read, the arrays are used in place. The header
+       size rejects caches written with a different pointer size and the
+       magic rejects the ones written with a different byte order. */
+    if (cache_size < sizeof(header) || ((objpar_size_t)p_cache & (sizeof(float) - 1)) != 0)
+        return 0;
+
+    memcpy(&header, p_cache, sizeof(header));
+    if (header.magic != OBJPAR_CACHE_MAGIC ||
+        header.version != OBJPAR_CACHE_VERSION ||
+        header.header_size != sizeof(header) ||
+        header.source_size != (objpar_internal_u64)source_size ||
+        header.source_hash != source_hash)
+    {
+        return 0;
+    }
+
+    if (p_mesh != OBJPAR_NULL(struct objpar_mesh) && !header.has_mesh)
+        return 0;
+
+    objpar_internal_cache_sizes(&header, sizes);
+    for (i = 0; i < OBJPAR_INTERNAL_CACHE_ARRAYS; ++i)
+    {
+        p_arrays[i] = OBJPAR_NULL(void);
+        if (sizes[i] == 0)
+            continue;
+        if (header.offsets[i] < sizeof(header) ||
+            header.offsets[i] > (objpar_internal_u64)cache_size ||
+            sizes[i] > (objpar_internal_u64)cache_size - header.offsets[i] ||
+            (header.offsets[i] & (sizeof(float) - 1)) != 0)
+        {
+            return 0;
+        }
+        p_arrays[i] = (void*)((const char*)p_cache + header.offsets[i]);
+    }
+
+    *p_data = header.data;
+    p_data->p_positions = (float*)p_arrays[0];
+    p_data->p_texcoords = (float*)p_arrays[1];
+    p_data->p_normals = (float*)p_arrays[2];
+    p_data->p_faces = (unsigned int*)p_arrays[3];
+    p_data->p_face_offsets = (unsigned int*)p_arrays[4];
+    p_data->p_groups = (struct objpar_group*)p_arrays[7];
+    p_data->p_materials = (unsigned int*)p_arrays[8];
+    p_data->p_libraries = (unsigned int*)p_arrays[9];
+    p_data->p_names = (char*)p_arrays[10];
+
+    if (p_mesh != OBJPAR_NULL(struct objpar_mesh))
+    {
+        *p_mesh = header.mesh;
+        p_mesh->p_vertices = p_arrays[5];
+        p_mesh->p_indices = p_arrays[6];
+        p_mesh->p_submeshes = (struct objpar_submesh*)p_arrays[11];
+    }
+    return 1;
+}
+
+unsigned int objpar_internal_count(const char* p_string, objpar_size_t begin, objpar_size_t end, struct objpar_data* p_counts)
+{
+    struct objpar_data range_counts;
+    objpar_size_t range_end;
+
+    /* Every record takes at least 2 bytes, so a range of
+       OBJPAR_INTERNAL_COUNT_RANGE bytes can't overflow a 32 bit count.
+       Larger inputs are counted in such ranges and merged, which fails
+       once a count no longer fits. */
+    if (end - begin <= OBJPAR_INTERNAL_COUNT_RANGE)
+    {
+        objpar_internal_count_range(p_string, begin, end, p_counts);
+        return 1;
+    }
+
+    memset(p_counts, 0, sizeof(struct objpar_data));
+    for (; begin < end; begin = range_end)
+    {
+        range_end = end;
+        if (end - begin > OBJPAR_INTERNAL_COUNT_RANGE)
+            range_end = objpar_internal_line_end(p_string, begin + OBJPAR_INTERNAL_COUNT_RANGE, end) + 1;
+        if (range_end > end)
+            range_end = end;
+        objpar_internal_count_range(p_string, begin, range_end, &range_counts);
+        if (!objpar_internal_merge(p_counts, &range_counts))
+            return 0;
+    }
+    return 1;
+}
+
+void objpar_internal_count_range(const char* p_string, objpar_size_t begin, objpar_size_t end, struct objpar_data* p_counts)
+{
+    objpar_size_t index;
+    objpar_size_t last_v;
+    objpar_size_t last_vn;
+    objpar_size_t last_vt;
+    unsigned int face_width;
+    unsigned int mixed_faces;
+
+    memset(p_counts, 0, sizeof(struct objpar_data));
+    index = begin;
+    last_v = begin;
+    last_vn = begin;
+    last_vt = begin;
+    face_width = 0;
+    mixed_faces = 0;
+
+    /* Lines are classified by their first two characters and skipped with
+       the vectorized line scanner. Vertex widths only depend on the last
+       record of each kind, so only those lines are scanned for spaces.
+       Faces can have any number of corners, so every face line is scanned
+       for tokens. */
+    while (index < end)
+    {
+        char c0;
+        char c1;
+
+        c0 = p_string[index];
+        c1 = (index + 1 < end ? p_string[index + 1] : 0);
+
+        if (c0 == 'v')
+        {
+            if (c1 == ' ')
+            {
+                p_counts->position_count += 1;
+                last_v = index;
+            }
+            else if (c1 == 'n')
+            {
+                p_counts->normal_count += 1;
+                last_vn = index;
+            }
+            else if (c1 == 't')
+            {
+                p_counts->texcoord_count += 1;
+                last_vt = index;
+            }
+        }
+        else if (c0 == 'f' && c1 == ' ')
+        {
+            unsigned int corner_count;
+
+            corner_count = objpar_internal_f(p_string, &index, end, OBJPAR_NULL(unsigned int*), OBJPAR_NULL(unsigned int*), OBJPAR_NULL(unsigned int), 0, OBJPAR_NULL(struct objpar_data));
+            if (p_counts->face_count == 0)
+                face_width = corner_count;
+            else if (corner_count != face_width)
+                mixed_faces = 1;
+            p_counts->face_count += 1;
+            p_counts->corner_count += corner_count;
+            continue;
+        }
+        else if (c0 == 'o' || c0 == 'g' || c0 == 's' || c0 == 'u' || c0 == 'm')
+        {
+            unsigned int kind;
+
+            /* Every directive gets a record, the ranges are only known
+               once the whole file has been filled. */
+            kind = objpar_internal_g(p_string, &index, end, OBJPAR_NULL(struct objpar_group*), OBJPAR_NULL(char*), &p_counts->names_size, 0);
+            if (kind != 0)
+            {
+                p_counts->group_count += 1;
+                if (kind == OBJPAR_INTERNAL_MATERIAL)
+                    p_counts->material_count += 1;
+                else if (kind == OBJPAR_INTERNAL_LIBRARY)
+                    p_counts->library_count += 1;
+                continue;
+            }
+        }
+        index = objpar_internal_line_end(p_string, index, end) + 1;
+    }
+
+    if (p_counts->position_count > 0)
+        p_counts->position_width = objpar_internal_v(p_string, &last_v, end, OBJPAR_NULL(float*), 0);
+    if (p_counts->normal_count > 0)
+        p_counts->normal_width = objpar_internal_vn(p_string, &last_vn, end, OBJPAR_NULL(float*), 0);
+    if (p_counts->texcoord_count > 0)
+        p_counts->texcoord_width = objpar_internal_vt(p_string, &last_vt, end, OBJPAR_NULL(float*), 0);
+    p_counts->face_width = (mixed_faces ? 0 : face_width);
+}
+
+objpar_size_t objpar_internal_layout(const struct objpar_data* p_counts, void* p_buffer, struct objpar_data* p_data)
+{
+    objpar_internal_u64 vertex_buffer_size;
+    objpar_internal_u64 normal_buffer_size;
+    objpar_internal_u64 texcoord_buffer_size;
+    objpar_internal_u64 face_buffer_size;
+    objpar_internal_u64 offset_buffer_size;
+    objpar_internal_u64 group_buffer_size;
+    objpar_internal_u64 material_buffer_size;
+    objpar_internal_u64 library_buffer_size;
+    objpar_internal_u64 table_buffer_size;
+    objpar_internal_u64 total_buffer_size;
+    unsigned int face_comp_count;
+    void* p_curr_buffer;
+
+    if (p_counts->material_count >= 0x40000000u)
+    {
+        /* The material name table would need more than 2^31 slots */
+        return 0;
+    }
+
+    /* Sizes are computed with 64 bit math and the total has to fit in
+       objpar_size_t, so the size query never wraps around. */
+    face_comp_count = 3;
+    vertex_buffer_size = (objpar_internal_u64)(sizeof(float) * p_counts->position_width) * p_counts->position_count;
+    normal_buffer_size = (objpar_internal_u64)(sizeof(float) * p_counts->normal_width) * p_counts->normal_count;
+    texcoord_buffer_size = (objpar_internal_u64)(sizeof(float) * p_counts->texcoord_width) * p_counts->texcoord_count;
+    face_buffer_size = (objpar_internal_u64)(sizeof(unsigned int) * face_comp_count) * p_counts->corner_count;
+    offset_buffer_size = (p_counts->face_count > 0 ? sizeof(unsigned int) * ((objpar_internal_u64)p_counts->face_count + 1) : 0);
+    group_buffer_size = 0;
+    if (p_counts->group_count > 0 || p_counts->face_count > 0)
+    {
+        /* One record per directive plus the range after the last one */
+        group_buffer_size = sizeof(struct objpar_group) * ((objpar_internal_u64)p_counts->group_count + 1);
+    }
+    material_buffer_size = sizeof(unsigned int) * (objpar_internal_u64)p_counts->material_count;
+    library_buffer_size = sizeof(unsigned int) * (objpar_internal_u64)p_counts->library_count;
+    table_buffer_size = sizeof(unsigned int) * (objpar_internal_u64)objpar_internal_name_table_size(p_counts->material_count);
+    total_buffer_size = vertex_buffer_size + normal_buffer_size + texcoord_buffer_size + face_buffer_size + offset_buffer_size +
+        group_buffer_size + material_buffer_size + library_buffer_size + table_buffer_size + p_counts->names_size;
+
+    if (total_buffer_size > (objpar_size_t)-1)
+    {
+        return 0;
+    }
+
+    if (p_buffer != OBJPAR_NULL(void) && p_data != OBJPAR_NULL(struct objpar_data))
+    {
+        *p_data = *p_counts;
+        p_data->p_positions = OBJPAR_NULL(float);
+        p_data->p_normals = OBJPAR_NULL(float);
+        p_data->p_texcoords = OBJPAR_NULL(float);
+        p_data->p_faces = OBJPAR_NULL(unsigned int);
+        p_data->p_face_offsets = OBJPAR_NULL(unsigned int);
+        p_data->p_groups = OBJPAR_NULL(struct objpar_group);
+        p_data->p_materials = OBJPAR_NULL(unsigned int);
+        p_data->p_libraries = OBJPAR_NULL(unsigned int);
+        p_data->p_names = OBJPAR_NULL(char);
+        p_curr_buffer = p_buffer;
+
+        if (p_counts->position_count > 0)
+        {
+            p_data->p_positions = (float*)p_curr_buffer;
+            p_curr_buffer = (void*)((char*)p_curr_buffer + (objpar_size_t)vertex_buffer_size);
+        }
+        if (p_counts->normal_count > 0)
+        {
+            p_data->p_normals = (float*)p_curr_buffer;
+            p_curr_buffer = (void*)((char*)p_curr_buffer + (objpar_size_t)normal_buffer_size);
+        }
+        if (p_counts->texcoord_count > 0)
+        {
+            p_data->p_texcoords = (float*)p_curr_buffer;
+            p_curr_buffer = (void*)((char*)p_curr_buffer + (objpar_size_t)texcoord_buffer_size);
+        }
+        if (p_counts->face_count > 0)
+        {
+            /* The offset of each face is written by the fill pass, only
+               the end of the last face is known here. */
+            p_data->p_faces = (unsigned int*)p_curr_buffer;
+            p_curr_buffer = (void*)((char*)p_curr_buffer + (objpar_size_t)face_buffer_size);
+            p_data->p_face_offsets = (unsigned int*)p_curr_buffer;
+            p_data->p_face_offsets[p_counts->face_count] = p_counts->corner_count;
+            p_curr_buffer = (void*)((char*)p_curr_buffer + (objpar_size_t)offset_buffer_size);
+        }
+        if (group_buffer_size > 0)
+        {
+            p_data->p_groups = (struct objpar_group*)p_curr_buffer;
+            p_curr_buffer = (void*)((char*)p_curr_buffer + (objpar_size_t)group_buffer_size);
+        }
+        if (p_counts->material_count > 0)
+        {
+            p_data->p_materials = (unsigned int*)p_curr_buffer;
+            p_curr_buffer = (void*)((char*)p_curr_buffer + (objpar_size_t)material_buffer_size);
+        }
+        if (p_counts->library_count > 0)
+        {
+            p_data->p_libraries = (unsigned int*)p_curr_buffer;
+            p_curr_buffer = (void*)((char*)p_curr_buffer + (objpar_size_t)library_buffer_size);
+        }
+        /* The material name table used by objpar_internal_groups sits
+           between the libraries and the names */
+        p_curr_buffer = (void*)((char*)p_curr_buffer + (objpar_size_t)table_buffer_size);
+        if (p_counts->names_size > 0)
+        {
+            p_data->p_names = (char*)p_curr_buffer;
+        }
+    }
+
+    return (objpar_size_t)total_buffer_size;
+}
+
+unsigned int objpar_internal_merge(struct objpar_data* p_counts, const struct objpar_data* p_range_counts)
+{
+    /* Vertex widths come from the last range that has records of each
+       kind, which is the record a single count pass would have seen last.
+       Face width stays set only while every range agrees on it. Returns 0
+       when a count would reach OBJPAR_NONE. */
+    if (p_range_counts->face_count > 0)
+    {
+        if (p_counts->face_count == 0)
+            p_counts->face_width = p_range_counts->face_width;
+        else if (p_counts->face_width != p_range_counts->face_width)
+            p_counts->face_width = 0;
+    }
+    if (p_range_counts->position_count > 0)
+        p_counts->position_width = p_range_counts->position_width;
+    if (p_range_counts->normal_count > 0)
+        p_counts->normal_width = p_range_counts->normal_width;
+    if (p_range_counts->texcoord_count > 0)
+        p_counts->texcoord_width = p_range_counts->texcoord_width;
+
+    return objpar_internal_add(&p_counts->position_count, p_range_counts->position_count) &&
+        objpar_internal_add(&p_counts->normal_count, p_range_counts->normal_count) &&
+        objpar_internal_add(&p_counts->texcoord_count, p_range_counts->texcoord_count) &&
+        objpar_internal_add(&p_counts->face_count, p_range_counts->face_count) &&
+        objpar_internal_add(&p_counts->corner_count, p_range_counts->corner_count) &&
+        objpar_internal_add(&p_counts->group_count, p_range_counts->group_count) &&
+        objpar_internal_add(&p_counts->material_count, p_range_counts->material_count) &&
+        objpar_internal_add(&p_counts->library_count, p_range_counts->library_count) &&
+        objpar_internal_add(&p_counts->names_size, p_range_counts->names_size);
+}
+
+unsigned int objpar_internal_add(unsigned int* p_count, unsigned int count)
+{
+    /* OBJPAR_NONE is reserved for missing indices, so it is never a count */
+    if (count >= OBJPAR_NONE - *p_count)
+        return 0;
+    *p_count += count;
+    return 1;
+}
+
+void objpar_internal_fill(const char* p_string, objpar_size_t begin, objpar_size_t end, struct objpar_data* p_cursor)
+{
+    objpar_size_t index;
+
+    /* The data pointers of p_cursor are advanced past the written records.
+       Its counts and names_size hold the index of the next record and name
+       byte, the vertex counts also resolve negative face indices. */
+    index = begin;
+    while (index < end)
+    {
+        if (objpar_internal_v(p_string, &index, end, &p_cursor->p_positions, p_cursor->position_width))
+            p_cursor->position_count += 1;
+        else if (objpar_internal_vn(p_string, &index, end, &p_cursor->p_normals, p_cursor->normal_width))
+            p_cursor->normal_count += 1;
+        else if (objpar_internal_vt(p_string, &index, end, &p_cursor->p_texcoords, p_cursor->texcoord_width))
+            p_cursor->texcoord_count += 1;
+        else if (objpar_internal_f(p_string, &index, end, &p_cursor->p_faces, &p_cursor->p_face_offsets, &p_cursor->corner_count, OBJPAR_ALL_CORNERS, p_cursor))
+            p_cursor->face_count += 1;
+        else if (objpar_internal_g(p_string, &index, end, &p_cursor->p_groups, &p_cursor->p_names, &p_cursor->names_size, p_cursor->face_count));
+        else if (objpar_internal_comment(p_string, &index, end));
+        else objpar_internal_newline(p_string, &index, end, OBJPAR_NULL(unsigned int));
+    }
+}
+
+unsigned int objpar_internal_v(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size, float** pp_vbuff, unsigned int vertex_width)
+{
+    objpar_size_t index;
+    unsigned int space_count;
+    char c0;
+    char c1;
+
+    index = *p_index;
+    c0 = p_string[index];
+    c1 = (index + 1 < string_size ? p_string[index + 1] : 0);
+    space_count = 0;
+
+    if (c0 == 'v' && c1 == ' ')
+    {
+        if (pp_vbuff == OBJPAR_NULL(float*))
+        {
+            objpar_internal_newline(p_string, p_index, string_size, &space_count);
+            return space_count;
+        }
+
+        *p_index = objpar_internal_floats(p_string, index + 2, string_size, *pp_vbuff, vertex_width, &space_count);
+        *pp_vbuff += vertex_width;
+        return space_count + 1;
+    }
+    return 0;
+}
+
+unsigned int objpar_internal_vn(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size, float** pp_nbuff, unsigned int normal_width)
+{
+    objpar_size_t index;
+    unsigned int space_count;
+    char c0;
+    char c1;
+
+    index = *p_index;
+    c0 = p_string[index];
+    c1 = (index + 1 < string_size ? p_string[index + 1] : 0);
+    space_count = 0;
+
+    if (c0 == 'v' && c1 == 'n')
+    {
+        if (pp_nbuff == OBJPAR_NULL(float*))
+        {
+            objpar_internal_newline(p_string, p_index, string_size, &space_count);
+            return (space_count > 0 ? space_count : 1);
+        }
+
+        *p_index = objpar_internal_floats(p_string, index + 2, string_size, *pp_nbuff, normal_width, &space_count);
+        *pp_nbuff += normal_width;
+        return (space_count > 0 ? space_count : 1);
+    }
+    return 0;
+}
+
+unsigned int objpar_internal_vt(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size, float** pp_tbuff, unsigned int texcoord_width)
+{
+    objpar_size_t index;
+    unsigned int space_count;
+    char c0;
+    char c1;
+
+    index = *p_index;
+    c0 = p_string[index];
+    c1 = (index + 1 < string_size ? p_string[index + 1] : 0);
+    space_count = 0;
+
+    if (c0 == 'v' && c1 == 't')
+    {
+        if (pp_tbuff == OBJPAR_NULL(float*))
+        {
+            objpar_internal_newline(p_string, p_index, string_size, &space_count);
+            return (space_count > 0 ? space_count : 1);
+        }
+
+        *p_index = objpar_internal_floats(p_string, index + 2, string_size, *pp_tbuff, texcoord_width, &space_count);
+        *pp_tbuff += texcoord_width;
+        return (space_count > 0 ? space_count : 1);
+    }
+    return 0;
+}
+
+unsigned int objpar_internal_f(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size, unsigned int** pp_fbuff, unsigned int** pp_obuff, unsigned int* p_corner, unsigned int corner_limit, const struct objpar_data* p_counts)
+{
+    objpar_size_t index;
+    unsigned int corner;
+    unsigned int slot;
+    unsigned int in_corner;
+    unsigned int face_comp_count;
+    char c0;
+    char c1;
+    unsigned int* p_face;
+
+    index = *p_index;
+    c0 = p_string[index];
+    c1 = (index + 1 < string_size ? p_string[index + 1] : 0);
+    face_comp_count = 3;
+    if (c0 == 'f' && c1 == ' ')
+    {
+        if (pp_fbuff == OBJPAR_NULL(unsigned int*))
+        {
+            unsigned int corner_count = 0;
+            *p_index = objpar_internal_line_tokens(p_string, index + 1, string_size, &corner_count) + 1;
+            return corner_count;
+        }
+
+        p_face = *pp_fbuff;
+        corner = 0;
+        slot = 0;
+        in_corner = 0;
+
+        index += 2;
+
+        /* Each corner is a token written as v/vt/vn where vt and vn are
+           optional. Missing indices are left as 0 and negative indices
+           are resolved against the elements read so far. Tokens are split
+           the same way objpar_internal_line_tokens counts them, so exactly
+           the counted number of corners is written. */
+        while (index < string_size && (c0 = p_string[index]) != '\n' && c0 != '\r')
+        {
+            if (c0 == ' ' || c0 == '\t')
+            {
+                in_corner = 0;
+                index += 1;
+                continue;
+            }
+            if (!in_corner)
+            {
+                if (corner < corner_limit)
+                {
+                    p_face[corner * face_comp_count + OBJPAR_V_IDX] = 0;
+                    p_face[corner * face_comp_count + OBJPAR_VT_IDX] = 0;
+                    p_face[corner * face_comp_count + OBJPAR_VN_IDX] = 0;
+                }
+                corner += 1;
+                slot = 0;
+                in_corner = 1;
+            }
+            if (c0 >= '0' && c0 <= '9')
+            {
+                unsigned int value = objpar_internal_read_uint(p_string, &index, string_size);
+                if (corner <= corner_limit)
+                    p_face[(corner - 1) * face_comp_count + slot] = value;
+                continue;
+            }
+            if (c0 == '-' && index + 1 < string_size && p_string[index + 1] >= '0' && p_string[index + 1] <= '9')
+            {
+                unsigned int offset;
+                index += 1;
+                offset = objpar_internal_read_uint(p_string, &index, string_size);
+                if (corner <= corner_limit)
+                    p_face[(corner - 1) * face_comp_count + slot] = objpar_internal_relative(p_counts, slot, offset);
+                continue;
+            }
+            if (c0 == '/' && slot < face_comp_count - 1)
+            {
+                slot += 1;
+            }
+            index += 1;
+        }
+        /* A face with more corners than there is room for is not stored,
+           the caller counts its corners and parses it again */
+        if (corner > corner_limit)
+            return 0;
+        *p_index = index;
+        *pp_fbuff = p_face + corner * face_comp_count;
+        **pp_obuff = *p_corner;
+        *pp_obuff += 1;
+        *p_corner += corner;
+        return 1;
+    }
+    return 0;
+}
+
+unsigned int objpar_internal_relative(const struct objpar_data* p_counts, unsigned int slot, unsigned int offset)
+{
+    unsigned int count;
+
+    /* -1 is the last element read before the face. Indices that point
+       before the first element become OBJPAR_NONE so objpar_validate
+       reports them instead of them aliasing a valid element. */
+    if (slot == OBJPAR_V_IDX)
+        count = p_counts->position_count;
+    else if (slot == OBJPAR_VT_IDX)
+        count = p_counts->texcoord_count;
+    else
+        count = p_counts->normal_count;
+
+    if (offset == 0 || offset > count)
+        return OBJPAR_NONE;
+    return count - offset + 1;
+}
+
+unsigned int objpar_internal_g(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size, struct objpar_group** pp_gbuff, char** pp_nbuff, unsigned int* p_names_size, unsigned int face)
+{
+    struct objpar_group* p_group;
+    objpar_size_t index;
+    objpar_size_t line_end;
+    objpar_size_t name_end;
+    unsigned int keyword_size;
+    unsigned int name_size;
+    unsigned int kind;
+    char c0;
+
+    index = *p_index;
+    c0 = p_string[index];
+    kind = 0;
+    keyword_size = 1;
+
+    if (c0 == 'o')
+        kind = OBJPAR_INTERNAL_OBJECT;
+    else if (c0 == 'g')
+        kind = OBJPAR_INTERNAL_GROUP;
+    else if (c0 == 's')
+        kind = OBJPAR_INTERNAL_SMOOTHING;
+    else if (c0 == 'u' && index + 6 <= string_size && memcmp(p_string + index, "usemtl", 6) == 0)
+    {
+        kind = OBJPAR_INTERNAL_MATERIAL;
+        keyword_size = 6;
+    }
+    else if (c0 == 'm' && index + 6 <= string_size && memcmp(p_string + index, "mtllib", 6) == 0)
+    {
+        kind = OBJPAR_INTERNAL_LIBRARY;
+        keyword_size = 6;
+    }
+
+    index += keyword_size;
+    if (kind == 0 || (index < string_size && p_string[index] != ' ' && p_string[index] != '\t' &&
+        p_string[index] != '\r' && p_string[index] != '\n'))
+    {
+        return 0;
+    }
+
+    /* The name is the rest of the line without the surrounding blanks, so
+       names with spaces and mtllib lines with several files are kept as
+       written. */
+    while (index < string_size && (p_string[index] == ' ' || p_string[index] == '\t'))
+        index += 1;
+    line_end = objpar_internal_line_end(p_string, index, string_size);
+    name_end = line_end;
+    while (name_end > index && (p_string[name_end - 1] == ' ' || p_string[name_end - 1] == '\t' || p_string[name_end - 1] == '\r'))
+        name_end -= 1;
+    name_size = (kind != OBJPAR_INTERNAL_SMOOTHING ? (unsigned int)(name_end - index) + 1 : 0);
+    *p_index = line_end + 1;
+
+    if (pp_gbuff == OBJPAR_NULL(struct objpar_group*))
+    {
+        *p_names_size += name_size;
+        return kind;
+    }
+
+    /* Until objpar_internal_groups runs the record only holds the face it
+       precedes, its kind and its value. */
+    p_group = *pp_gbuff;
+    p_group->face_begin = face;
+    p_group->face_count = kind;
+    p_group->object = 0;
+    p_group->group = 0;
+    p_group->material = 0;
+    p_group->smoothing = 0;
+
+    if (kind == OBJPAR_INTERNAL_SMOOTHING)
+    {
+        if (index < name_end && p_string[index] >= '0' && p_string[index] <= '9')
+            p_group->object = objpar_internal_read_uint(p_string, &index, name_end);
+    }
+    else
+    {
+        memcpy(*pp_nbuff, p_string + index, name_size - 1);
+        (*pp_nbuff)[name_size - 1] = 0;
+        p_group->object = *p_names_size;
+        *pp_nbuff += name_size;
+        *p_names_size += name_size;
+    }
+    *pp_gbuff += 1;
+    return kind;
+}
+
+void objpar_internal_groups(struct objpar_data* p_data)
+{
+    struct objpar_group* p_groups;
+    struct objpar_group state;
+    unsigned int* p_table;
+    unsigned int table_size;
+    unsigned int record_count;
+    unsigned int record;
+
+    /* Materials are numbered by first use through a table of their names,
+       it follows the material and library records in the buffer. */
+    table_size = objpar_internal_name_table_size(p_data->material_count);
+    p_table = OBJPAR_NULL(unsigned int);
+    if (table_size > 0)
+    {
+        p_table = p_data->p_materials + p_data->material_count + p_data->library_count;
+        memset(p_table, 0xFF, sizeof(unsigned int) * table_size);
+    }
+
+    p_groups = p_data->p_groups;
+    record_count = p_data->group_count;
+    p_data->group_count = 0;
+    p_data->material_count = 0;
+    p_data->library_count = 0;
+    if (p_groups == OBJPAR_NULL(struct objpar_group))
+        return;
+
+    /* The directive records are turned into face ranges in place. A range
+       is written when the next record is read, so it never overwrites a
+       record that hasn't been read yet. Ranges without faces are dropped
+       and neighbours with the same state are joined. */
+    state.face_begin = 0;
+    state.face_count = 0;
+    state.object = OBJPAR_NONE;
+    state.group = OBJPAR_NONE;
+    state.material = OBJPAR_NONE;
+    state.smoothing = 0;
+
+    for (record = 0; record <= record_count; ++record)
+    {
+        unsigned int face_end;
+        unsigned int kind;
+        unsigned int value;
+
+        face_end = p_data->face_count;
+        kind = 0;
+        value = 0;
+        if (record < record_count)
+        {
+            face_end = p_groups[record].face_begin;
+            kind = p_groups[record].face_count;
+            value = p_groups[record].object;
+        }
+
+        if (face_end > state.face_begin)
+        {
+            struct objpar_group* p_end = p_groups + p_data->group_count;
+
+            if (p_data->group_count > 0 &&
+                p_end[-1].object == state.object && p_end[-1].group == state.group &&
+                p_end[-1].material == state.material && p_end[-1].smoothing == state.smoothing)
+            {
+                p_end[-1].face_count += face_end - state.face_begin;
+            }
+            else
+            {
+                state.face_count = face_end - state.face_begin;
+                p_groups[p_data->group_count++] = state;
+            }
+            state.face_begin = face_end;
+        }
+
+        if (kind == OBJPAR_INTERNAL_OBJECT)
+            state.object = value;
+        else if (kind == OBJPAR_INTERNAL_GROUP)
+            state.group = value;
+        else if (kind == OBJPAR_INTERNAL_SMOOTHING)
+            state.smoothing = value;
+        else if (kind == OBJPAR_INTERNAL_LIBRARY)
+            p_data->p_libraries[p_data->library_count++] = value;
+        else if (kind == OBJPAR_INTERNAL_MATERIAL)
+        {
+            /* Every usemtl of the same name maps to the same index */
+            unsigned int* p_slot = objpar_internal_name_slot(p_table, table_size, p_data->p_names, p_data->p_materials, 1, p_data->p_names + value);
+            if (*p_slot == OBJPAR_NONE)
+            {
+                *p_slot = p_data->material_count;
+                p_data->p_materials[p_data->material_count++] = value;
+            }
+            state.material = *p_slot;
+        }
+    }
+}
+
+unsigned int objpar_internal_name_table_size(unsigned int name_count)
+{
+    unsigned int table_size;
+
+    if (name_count == 0)
+        return 0;
+
+    /* At most half of the slots are used so probe sequences stay short */
+    table_size = 16;
+    while (table_size < name_count * 2)
+        table_size *= 2;
+    return table_size;
+}
+
+unsigned int* objpar_internal_name_slot(unsigned int* p_table, unsigned int table_size, const char* p_names, const unsigned int* p_name_offsets, unsigned int name_stride, const char* p_name)
+{
+    unsigned int table_mask;
+    unsigned int slot;
+
+    /* Slots hold the index of an entry or OBJPAR_NONE. The name of entry i
+       is at p_names + p_name_offsets[i * name_stride]. */
+    table_mask = table_size - 1;
+    slot = (unsigned int)objpar_hash(p_name, strlen(p_name)) & table_mask;
+    while (p_table[slot] != OBJPAR_NONE &&
+           strcmp(p_names + p_name_offsets[p_table[slot] * name_stride], p_name) != 0)
+    {
+        slot = (slot + 1) & table_mask;
+    }
+    return &p_table[slot];
+}
+
+unsigned int objpar_internal_comment(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size)
+{
+    objpar_size_t index;
+    char c;
+
+    index = *p_index;
+    c = p_string[index];
+
+    if (c == '#')
+    {
+        *p_index = objpar_internal_line_end(p_string, index, string_size) + 1;
+        return 1;
+    }
+    return 0;
+}
+
+unsigned int objpar_internal_newline(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size, unsigned int* p_space_count)
+{
+    if (p_space_count != OBJPAR_NULL(unsigned int))
+        *p_index = objpar_internal_line_spaces(p_string, *p_index, string_size, p_space_count) + 1;
+    else
+        *p_index = objpar_internal_line_end(p_string, *p_index, string_size) + 1;
+
+    return 1;
+}
+
+objpar_size_t objpar_internal_line_end(const char* p_string, objpar_size_t index, objpar_size_t end)
+{
+#if defined(OBJPAR_AVX2)
+    {
+        const __m256i newline = _mm256_set1_epi8('\n');
+        const __m256i carriage = _mm256_set1_epi8('\r');
+        while (index + 32 <= end)
+        {
+            __m256i chunk = _mm256_loadu_si256((const __m256i*)(p_string + index));
+            unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, newline), _mm256_cmpeq_epi8(chunk, carriage)));
+            if (mask != 0)
+                return index + objpar_internal_ctz(mask);
+            index += 32;
+        }
+    }
+#endif
+#if defined(OBJPAR_SSE2)
+    {
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i carriage = _mm_set1_epi8('\r');
+        while (index + 16 <= end)
+        {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)(p_string + index));
+            unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, carriage)));
+            if (mask != 0)
+                return index + objpar_internal_ctz(mask);
+            index += 16;
+        }
+    }
+#endif
+    while (index < end && p_string[index] != '\n' && p_string[index] != '\r')
+        ++index;
+    return index;
+}
+
+objpar_size_t objpar_internal_line_spaces(const char* p_string, objpar_size_t index, objpar_size_t end, unsigned int* p_space_count)
+{
+    unsigned int space_count;
+    char c;
+
+    space_count = 0;
+#if defined(OBJPAR_AVX2)
+    {
+        const __m256i newline = _mm256_set1_epi8('\n');
+        const __m256i carriage = _mm256_set1_epi8('\r');
+        const __m256i space = _mm256_set1_epi8(' ');
+        const __m256i tab = _mm256_set1_epi8('\t');
+        while (index + 32 <= end)
+        {
+            __m256i chunk = _mm256_loadu_si256((const __m256i*)(p_string + index));
+            unsigned int line_mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, newline), _mm256_cmpeq_epi8(chunk, carriage)));
+            unsigned int space_mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, tab)));
+            if (line_mask != 0)
+            {
+                unsigned int length = objpar_internal_ctz(line_mask);
+                *p_space_count = space_count + objpar_internal_popcount(space_mask & ((1u << length) - 1));
+                return index + length;
+            }
+            space_count += objpar_internal_popcount(space_mask);
+            index += 32;
+        }
+    }
+#endif
+#if defined(OBJPAR_SSE2)
+    {
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i carriage = _mm_set1_epi8('\r');
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i tab = _mm_set1_epi8('\t');
+        while (index + 16 <= end)
+        {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)(p_string + index));
+            unsigned int line_mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, carriage)));
+            unsigned int space_mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)));
+            if (line_mask != 0)
+            {
+                unsigned int length = objpar_internal_ctz(line_mask);
+                *p_space_count = space_count + objpar_internal_popcount(space_mask & ((1u << length) - 1));
+                return index + length;
+            }
+            space_count += objpar_internal_popcount(space_mask);
+            index += 16;
+        }
+    }
+#endif
+    while (index < end && (c = p_string[index]) != '\n' && c != '\r')
+    {
+        if (c == ' ' || c == '\t')
+            space_count += 1;
+        ++index;
+    }
+    *p_space_count = space_count;
+    return index;
+}
+
+objpar_size_t objpar_internal_line_tokens(const char* p_string, objpar_size_t index, objpar_size_t end, unsigned int* p_token_count)
+{
+    unsigned int token_count;
+    unsigned int after_space;
+    char c;
+
+    /* A token starts at every character that isn't a space or a tab and
+       follows one. Vector paths shift the space mask by one byte and
+       carry the last bit of each block into the next one. */
+    token_count = 0;
+    after_space = 0;
+#if defined(OBJPAR_AVX2)
+    {
+        const __m256i newline = _mm256_set1_epi8('\n');
+        const __m256i carriage = _mm256_set1_epi8('\r');
+        const __m256i space = _mm256_set1_epi8(' ');
+        const __m256i tab = _mm256_set1_epi8('\t');
+        while (index + 32 <= end)
+        {
+            __m256i chunk = _mm256_loadu_si256((const __m256i*)(p_string + index));
+            unsigned int line_mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, newline), _mm256_cmpeq_epi8(chunk, carriage)));
+            unsigned int space_mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, tab)));
+            unsigned int start_mask = ~space_mask & ((space_mask << 1) | after_space);
+            if (line_mask != 0)
+            {
+                unsigned int length = objpar_internal_ctz(line_mask);
+                *p_token_count = token_count + objpar_internal_popcount(start_mask & ((1u << length) - 1));
+                return index + length;
+            }
+            token_count += objpar_internal_popcount(start_mask);
+            after_space = space_mask >> 31;
+            index += 32;
+        }
+    }
+#endif
+#if defined(OBJPAR_SSE2)
+    {
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i carriage = _mm_set1_epi8('\r');
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i tab = _mm_set1_epi8('\t');
+        while (index + 16 <= end)
+        {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)(p_string + index));
+            unsigned int line_mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, carriage)));
+            unsigned int space_mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)));
+            unsigned int start_mask = ~space_mask & ((space_mask << 1) | after_space) & 0xFFFF;
+            if (line_mask != 0)
+            {
+                unsigned int length = objpar_internal_ctz(line_mask);
+                *p_token_count = token_count + objpar_internal_popcount(start_mask & ((1u << length) - 1));
+                return index + length;
+            }
+            token_count += objpar_internal_popcount(start_mask);
+            after_space = (space_mask >> 15) & 1;
+            index += 16;
+        }
+    }
+#endif
+    while (index < end && (c = p_string[index]) != '\n' && c != '\r')
+    {
+        if (c == ' ' || c == '\t')
+        {
+            after_space = 1;
+        }
+        else
+        {
+            token_count += after_space;
+            after_space = 0;
+        }
+        ++index;
+    }
+    *p_token_count = token_count;
+    return index;
+}
+
+unsigned int objpar_internal_ctz(unsigned int mask)
+{
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return (unsigned int)bit;
+#elif defined(__GNUC__) || defined(__clang__)
+    return (unsigned int)__builtin_ctz(mask);
+#else
+    unsigned int bit = 0;
+    while ((mask & 1) == 0)
+    {
+        mask >>= 1;
+        bit += 1;
+    }
+    return bit;
+#endif
+}
+
+unsigned int objpar_internal_popcount(unsigned int mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned int)__builtin_popcount(mask);
+#else
+    mask = mask - ((mask >> 1) & 0x55555555u);
+    mask = (mask & 0x33333333u) + ((mask >> 2) & 0x33333333u);
+    return (((mask + (mask >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+#endif
+}
+
+objpar_size_t objpar_internal_floats(const char* p_string, objpar_size_t index, objpar_size_t string_size, float* p_values, unsigned int width, unsigned int* p_space_count)
+{
+    unsigned int comp_count;
+    unsigned int space_count;
+    unsigned int i;
+    char c0;
+
+    comp_count = 0;
+    space_count = 0;
+
+    for (i = 0; i < width; ++i)
+    {
+        p_values[i] = 0.0f;
+    }
+
+    while (index < string_size && (c0 = p_string[index]) != '\n' && c0 != '\r')
+    {
+        if ((c0 >= '0' && c0 <= '9') || c0 == '-' || c0 == '+' || c0 == '.')
+        {
+            float comp = objpar_internal_read_float(p_string, &index, string_size);
+            if (comp_count < width)
+                p_values[comp_count] = comp;
+            comp_count += 1;
+        }
+        else
+        {
+            if (c0 == ' ' || c0 == '\t')
+                space_count += 1;
+            index += 1;
+        }
+    }
+    *p_space_count = space_count;
+    return index;
+}
+
+#if defined(objpar_atof) || defined(objpar_atoi)
+objpar_size_t objpar_internal_token(const char* p_string, objpar_size_t index, objpar_size_t string_size, char* p_str, unsigned int str_capacity)
+{
+    unsigned int str_size;
+    char c0;
+
+    str_size = 0;
+    while (index < string_size)
+    {
+        c0 = p_string[index];
+        if (!((c0 >= '0' && c0 <= '9') || c0 == '-' || c0 == '+' || c0 == '.' || c0 == 'e' || c0 == 'E'))
+            break;
+        if (str_size + 1 < str_capacity)
+            p_str[str_size++] = c0;
+        ++index;
+    }
+    p_str[str_size] = 0;
+    return index;
+}
+#endif
+
+float objpar_internal_read_float(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size)
+{
+#if defined(objpar_atof)
+    char str[64];
+    *p_index = objpar_internal_token(p_string, *p_index, string_size, str, sizeof(str));
+    return objpar_atof(str);
+#else
+    return objpar_internal_atof(p_string, p_index, string_size);
+#endif
+}
+
+unsigned int objpar_internal_read_uint(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size)
+{
+#if defined(objpar_atoi)
+    char str[64];
+    *p_index = objpar_internal_token(p_string, *p_index, string_size, str, sizeof(str));
+    return (unsigned int)objpar_atoi(str);
+#else
+    objpar_internal_u64 value;
+    unsigned int dropped;
+
+    value = 0;
+    objpar_internal_digits(p_string, p_index, string_size, &value, &dropped);
+    return (unsigned int)value;
+#endif
+}
+
+#if defined(OBJPAR_SWAR)
+unsigned int objpar_internal_digits8(const char* p_string, unsigned int* p_count)
+{
+    objpar_internal_u64 chunk;
+    objpar_internal_u64 mask;
+    unsigned int count;
+
+    memcpy(&chunk, p_string, sizeof(chunk));
+
+    /* High bit set on every byte that is not an ASCII digit. Borrows and
+       carries only reach bytes after the first non digit, which are ignored. */
+    mask = ((chunk + OBJPAR_INTERNAL_U64(0x46464646UL, 0x46464646UL)) | (chunk - OBJPAR_INTERNAL_U64(0x30303030UL, 0x30303030UL))) &
+        OBJPAR_INTERNAL_U64(0x80808080UL, 0x80808080UL);
+    if (mask == 0)
+    {
+        count = 8;
+    }
+    else
+    {
+#if defined(_MSC_VER)
+        unsigned long bit;
+        _BitScanForward64(&bit, mask);
+        count = (unsigned int)bit >> 3;
+#else
+        count = (unsigned int)__builtin_ctzll(mask) >> 3;
+#endif
+        if (count == 0)
+        {
+            *p_count = 0;
+            return 0;
+        }
+        /* Move the digits to the end of the word and pad the front with '0' */
+        chunk = (chunk << (8 * (8 - count))) | (OBJPAR_INTERNAL_U64(0x30303030UL, 0x30303030UL) >> (8 * count));
+    }
+
+    chunk -= OBJPAR_INTERNAL_U64(0x30303030UL, 0x30303030UL);
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & OBJPAR_INTERNAL_U64(0xFFUL, 0xFFUL)) * OBJPAR_INTERNAL_U64(1000000UL, 100UL)) +
+        (((chunk >> 16) & OBJPAR_INTERNAL_U64(0xFFUL, 0xFFUL)) * OBJPAR_INTERNAL_U64(10000UL, 1UL))) >> 32;
+
+    *p_count = count;
+    return (unsigned int)chunk;
+}
+#endif
+
+unsigned int objpar_internal_digits(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size, objpar_internal_u64* p_value, unsigned int* p_dropped)
+{
+    static const unsigned int pow10[9] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+    objpar_size_t index;
+    unsigned int count;
+    unsigned int dropped;
+    objpar_internal_u64 value;
+    char c;
+
+    index = *p_index;
+    count = 0;
+    dropped = 0;
+    value = *p_value;
+
+#if defined(OBJPAR_SWAR)
+    /* Consume up to 8 digits per step while the value can't overflow */
+    while (index + 8 <= string_size && value < OBJPAR_INTERNAL_U64(0x17UL, 0x4876E800UL))
+    {
+        unsigned int digit_count;
+        unsigned int digits = objpar_internal_digits8(p_string + index, &digit_count);
+        if (digit_count == 0)
+            break;
+        value = value * pow10[digit_count] + digits;
+        count += digit_count;
+        index += digit_count;
+        if (digit_count < 8)
+        {
+            *p_index = index;
+            *p_value = value;
+            *p_dropped = dropped;
+            return count;
+        }
+    }
+#else
+    (void)pow10;
+#endif
+
+    while (index < string_size && (c = p_string[index]) >= '0' && c <= '9')
+    {
+        if (value < ((objpar_internal_u64)-1) / 10)
+        {
+            value = value * 10 + (objpar_internal_u64)(c - '0');
+            count += 1;
+        }
+        else
+        {
+            dropped += 1;
+        }
+        ++index;
+    }
+
+    *p_index = index;
+    *p_value = value;
+    *p_dropped = dropped;
+    return count;
+}
+
+float objpar_internal_atof(const char* p_string, objpar_size_t* p_index, objpar_size_t string_size)
+{
+    static const double pow10[23] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    objpar_size_t index;
+    unsigned int negative;
+    unsigned int dropped;
+    int exponent;
+    objpar_internal_u64 mantissa;
+    double value;
+    char c;
+
+    index = *p_index;
+    negative = 0;
+    exponent = 0;
+    mantissa = 0;
+
+    c = p_string[index];
+    if (c == '-' || c == '+')
+    {
+        negative = (c == '-');
+        ++index;
+    }
+
+    /* Integer part. Digits that don't fit in the mantissa only scale it. */
+    objpar_internal_digits(p_string, &index, string_size, &mantissa, &dropped);
+    exponent += (int)dropped;
+
+    /* Fractional part */
+    if (index < string_size && p_string[index] == '.')
+    {
+        ++index;
+        exponent -= (int)objpar_internal_digits(p_string, &index, string_size, &mantissa, &dropped);
+    }
+
+    /* Exponent */
+    if (index + 1 < string_size && (p_string[index] == 'e' || p_string[index] == 'E'))
+    {
+        objpar_size_t exp_index;
+        unsigned int exp_negative;
+        objpar_internal_u64 exp_value;
+
+        exp_index = index + 1;
+        exp_negative = 0;
+        exp_value = 0;
+        c = p_string[exp_index];
+        if (c == '-' || c == '+')
+        {
+            exp_negative = (c == '-');
+            ++exp_index;
+        }
+        if (exp_index < string_size && p_string[exp_index] >= '0' && p_string[exp_index] <= '9')
+        {
+            objpar_internal_digits(p_string, &exp_index, string_size, &exp_value, &dropped);
+            if (exp_value > 1000 || dropped > 0)
+                exp_value = 1000;
+            exponent += (exp_negative ? -(int)exp_value : (int)exp_value);
+            index = exp_index;
+        }
+    }
+
+    *p_index = index;
+
+    value = (double)mantissa;
+    if (mantissa == 0 || exponent < -400)
+    {
+        value = 0.0;
+    }
+    else if (exponent > 400)
+    {
+        value = 1e300 * 1e300;
+    }
+    else
+    {
+        /* With a mantissa below 2^53 and |exponent| <= 22 both operands are
+           exact and the result is correctly rounded. Otherwise the error
+           stays within a few double ULPs, well below float precision. */
+        while (exponent > 22)
+        {
+            value *= pow10[22];
+            exponent -= 22;
+        }
+        while (exponent < -22)
+        {
+            value /= pow10[22];
+            exponent += 22;
+        }
+        if (exponent > 0)
+            value *= pow10[exponent];
+        else if (exponent < 0)
+            value /= pow10[-exponent];
+    }
+
+    return (float)(negative ? -value : value);
+}
+
+#if defined(OBJPAR_ENABLE_THREADS)
+unsigned int objpar_internal_split(const char* p_string, objpar_size_t string_size, unsigned int range_count, struct objpar_internal_range* p_ranges)
+{
+    objpar_size_t begin;
+    unsigned int count;
+    unsigned int i;
+
+    if (range_count > string_size / OBJPAR_MIN_PARALLEL_SIZE)
+        range_count = (unsigned int)(string_size / OBJPAR_MIN_PARALLEL_SIZE);
+    if (range_count == 0)
+        range_count = 1;
+
+    begin = 0;
+    count = 0;
+    for (i = 0; i < range_count; ++i)
+    {
+        objpar_size_t end;
+
+        end = (i + 1 == range_count ? string_size : (objpar_size_t)(((objpar_internal_u64)string_size * (i + 1)) / range_count));
+        
+        /* Chunks always end right after a line break */
+        while (end < string_size && end > 0 && p_string[end - 1] != '\n')
+            ++end;
+
+        if (end <= begin)
+            continue;
+
+        p_ranges[count].p_string = p_string;
+        p_ranges[count].begin = begin;
+        p_ranges[count].end = end;
+        count += 1;
+        begin = end;
+    }
+    return count;
+}
+
+unsigned int objpar_internal_thread_count(unsigned int thread_count)
+{
+    if (thread_count == 0)
+    {
+#if defined(_WIN32)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        thread_count = (unsigned int)info.dwNumberOfProcessors;
+#else
+        long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (cpu_count > 0 ? (unsigned int)cpu_count : 1);
+#endif
+    }
+    if (thread_count > OBJPAR_MAX_THREADS)
+        thread_count = OBJPAR_MAX_THREADS;
+    return thread_count;
+}
+
+#if defined(_WIN32)
+DWORD WINAPI objpar_internal_thread_entry(LPVOID p_arg)
+{
+    struct objpar_internal_task* p_task = (struct objpar_internal_task*)p_arg;
+    p_task->p_func(p_task->p_arg);
+    return 0;
+}
+#else
+void* objpar_internal_thread_entry(void* p_arg)
+{
+    struct objpar_internal_task* p_task = (struct objpar_internal_task*)p_arg;
+    p_task->p_func(p_task->p_arg);
+    return OBJPAR_NULL(void);
+}
+#endif
+
+void objpar_internal_run_tasks(struct objpar_internal_task* p_tasks, unsigned int task_count)
+{
+    unsigned int i;
+
+    /* The first task runs on the calling thread. If a thread can't be
+       created its task also runs here. */
+    for (i = 1; i < task_count; ++i)
+    {
+        objpar_internal_start_task(&p_tasks[i]);
+    }
+
+    if (task_count > 0)
+    {
+        p_tasks[0].p_func(p_tasks[0].p_arg);
+    }
+
+    for (i = 1; i < task_count; ++i)
+    {
+        objpar_internal_join_task(&p_tasks[i]);
+    }
+}
+
+void objpar_internal_start_task(struct objpar_internal_task* p_task)
+{
+#if defined(_WIN32)
+    p_task->thread = CreateThread(NULL, 0, objpar_internal_thread_entry, p_task, 0, NULL);
+    p_task->started = (p_task->thread != NULL);
+#else
+    p_task->started = (pthread_create(&p_task->thread, NULL, objpar_internal_thread_entry, p_task) == 0);
+#endif
+}
+
+void objpar_internal_join_task(struct objpar_internal_task* p_task)
+{
+    if (!p_task->started)
+    {
+        p_task->p_func(p_task->p_arg);
+        return;
+    }
+#if defined(_WIN32)
+    WaitForSingleObject(p_task->thread, INFINITE);
+    CloseHandle(p_task->thread);
+#else
+    pthread_join(p_task->thread, NULL);
+#endif
+}
+
+unsigned int objpar_internal_read_parallel(const struct objpar_reader* p_reader, struct objpar_stream* p_stream, char* p_blocks)
+{
+    struct objpar_internal_pipe pipe;
+    struct objpar_internal_task task;
+    unsigned int success;
+
+    pipe.p_reader = p_reader;
+    pipe.p_blocks = p_blocks;
+    pipe.produced = 0;
+    pipe.consumed = 0;
+    pipe.status = 0;
+    pipe.stop = 0;
+#if defined(_WIN32)
+    InitializeSRWLock(&pipe.mutex);
+    InitializeConditionVariable(&pipe.cond);
+#else
+    if (pthread_mutex_init(&pipe.mutex, NULL) != 0)
+        return objpar_internal_read_serial(p_reader, p_stream, p_blocks);
+    if (pthread_cond_init(&pipe.cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&pipe.mutex);
+        return objpar_internal_read_serial(p_reader, p_stream, p_blocks);
+    }
+#endif
+
+    task.p_func = objpar_internal_read_task;
+    task.p_arg = &pipe;
+    objpar_internal_start_task(&task);
+
+    success = 1;
+    if (!task.started)
+    {
+        /* The reader can't wait for a parser that runs after it */
+        success = objpar_internal_read_serial(p_reader, p_stream, p_blocks);
+    }
+
+    while (task.started)
+    {
+        unsigned int block;
+
+        objpar_internal_lock(&pipe.mutex);
+        while (pipe.produced == pipe.consumed && pipe.status == 0)
+            objpar_internal_wait(&pipe.cond, &pipe.mutex);
+        if (pipe.produced == pipe.consumed)
+        {
+            /* Only a clean end of the input counts as success */
+            success = (pipe.status == 1);
+            objpar_internal_unlock(&pipe.mutex);
+            break;
+        }
+        objpar_internal_unlock(&pipe.mutex);
+
+        block = pipe.consumed % OBJPAR_INTERNAL_READ_BLOCKS;
+        success = objpar_stream_feed(p_stream, p_blocks + (objpar_size_t)block * OBJPAR_READ_BLOCK_SIZE, pipe.sizes[block]);
+
+        objpar_internal_lock(&pipe.mutex);
+        pipe.consumed += 1;
+        pipe.stop = !success;
+        objpar_internal_wake(&pipe.cond);
+        objpar_internal_unlock(&pipe.mutex);
+        if (!success)
+            break;
+    }
+
+    if (task.started)
+        objpar_internal_join_task(&task);
+#if !defined(_WIN32)
+    pthread_cond_destroy(&pipe.cond);
+    pthread_mutex_destroy(&pipe.mutex);
+#endif
+    return success;
+}
+
+void objpar_internal_read_task(void* p_arg)
+{
+    struct objpar_internal_pipe* p_pipe = (struct objpar_internal_pipe*)p_arg;
+
+    for (;;)
+    {
+        unsigned int block;
+        objpar_size_t size;
+
+        objpar_internal_lock(&p_pipe->mutex);
+        while (p_pipe->produced - p_pipe->consumed == OBJPAR_INTERNAL_READ_BLOCKS && !p_pipe->stop)
+            objpar_internal_wait(&p_pipe->cond, &p_pipe->mutex);
+        if (p_pipe->stop)
+        {
+            objpar_internal_unlock(&p_pipe->mutex);
+            return;
+        }
+        objpar_internal_unlock(&p_pipe->mutex);
+
+        /* The block is free until produced moves past it */
+        block = p_pipe->produced % OBJPAR_INTERNAL_READ_BLOCKS;
+        size = p_pipe->p_reader->p_read(p_pipe->p_reader->p_user_data, p_pipe->p_blocks + (objpar_size_t)block * OBJPAR_READ_BLOCK_SIZE, OBJPAR_READ_BLOCK_SIZE);
+
+        objpar_internal_lock(&p_pipe->mutex);
+        if (size == 0 || size > OBJPAR_READ_BLOCK_SIZE)
+        {
+            /* 1 is the end of the input, 2 a read error */
+            p_pipe->status = (size == 0 ? 1 : 2);
+            objpar_internal_wake(&p_pipe->cond);
+            objpar_internal_unlock(&p_pipe->mutex);
+            return;
+        }
+        p_pipe->sizes[block] = size;
+        p_pipe->produced += 1;
+        objpar_internal_wake(&p_pipe->cond);
+        objpar_internal_unlock(&p_pipe->mutex);
+    }
+}
+
+void objpar_internal_lock(objpar_internal_mutex_t* p_mutex)
+{
+#if defined(_WIN32)
+    AcquireSRWLockExclusive(p_mutex);
+#else
+    pthread_mutex_lock(p_mutex);
+#endif
+}
+
+void objpar_internal_unlock(objpar_internal_mutex_t* p_mutex)
+{
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive(p_mutex);
+#else
+    pthread_mutex_unlock(p_mutex);
+#endif
+}
+
+void objpar_internal_wait(objpar_internal_cond_t* p_cond, objpar_internal_mutex_t* p_mutex)
+{
+#if defined(_WIN32)
+    SleepConditionVariableSRW(p_cond, p_mutex, INFINITE, 0);
+#else
+    pthread_cond_wait(p_cond, p_mutex);
+#endif
+}
+
+void objpar_internal_wake(objpar_internal_cond_t* p_cond)
+{
+    /* The reader and the parser wait on the same condition */
+#if defined(_WIN32)
+    WakeAllConditionVariable(p_cond);
+#else
+    pthread_cond_broadcast(p_cond);
+#endif
+}
+
+void objpar_internal_count_task(void* p_arg)
+{
+    struct objpar_internal_range* p_range = (struct objpar_internal_range*)p_arg;
+    p_range->counted = objpar_internal_count(p_range->p_string, p_range->begin, p_range->end, &p_range->data);
+}
+
+void objpar_internal_fill_task(void* p_arg)
+{
+    struct objpar_internal_range* p_range = (struct objpar_internal_range*)p_arg;
+    objpar_internal_fill(p_range->p_string, p_range->begin, p_range->end, &p_range->data);
+}
+
+void objpar_internal_mtl_task(void* p_arg)
+{
+    struct objpar_internal_mtl_range* p_range = (struct objpar_internal_mtl_range*)p_arg;
+    objpar_internal_mtl_parse(p_range->p_string, p_range->size, &p_range->data);
+}
+
+void objpar_internal_batch_task(void* p_arg)
+{
+    struct objpar_internal_worker* p_worker;
+    const struct objpar_batch* p_batch;
+    const struct objpar_allocator* p_allocator;
+    unsigned int item;
+
+    p_worker = (struct objpar_internal_worker*)p_arg;
+    p_batch = p_worker->p_batch;
+    p_allocator = (p_batch->p_allocator != OBJPAR_NULL(const struct objpar_allocator) ? p_batch->p_allocator : &p_worker->arena.allocator);
+
+    for (item = objpar_internal_batch_next(p_worker); item != OBJPAR_NONE; item = objpar_internal_batch_next(p_worker))
+    {
+        const struct objpar_batch_item* p_item = &p_batch->p_items[item];
+        struct objpar_model model;
+        unsigned int status;
+
+        /* A failed file is reported and the worker moves on */
+        objpar_arena_reset(&p_worker->arena);
+        status = objpar_internal_load(p_item->p_path, p_item->p_string, p_item->string_size, p_batch->flags, p_batch->p_format, p_allocator, &model);
+        if (status == OBJPAR_LOAD_OK)
+            p_worker->loaded_count += 1;
+        if (p_batch->p_complete != 0)
+            p_batch->p_complete(p_batch->p_user_data, item, status, &model);
+        else if (p_batch->p_allocator != OBJPAR_NULL(const struct objpar_allocator))
+            objpar_free_model(p_allocator, &model);
+    }
+}
+
+void objpar_internal_expand_task(void* p_arg)
+{
+    struct objpar_internal_expand* p_range = (struct objpar_internal_expand*)p_arg;
+    unsigned int scratch[OBJPAR_INTERNAL_EXPAND_SCRATCH];
+
+    p_range->p_scratch = scratch;
+    objpar_internal_expand_range(p_range);
+}
+
+unsigned int objpar_internal_batch_next(struct objpar_internal_worker* p_worker)
+{
+    objpar_internal_u64 range;
+    objpar_internal_u64 begin;
+    objpar_internal_u64 end;
+    unsigned int offset;
+
+    /* Own items are taken from the front */
+    for (;;)
+    {
+        range = objpar_internal_load_u64(&p_worker->range);
+        begin = range & 0xFFFFFFFF;
+        end = range >> 32;
+        if (begin >= end)
+            break;
+        if (objpar_internal_cas(&p_worker->range, range, (begin + 1) | (end << 32)))
+            return (unsigned int)begin;
+    }
+
+    /* Steal the back half of the next worker with items left. No items
+       are added after the start, so when every range is empty the batch
+       is done. */
+    for (offset = 1; offset < p_worker->worker_count; ++offset)
+    {
+        struct objpar_internal_worker* p_victim = &p_worker->p_workers[(p_worker->index + offset) % p_worker->worker_count];
+        objpar_internal_u64 half;
+
+        for (;;)
+        {
+            range = objpar_internal_load_u64(&p_victim->range);
+            begin = range & 0xFFFFFFFF;
+            end = range >> 32;
+            if (begin >= end)
+                break;
+            half = (end - begin + 1) / 2;
+            if (!objpar_internal_cas(&p_victim->range, range, begin | ((end - half) << 32)))
+                continue;
+
+            /* The own range is empty, so nobody else changes it before
+               this store. The first stolen item is returned right away. */
+            range = objpar_internal_load_u64(&p_worker->range);
+            while (!objpar_internal_cas(&p_worker->range, range, (end - half + 1) | (end << 32)))
+                range = objpar_internal_load_u64(&p_worker->range);
+            return (unsigned int)(end - half);
+        }
+    }
+    return OBJPAR_NONE;
+}
+
+unsigned int objpar_internal_cas(volatile objpar_internal_u64* p_value, objpar_internal_u64 expected, objpar_internal_u64 desired)
+{
+#if defined(_WIN32)
+    return (objpar_internal_u64)InterlockedCompareExchange64((volatile LONG64*)p_value, (LONG64)desired, (LONG64)expected) == expected;
+#else
+    return __sync_bool_compare_and_swap(p_value, expected, desired) ? 1 : 0;
+#endif
+}
+
+objpar_internal_u64 objpar_internal_load_u64(volatile objpar_internal_u64* p_value)
+{
+    /* Swapping 0 for 0 never changes the value but reads all 64 bits
+       atomically, a plain load can tear on 32 bit targets. */
+#if defined(_WIN32)
+    return (objpar_internal_u64)InterlockedCompareExchange64((volatile LONG64*)p_value, 0, 0);
+#else
+    return __sync_val_compare_and_swap(p_value, 0, 0);
+#endif
+}
+#endif
+
+#if defined(OBJPAR_ENABLE_FILE)
+objpar_size_t objpar_internal_window_end(const char* p_string, objpar_size_t begin, objpar_size_t string_size)
+{
+    objpar_size_t end;
+
+    if (string_size - begin <= OBJPAR_FILE_WINDOW_SIZE)
+        return string_size;
+
+    end = objpar_internal_line_end(p_string, begin + OBJPAR_FILE_WINDOW_SIZE, string_size) + 1;
+    return (end < string_size ? end : string_size);
+}
+
+void objpar_internal_file_release(struct objpar_file* p_file, objpar_size_t begin, objpar_size_t end)
+{
+#if !defined(_WIN32) && defined(MADV_DONTNEED)
+    objpar_size_t page_size;
+    objpar_size_t first;
+    objpar_size_t last;
+
+    /* Only whole pages inside the window are released. Views on Windows
+       are left to the working set manager. */
+    page_size = (objpar_size_t)sysconf(_SC_PAGESIZE);
+    first = (begin + page_size - 1) / page_size * page_size;
+    last = (end < p_file->size ? end / page_size * page_size : end);
+    if (last > first)
+        madvise((void*)(p_file->p_string + first), last - first, MADV_DONTNEED);
+#else
+    (void)p_file;
+    (void)begin;
+    (void)end;
+#endif
+}
+#endif
+
+unsigned int objpar_internal_mesh_layout(const struct objpar_data* p_data, const struct objpar_vertex_format* p_format, unsigned int flags, unsigned int capacity, struct objpar_mesh* p_mesh)
+{
+    unsigned int position_size;
+    unsigned int texcoord_size;
+    unsigned int normal_size;
+    unsigned int tangent_size;
+    unsigned int offset;
+
+    memset(p_mesh, 0, sizeof(struct objpar_mesh));
+    if (p_format != OBJPAR_NULL(struct objpar_vertex_format))
+    {
+        p_mesh->position_format = p_format->position_format;
+        p_mesh->texcoord_format = p_format->texcoord_format;
+        p_mesh->normal_format = p_format->normal_format;
+        p_mesh->tangent_format = p_format->tangent_format;
+    }
+
+    /* Packed normal formats only make sense for directions, octahedral
+       tangents would lose the sign. */
+    if (p_mesh->position_format > OBJPAR_FORMAT_HALF ||
+        p_mesh->texcoord_format > OBJPAR_FORMAT_HALF ||
+        p_mesh->normal_format > OBJPAR_FORMAT_SNORM_10_10_10_2 ||
+        p_mesh->tangent_format == OBJPAR_FORMAT_OCT16 ||
+        p_mesh->tangent_format > OBJPAR_FORMAT_SNORM_10_10_10_2)
+    {
+        return 0;
+    }
+
+    position_size = (p_data->position_count > 0 ? objpar_internal_attribute_size(p_data->position_width, p_mesh->position_format) : 0);
+    texcoord_size = (p_data->texcoord_count > 0 ? objpar_internal_attribute_size(p_data->texcoord_width, p_mesh->texcoord_format) : 0);
+    normal_size = (p_data->normal_count > 0 ? objpar_internal_attribute_size(p_data->normal_width, p_mesh->normal_format) : 0);
+    tangent_size = 0;
+    if (flags & (OBJPAR_MESH_GENERATE_NORMALS | OBJPAR_MESH_GENERATE_TANGENTS))
+    {
+        /* Generated normals have 3 components when the file has none */
+        normal_size = objpar_internal_attribute_size(p_data->normal_count > 0 ? p_data->normal_width : 3, p_mesh->normal_format);
+    }
+    if (flags & OBJPAR_MESH_GENERATE_TANGENTS)
+    {
+        tangent_size = objpar_internal_attribute_size(4, p_mesh->tangent_format);
+    }
+
+    p_mesh->vertex_stride = position_size + texcoord_size + normal_size + tangent_size;
+    p_mesh->position_offset = -1;
+    p_mesh->texcoord_offset = -1;
+    p_mesh->normal_offset = -1;
+    p_mesh->tangent_offset = -1;
+
+    /* Interleaved attributes are offsets inside a vertex and share the
+       vertex stride. De-interleaved attributes are offsets to streams of
+       capacity elements, each with the attribute size as stride. */
+    offset = 0;
+    if (position_size > 0)
+    {
+        p_mesh->position_offset = (int)offset;
+        p_mesh->position_stride = (flags & OBJPAR_MESH_DEINTERLEAVE ? position_size : p_mesh->vertex_stride);
+        offset += (flags & OBJPAR_MESH_DEINTERLEAVE ? position_size * capacity : position_size);
+    }
+    if (texcoord_size > 0)
+    {
+        p_mesh->texcoord_offset = (int)offset;
+        p_mesh->texcoord_stride = (flags & OBJPAR_MESH_DEINTERLEAVE ? texcoord_size : p_mesh->vertex_stride);
+        offset += (flags & OBJPAR_MESH_DEINTERLEAVE ? texcoord_size * capacity : texcoord_size);
+    }
+    if (normal_size > 0)
+    {
+        p_mesh->normal_offset = (int)offset;
+        p_mesh->normal_stride = (flags & OBJPAR_MESH_DEINTERLEAVE ? normal_size : p_mesh->vertex_stride);
+        offset += (flags & OBJPAR_MESH_DEINTERLEAVE ? normal_size * capacity : normal_size);
+    }
+    if (tangent_size > 0)
+    {
+        p_mesh->tangent_offset = (int)offset;
+        p_mesh->tangent_stride = (flags & OBJPAR_MESH_DEINTERLEAVE ? tangent_size : p_mesh->vertex_stride);
+    }
+
+    return p_mesh->vertex_stride;
+}
+
+unsigned int objpar_internal_attribute_size(unsigned int width, unsigned int format)
+{
+    switch (format)
+    {
+    case OBJPAR_FORMAT_HALF:
+        /* Rounded to an even number of halfs, 16 bit formats with 3
+           components aren't supported by most graphics APIs. */
+        return ((width + 1) & ~1u) * sizeof(unsigned short);
+    case OBJPAR_FORMAT_OCT16:
+    case OBJPAR_FORMAT_SNORM_10_10_10_2:
+        return sizeof(unsigned int);
+    default:
+        return width * sizeof(float);
+    }
+}
+
+void objpar_internal_mesh_attribute(const float* p_source, unsigned int count, unsigned int width, unsigned int index, unsigned int format, float pad, char* p_vertex)
+{
+    unsigned int j;
+    float direction[3];
+
+    /* Indices are 1 based, 0 means the corner doesn't reference this
+       attribute. Missing or out of range attributes are zero filled. */
+    if (index > 0 && index <= count)
+        p_source += (objpar_size_t)(index - 1) * width;
+    else
+        p_source = OBJPAR_NULL(float);
+
+    if (format == OBJPAR_FORMAT_FLOAT)
+    {
+        float* p_float = (float*)p_vertex;
+        for (j = 0; j < width; ++j)
+        {
+            p_float[j] = (p_source != OBJPAR_NULL(float) ? p_source[j] : 0.0f);
+        }
+        return;
+    }
+
+    if (format == OBJPAR_FORMAT_HALF)
+    {
+        unsigned short* p_half = (unsigned short*)p_vertex;
+        for (j = 0; j < width; ++j)
+        {
+            p_half[j] = objpar_internal_half(p_source != OBJPAR_NULL(float) ? p_source[j] : 0.0f);
+        }
+        if (width & 1)
+        {
+            p_half[width] = objpar_internal_half(pad);
+        }
+        return;
+    }
+
+    for (j = 0; j < 3; ++j)
+    {
+        direction[j] = (p_source != OBJPAR_NULL(float) && j < width ? p_source[j] : 0.0f);
+    }
+
+    if (format == OBJPAR_FORMAT_OCT16)
+    {
+        /* Octahedral mapping: project on the octahedron |x| + |y| + |z| = 1
+           and fold the lower half over the diagonals. */
+        float length;
+        float x;
+        float y;
+        unsigned int packed;
+
+        length = OBJPAR_ABS(direction[0]) + OBJPAR_ABS(direction[1]) + OBJPAR_ABS(direction[2]);
+        x = 0.0f;
+        y = 0.0f;
+        if (length > 0.0f)
+        {
+            x = direction[0] / length;
+            y = direction[1] / length;
+            if (direction[2] < 0.0f)
+            {
+                float folded_x = (1.0f - OBJPAR_ABS(y)) * (x < 0.0f ? -1.0f : 1.0f);
+                float folded_y = (1.0f - OBJPAR_ABS(x)) * (y < 0.0f ? -1.0f : 1.0f);
+                x = folded_x;
+                y = folded_y;
+            }
+        }
+        packed = ((unsigned int)objpar_internal_snorm(x, 32767.0f) & 0xFFFF) |
+            (((unsigned int)objpar_internal_snorm(y, 32767.0f) & 0xFFFF) << 16);
+        memcpy(p_vertex, &packed, sizeof(unsigned int));
+        return;
+    }
+
+    {
+        /* x, y and z in 10 bit signed normalized integers from the low
+           bits up, the 2 bit w is left as 0 for normals. */
+        unsigned int packed;
+
+        packed = ((unsigned int)objpar_internal_snorm(direction[0], 511.0f) & 0x3FF) |
+            (((unsigned int)objpar_internal_snorm(direction[1], 511.0f) & 0x3FF) << 10) |
+            (((unsigned int)objpar_internal_snorm(direction[2], 511.0f) & 0x3FF) << 20);
+        if (p_source != OBJPAR_NULL(float) && width > 3)
+        {
+            /* Tangents keep the bitangent sign in w */
+            packed |= ((unsigned int)objpar_internal_snorm(p_source[3], 1.0f) & 0x3) << 30;
+        }
+        memcpy(p_vertex, &packed, sizeof(unsigned int));
+    }
+}
+
+void objpar_internal_mesh_vertex(const struct objpar_data* p_data, const struct objpar_mesh* p_layout, const unsigned int* p_corner, unsigned int vertex)
+{
+    char* p_vertices = (char*)p_layout->p_vertices;
+
+    if (p_layout->position_offset >= 0)
+    {
+        objpar_internal_mesh_attribute(p_data->p_positions, p_data->position_count, p_data->position_width, p_corner[OBJPAR_V_IDX],
+            p_layout->position_format, 1.0f, p_vertices + p_layout->position_offset + (objpar_size_t)vertex * p_layout->position_stride);
+    }
+    if (p_layout->texcoord_offset >= 0)
+    {
+        objpar_internal_mesh_attribute(p_data->p_texcoords, p_data->texcoord_count, p_data->texcoord_width, p_corner[OBJPAR_VT_IDX],
+            p_layout->texcoord_format, 0.0f, p_vertices + p_layout->texcoord_offset + (objpar_size_t)vertex * p_layout->texcoord_stride);
+    }
+    if (p_layout->normal_offset >= 0)
+    {
+        objpar_internal_mesh_attribute(p_data->p_normals, p_data->normal_count, p_data->normal_width, p_corner[OBJPAR_VN_IDX],
+            p_layout->normal_format, 0.0f, p_vertices + p_layout->normal_offset + (objpar_size_t)vertex * p_layout->normal_stride);
+    }
+}
+
+unsigned int objpar_internal_mesh_expand(const struct objpar_internal_expand* p_expand, unsigned int corner_count, unsigned int max_face_width, unsigned int range_count, struct objpar_submesh* p_submeshes)
+{
+    struct objpar_internal_expand ranges[OBJPAR_MAX_THREADS];
+#if defined(OBJPAR_ENABLE_THREADS)
+    struct objpar_internal_task tasks[OBJPAR_MAX_THREADS];
+#endif
+    const struct objpar_data* p_data;
+    const struct objpar_group* p_groups;
+    objpar_internal_u64 split;
+    unsigned int count;
+    unsigned int submesh_count;
+    unsigned int material;
+    unsigned int group;
+    unsigned int corner;
+    unsigned int first;
+    unsigned int i;
+
+    /* Ear clipping needs scratch memory for every range, workers keep it
+       on their stack so faces have to fit in it. */
+    if (range_count > corner_count / OBJPAR_MIN_PARALLEL_CORNERS)
+        range_count = corner_count / OBJPAR_MIN_PARALLEL_CORNERS;
+    if (range_count == 0 || ((p_expand->flags & OBJPAR_MESH_EAR_CLIP) && max_face_width > OBJPAR_INTERNAL_EXPAND_FACE_WIDTH))
+        range_count = 1;
+
+    p_data = p_expand->p_data;
+    p_groups = p_expand->p_groups;
+    material = 0;
+    group = OBJPAR_NONE;
+    objpar_internal_expand_next(p_data, p_groups, p_expand->group_count, &material, &group);
+
+    ranges[0] = *p_expand;
+    ranges[0].material = material;
+    ranges[0].group = group;
+    ranges[0].face = (group < p_expand->group_count ? p_groups[group].face_begin : 0);
+    ranges[0].corner_begin = 0;
+    count = 1;
+    split = (objpar_internal_u64)corner_count / range_count;
+
+    /* Walk the faces in build order once to find the submeshes and to cut
+       the corners into ranges of about the same size at face boundaries. */
+    submesh_count = 0;
+    corner = 0;
+    first = 0;
+    while (group < p_expand->group_count)
+    {
+        unsigned int previous = material;
+        unsigned int face;
+
+        for (face = p_groups[group].face_begin; face < p_groups[group].face_begin + p_groups[group].face_count; ++face)
+        {
+            unsigned int face_width = p_data->p_face_offsets[face + 1] - p_data->p_face_offsets[face];
+
+            if (count < range_count && corner >= split)
+            {
+                ranges[count - 1].corner_end = corner;
+                ranges[count] = *p_expand;
+                ranges[count].material = material;
+                ranges[count].group = group;
+                ranges[count].face = face;
+                ranges[count].corner_begin = corner;
+                count += 1;
+                split = (objpar_internal_u64)corner_count * count / range_count;
+            }
+            if (face_width >= 3)
+                corner += (face_width - 2) * 3;
+        }
+
+        objpar_internal_expand_next(p_data, p_groups, p_expand->group_count, &material, &group);
+        if (material != previous && corner > first)
+        {
+            p_submeshes[submesh_count].first = first;
+            p_submeshes[submesh_count].count = corner - first;
+            p_submeshes[submesh_count].material = (previous < p_data->material_count ? previous : OBJPAR_NONE);
+            submesh_count += 1;
+            first = corner;
+        }
+    }
+    ranges[count - 1].corner_end = corner_count;
+
+#if defined(OBJPAR_ENABLE_THREADS)
+    if (count > 1)
+    {
+        for (i = 0; i < count; ++i)
+        {
+            tasks[i].p_func = objpar_internal_expand_task;
+            tasks[i].p_arg = &ranges[i];
+        }
+        objpar_internal_run_tasks(tasks, count);
+        return submesh_count;
+    }
+#endif
+
+    for (i = 0; i < count; ++i)
+    {
+        objpar_internal_expand_range(&ranges[i]);
+    }
+    return submesh_count;
+}
+
+unsigned int objpar_internal_expand_kernel(const struct objpar_data* p_data, const struct objpar_mesh* p_layout)
+{
+    unsigned int kernel;
+
+    /* 3/2/3, 3/0/3, 3/2/0 and 3/0/0 float layouts cover nearly every file */
+    if (p_layout->position_offset < 0 || p_data->position_width != 3 ||
+        p_layout->position_format != OBJPAR_FORMAT_FLOAT || p_layout->tangent_offset >= 0)
+    {
+        return 0;
+    }
+    kernel = OBJPAR_INTERNAL_EXPAND_FLOAT;
+
+    if (p_layout->texcoord_offset >= 0)
+    {
+        if (p_data->texcoord_width != 2 || p_layout->texcoord_format != OBJPAR_FORMAT_FLOAT)
+            return 0;
+        kernel |= OBJPAR_INTERNAL_EXPAND_TEXCOORD;
+    }
+    if (p_layout->normal_offset >= 0)
+    {
+        if (p_data->normal_width != 3 || p_layout->normal_format != OBJPAR_FORMAT_FLOAT)
+            return 0;
+        kernel |= OBJPAR_INTERNAL_EXPAND_NORMAL;
+    }
+    return kernel;
+}
+
+void objpar_internal_expand_next(const struct objpar_data* p_data, const struct objpar_group* p_groups, unsigned int group_count, unsigned int* p_material, unsigned int* p_group)
+{
+    unsigned int material;
+    unsigned int group;
+
+    /* Next group with the same material, then the groups of the following
+       materials and finally the ones without a material. group_count is
+       returned after the last one. */
+    material = *p_material;
+    group = *p_group + 1;
+    for (; material <= p_data->material_count; ++material, group = 0)
+    {
+        unsigned int material_index = (material < p_data->material_count ? material : OBJPAR_NONE);
+
+        for (; group < group_count; ++group)
+        {
+            if (p_groups[group].material == material_index)
+            {
+                *p_material = material;
+                *p_group = group;
+                return;
+            }
+        }
+    }
+    *p_material = material;
+    *p_group = group_count;
+}
+
+void objpar_internal_expand_range(const struct objpar_internal_expand* p_range)
+{
+    const struct objpar_data* p_data;
+    const struct objpar_group* p_groups;
+    unsigned int material;
+    unsigned int group;
+    unsigned int face;
+    unsigned int corner;
+
+    p_data = p_range->p_data;
+    p_groups = p_range->p_groups;
+    material = p_range->material;
+    group = p_range->group;
+    face = p_range->face;
+    corner = p_range->corner_begin;
+
+    while (corner < p_range->corner_end)
+    {
+        unsigned int face_end = p_groups[group].face_begin + p_groups[group].face_count;
+
+        for (; face < face_end && corner < p_range->corner_end; ++face)
+        {
+            const unsigned int* p_face;
+            const unsigned int* p_triangles;
+            objpar_size_t face_offset;
+            unsigned int face_width;
+            unsigned int triangle;
+            unsigned int index;
+
+            face_offset = p_data->p_face_offsets[face];
+            face_width = p_data->p_face_offsets[face + 1] - p_data->p_face_offsets[face];
+            if (face_width < 3)
+                continue;
+
+            /* Triangles and fans are generated on the fly, only clipped
+               polygons go through the scratch memory. */
+            p_face = &p_data->p_faces[face_offset * 3];
+            p_triangles = OBJPAR_NULL(const unsigned int);
+            if (face_width > 3 && (p_range->flags & OBJPAR_MESH_EAR_CLIP))
+            {
+                objpar_internal_triangulate(p_data, p_face, face_width, p_range->flags, p_range->p_scratch);
+                p_triangles = p_range->p_scratch;
+            }
+
+            for (triangle = 0; triangle + 2 < face_width; ++triangle)
+            {
+                for (index = 0; index < 3; ++index, ++corner)
+                {
+                    unsigned int face_corner;
+
+                    if (p_triangles != OBJPAR_NULL(const unsigned int))
+                        face_corner = p_triangles[triangle * 3 + index];
+                    else
+                        face_corner = (index == 0 ? 0 : triangle + index);
+                    objpar_internal_expand_corner(p_range, &p_face[face_corner * 3], face_offset + face_corner, corner);
+                }
+            }
+        }
+
+        objpar_internal_expand_next(p_data, p_groups, p_range->group_count, &material, &group);
+        if (group >= p_range->group_count)
+            break;
+        face = p_groups[group].face_begin;
+    }
+}
+
+void objpar_internal_expand_corner(const struct objpar_internal_expand* p_range, const unsigned int* p_corner, objpar_size_t face_corner, unsigned int vertex)
+{
+    const struct objpar_data* p_data;
+    const struct objpar_mesh* p_layout;
+    const float* p_source;
+    float* p_target;
+    char* p_vertices;
+    unsigned int index;
+
+    p_data = p_range->p_data;
+    p_layout = p_range->p_layout;
+    if (p_range->kernel == 0)
+    {
+        objpar_internal_mesh_vertex(p_data, p_layout, p_corner, vertex);
+        if (p_range->p_gen != OBJPAR_NULL(const struct objpar_internal_mesh_gen))
+            objpar_internal_mesh_gen_vertex(p_range->p_gen, p_layout, face_corner, vertex);
+        return;
+    }
+
+    /* Fixed width copies without format or width branches. Index 0 and
+       out of range indices wrap around in the unsigned compare and read
+       the zero vector instead. */
+    p_vertices = (char*)p_layout->p_vertices;
+    index = p_corner[OBJPAR_V_IDX] - 1;
+    p_source = (index < p_data->position_count ? p_data->p_positions + (objpar_size_t)index * 3 : p_range->zero);
+    p_target = (float*)(p_vertices + p_layout->position_offset + (objpar_size_t)vertex * p_layout->position_stride);
+    p_target[0] = p_source[0];
+    p_target[1] = p_source[1];
+    p_target[2] = p_source[2];
+
+    if (p_range->kernel & OBJPAR_INTERNAL_EXPAND_TEXCOORD)
+    {
+        index = p_corner[OBJPAR_VT_IDX] - 1;
+        p_source = (index < p_data->texcoord_count ? p_data->p_texcoords + (objpar_size_t)index * 2 : p_range->zero);
+        p_target = (float*)(p_vertices + p_layout->texcoord_offset + (objpar_size_t)vertex * p_layout->texcoord_stride);
+        p_target[0] = p_source[0];
+        p_target[1] = p_source[1];
+    }
+
+    if (p_range->kernel & OBJPAR_INTERNAL_EXPAND_NORMAL)
+    {
+        index = p_corner[OBJPAR_VN_IDX] - 1;
+        p_source = (index < p_data->normal_count ? p_data->p_normals + (objpar_size_t)index * 3 : p_range->zero);
+        p_target = (float*)(p_vertices + p_layout->normal_offset + (objpar_size_t)vertex * p_layout->normal_stride);
+        p_target[0] = p_source[0];
+        p_target[1] = p_source[1];
+        p_target[2] = p_source[2];
+    }
+}
+
+unsigned short objpar_internal_half(float value)
+{
+    unsigned int bits;
+    unsigned int sign;
+    unsigned int exponent;
+    unsigned int mantissa;
+
+    memcpy(&bits, &value, sizeof(unsigned int));
+    sign = (bits >> 16) & 0x8000;
+    exponent = (bits >> 23) & 0xFF;
+    mantissa = bits & 0x7FFFFF;
+
+    if (exponent == 0xFF)
+    {
+        /* Infinity stays infinity, NaN keeps a quiet bit */
+        return (unsigned short)(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+    }
+    if (exponent > 142)
+    {
+        /* Too large for a half */
+        return (unsigned short)(sign | 0x7C00);
+    }
+    if (exponent < 113)
+    {
+        /* Subnormal half or zero. The implicit bit is restored and the
+           mantissa shifted into place with round to nearest even. */
+        unsigned int shift;
+        unsigned int half_mantissa;
+        unsigned int rest;
+
+        if (exponent < 102)
+            return (unsigned short)sign;
+
+        mantissa |= 0x800000;
+        shift = 126 - exponent;
+        half_mantissa = mantissa >> shift;
+        rest = mantissa & ((1u << shift) - 1);
+        if (rest > (1u << (shift - 1)) || (rest == (1u << (shift - 1)) && (half_mantissa & 1)))
+            half_mantissa += 1;
+        return (unsigned short)(sign | half_mantissa);
+    }
+
+    /* Normal range. A carry out of the mantissa correctly bumps the
+       exponent and can round up to infinity. */
+    bits = ((exponent - 112) << 10) | (mantissa >> 13);
+    if ((mantissa & 0x1FFF) > 0x1000 || ((mantissa & 0x1FFF) == 0x1000 && (bits & 1)))
+        bits += 1;
+    return (unsigned short)(sign | bits);
+}
+
+int objpar_internal_snorm(float value, float scale)
+{
+    if (value > 1.0f)
+        value = 1.0f;
+    if (value < -1.0f)
+        value = -1.0f;
+    value *= scale;
+    return (int)(value < 0.0f ? value - 0.5f : value + 0.5f);
+}
+
+void objpar_internal_cache_sizes(const struct objpar_internal_cache_header* p_header, objpar_internal_u64* p_sizes)
+{
+    const struct objpar_data* p_data;
+    const struct objpar_mesh* p_mesh;
+
+    /* Sizes are derived from the counts with 64 bit math, a damaged header
+       then fails the bounds checks instead of wrapping around. */
+    p_data = &p_header->data;
+    p_mesh = &p_header->mesh;
+    p_sizes[0] = (objpar_internal_u64)p_data->position_count * p_data->position_width * sizeof(float);
+    p_sizes[1] = (objpar_internal_u64)p_data->texcoord_count * p_data->texcoord_width * sizeof(float);
+    p_sizes[2] = (objpar_internal_u64)p_data->normal_count * p_data->normal_width * sizeof(float);
+    p_sizes[3] = (objpar_internal_u64)p_data->corner_count * 3 * sizeof(unsigned int);
+    p_sizes[4] = (p_data->face_count > 0 ? ((objpar_internal_u64)p_data->face_count + 1) * sizeof(unsigned int) : 0);
+    p_sizes[5] = 0;
+    p_sizes[6] = 0;
+    p_sizes[7] = (objpar_internal_u64)p_data->group_count * sizeof(struct objpar_group);
+    p_sizes[8] = (objpar_internal_u64)p_data->material_count * sizeof(unsigned int);
+    p_sizes[9] = (objpar_internal_u64)p_data->library_count * sizeof(unsigned int);
+    p_sizes[10] = (objpar_internal_u64)p_data->names_size;
+    p_sizes[11] = 0;
+    if (p_header->has_mesh)
+    {
+        p_sizes[5] = (objpar_internal_u64)p_mesh->vertex_count * p_mesh->vertex_stride;
+        p_sizes[6] = (objpar_internal_u64)p_mesh->index_count * p_mesh->index_size;
+        p_sizes[11] = (objpar_internal_u64)p_mesh->submesh_count * sizeof(struct objpar_submesh);
+    }
+}
+
+objpar_internal_u64 objpar_internal_cache_align(objpar_internal_u64 offset)
+{
+    return (offset + (OBJPAR_CACHE_ALIGNMENT - 1)) & ~(objpar_internal_u64)(OBJPAR_CACHE_ALIGNMENT - 1);
+}
+
+unsigned int objpar_internal_triangulate(const struct objpar_data* p_data, const unsigned int* p_face, unsigned int corner_count, unsigned int flags, unsigned int* p_scratch)
+{
+    unsigned int* p_triangles;
+    unsigned int* p_remaining;
+    float* p_uv;
+    unsigned int triangle_count;
+    unsigned int remaining_count;
+    unsigned int index;
+    unsigned int axis;
+    float normal[3];
+    float sign;
+
+    p_triangles = p_scratch;
+    triangle_count = 0;
+
+    if (corner_count > 3 && (flags & OBJPAR_MESH_EAR_CLIP) && p_data->position_count > 0)
+    {
+        p_remaining = p_scratch + (corner_count - 2) * 3;
+        p_uv = (float*)(p_remaining + corner_count);
+
+        /* Project the polygon on the axis plane that is most parallel to
+           it. The normal is computed with Newell's method so it stays
+           correct for concave polygons. */
+        normal[0] = 0.0f;
+        normal[1] = 0.0f;
+        normal[2] = 0.0f;
+        for (index = 0; index < corner_count; ++index)
+        {
+            float a[3];
+            float b[3];
+
+            objpar_internal_mesh_position(p_data, p_face[index * 3 + OBJPAR_V_IDX], a);
+            objpar_internal_mesh_position(p_data, p_face[((index + 1) % corner_count) * 3 + OBJPAR_V_IDX], b);
+            normal[0] += (a[1] - b[1]) * (a[2] + b[2]);
+            normal[1] += (a[2] - b[2]) * (a[0] + b[0]);
+            normal[2] += (a[0] - b[0]) * (a[1] + b[1]);
+        }
+
+        axis = 2;
+        if (OBJPAR_ABS(normal[0]) >= OBJPAR_ABS(normal[1]) && OBJPAR_ABS(normal[0]) >= OBJPAR_ABS(normal[2]))
+            axis = 0;
+        else if (OBJPAR_ABS(normal[1]) >= OBJPAR_ABS(normal[2]))
+            axis = 1;
+
+        /* Flip the projection so the polygon is always counter clockwise */
+        sign = (normal[axis] < 0.0f ? -1.0f : 1.0f);
+
+        for (index = 0; index < corner_count; ++index)
+        {
+            float position[3];
+
+            objpar_internal_mesh_position(p_data, p_face[index * 3 + OBJPAR_V_IDX], position);
+            p_uv[index * 2 + 0] = position[(axis + 1) % 3] * sign;
+            p_uv[index * 2 + 1] = position[(axis + 2) % 3];
+            p_remaining[index] = index;
+        }
+
+        remaining_count = corner_count;
+
+        while (remaining_count > 3)
+        {
+            unsigned int ear;
+
+            /* If there is no ear, the polygon is degenerate or self
+               intersecting. Clipping the first corner still guarantees
+               n - 2 triangles. */
+            ear = 0;
+
+            for (index = 0; index < remaining_count; ++index)
+            {
+                unsigned int prev;
+                unsigned int curr;
+                unsigned int next;
+                unsigned int other;
+                unsigned int is_ear;
+
+                prev = p_remaining[(index + remaining_count - 1) % remaining_count];
+                curr = p_remaining[index];
+                next = p_remaining[(index + 1) % remaining_count];
+
+                if (objpar_internal_cross(&p_uv[prev * 2], &p_uv[curr * 2], &p_uv[next * 2]) <= 0.0f)
+                    continue;
+
+                is_ear = 1;
+                for (other = 0; other < remaining_count && is_ear; ++other)
+                {
+                    const float* p_point;
+                    unsigned int vertex = p_remaining[other];
+
+                    if (vertex == prev || vertex == curr || vertex == next)
+                        continue;
+
+                    p_point = &p_uv[vertex * 2];
+                    if (objpar_internal_cross(&p_uv[prev * 2], &p_uv[curr * 2], p_point) >= 0.0f &&
+                        objpar_internal_cross(&p_uv[curr * 2], &p_uv[next * 2], p_point) >= 0.0f &&
+                        objpar_internal_cross(&p_uv[next * 2], &p_uv[prev * 2], p_point) >= 0.0f)
+                    {
+                        is_ear = 0;
+                    }
+                }
+
+                if (is_ear)
+                {
+                    ear = index;
+                    break;
+                }
+            }
+
+            p_triangles[triangle_count * 3 + 0] = p_remaining[(ear + remaining_count - 1) % remaining_count];
+            p_triangles[triangle_count * 3 + 1] = p_remaining[ear];
+            p_triangles[triangle_count * 3 + 2] = p_remaining[(ear + 1) % remaining_count];
+            triangle_count += 1;
+
+            for (index = ear; index + 1 < remaining_count; ++index)
+            {
+                p_remaining[index] = p_remaining[index + 1];
+            }
+            remaining_count -= 1;
+        }
+
+        p_triangles[triangle_count * 3 + 0] = p_remaining[0];
+        p_triangles[triangle_count * 3 + 1] = p_remaining[1];
+        p_triangles[triangle_count * 3 + 2] = p_remaining[2];
+        return triangle_count + 1;
+    }
+
+    /* Fan around the first corner, exact for convex polygons */
+    for (index = 1; index + 1 < corner_count; ++index)
+    {
+        p_triangles[triangle_count * 3 + 0] = 0;
+        p_triangles[triangle_count * 3 + 1] = index;
+        p_triangles[triangle_count * 3 + 2] = index + 1;
+        triangle_count += 1;
+    }
+
+    return triangle_count;
+}
+
+void objpar_internal_mesh_position(const struct objpar_data* p_data, unsigned int index, float* p_position)
+{
+    unsigned int j;
+
+    p_position[0] = 0.0f;
+    p_position[1] = 0.0f;
+    p_position[2] = 0.0f;
+
+    if (index > 0 && index <= p_data->position_count)
+    {
+        const float* p_source = &p_data->p_positions[(objpar_size_t)(index - 1) * p_data->position_width];
+        for (j = 0; j < p_data->position_width && j < 3; ++j)
+        {
+            p_position[j] = p_source[j];
+        }
+    }
+}
+
+float objpar_internal_cross(const float* p_a, const float* p_b, const float* p_c)
+{
+    return (p_b[0] - p_a[0]) * (p_c[1] - p_a[1]) - (p_b[1] - p_a[1]) * (p_c[0] - p_a[0]);
+}
+
+unsigned int objpar_internal_mesh_hash(const unsigned int* p_corner)
+{
+    unsigned int hash;
+
+    hash = p_corner[OBJPAR_V_IDX] * 0x9E3779B1u;
+    hash ^= p_corner[OBJPAR_VT_IDX] * 0x85EBCA77u;
+    hash ^= p_corner[OBJPAR_VN_IDX] * 0xC2B2AE3Du;
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6Du;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+unsigned int objpar_internal_mesh_gen_size(const struct objpar_data* p_data, unsigned int flags, objpar_internal_u64* p_size, objpar_size_t* p_table_size)
+{
+    objpar_internal_u64 table_size;
+    objpar_internal_u64 size;
+
+    *p_size = 0;
+    *p_table_size = 0;
+    if (!(flags & (OBJPAR_MESH_GENERATE_NORMALS | OBJPAR_MESH_GENERATE_TANGENTS)))
+        return 1;
+
+    /* Both tables are kept half empty like the vertex table. Generated
+       normals are numbered after the normals of the file in the vertex
+       keys, so both have to fit in 32 bits. */
+    if (p_data->corner_count >= 0x40000000u ||
+        (p_data->normal_count > 0 && p_data->normal_width > 4))
+    {
+        return 0;
+    }
+    table_size = 16;
+    while (table_size < (objpar_internal_u64)p_data->corner_count * 2)
+        table_size *= 2;
+    if ((objpar_internal_u64)p_data->normal_count + 1 + table_size >= OBJPAR_NONE)
+        return 0;
+
+    /* Slot of every corner, keys and x, y, z */
+    size = (objpar_internal_u64)p_data->corner_count * sizeof(unsigned int) + table_size * 4 * sizeof(unsigned int) + table_size * 3 * sizeof(float);
+    if (flags & OBJPAR_MESH_GENERATE_TANGENTS)
+    {
+        /* Same for tangents, with the bitangent x, y, z after them */
+        size += (objpar_internal_u64)p_data->corner_count * sizeof(unsigned int) + table_size * 4 * sizeof(unsigned int) + table_size * 6 * sizeof(float);
+    }
+    *p_size = size;
+    *p_table_size = (objpar_size_t)table_size;
+    return 1;
+}
+
+void objpar_internal_mesh_gen_layout(const struct objpar_data* p_data, unsigned int flags, objpar_size_t table_size, void* p_buffer, struct objpar_internal_mesh_gen* p_gen)
+{
+    char* p_next;
+
+    memset(p_gen, 0, sizeof(struct objpar_internal_mesh_gen));
+    p_gen->table_size = table_size;
+    p_gen->table_mask = (unsigned int)(table_size - 1);
+    p_gen->normal_width = (p_data->normal_count > 0 ? p_data->normal_width : 3);
+    if (table_size == 0)
+        return;
+
+    p_next = (char*)p_buffer;
+    p_gen->p_corner_normals = (unsigned int*)p_next;
+    p_next += (objpar_size_t)p_data->corner_count * sizeof(unsigned int);
+    p_gen->p_normal_keys = (unsigned int*)p_next;
+    p_next += table_size * 4 * sizeof(unsigned int);
+    p_gen->p_normals = (float*)p_next;
+    p_next += table_size * 3 * sizeof(float);
+    if (flags & OBJPAR_MESH_GENERATE_TANGENTS)
+    {
+        p_gen->p_corner_tangents = (unsigned int*)p_next;
+        p_next += (objpar_size_t)p_data->corner_count * sizeof(unsigned int);
+        p_gen->p_tangent_keys = (unsigned int*)p_next;
+        p_next += table_size * 4 * sizeof(unsigned int);
+        p_gen->p_tangents = (float*)p_next;
+    }
+}
+
+void objpar_internal_mesh_generate(const struct objpar_data* p_data, const struct objpar_group* p_groups, unsigned int group_count, unsigned int flags, unsigned int* p_scratch, struct objpar_internal_mesh_gen* p_gen)
+{
+    const unsigned int* p_faces;
+    objpar_size_t table_size;
+    float* p_nx;
+    float* p_ny;
+    float* p_nz;
+    float* p_tx;
+    float* p_ty;
+    float* p_tz;
+    float* p_bx;
+    float* p_by;
+    float* p_bz;
+    unsigned int smoothing_used;
+    unsigned int group;
+    unsigned int face;
+    unsigned int index;
+    objpar_size_t slot;
+
+    p_faces = p_data->p_faces;
+    table_size = p_gen->table_size;
+    p_nx = p_gen->p_normals;
+    p_ny = p_nx + table_size;
+    p_nz = p_ny + table_size;
+    memset(p_gen->p_corner_normals, 0xFF, (objpar_size_t)p_data->corner_count * sizeof(unsigned int));
+    memset(p_gen->p_normal_keys, 0xFF, table_size * 4 * sizeof(unsigned int));
+    memset(p_gen->p_normals, 0, table_size * 3 * sizeof(float));
+
+    /* A file without any s record is smoothed as a whole, otherwise faces
+       with smoothing off keep their own flat normals. */
+    smoothing_used = 0;
+    for (group = 0; group < group_count; ++group)
+    {
+        if (p_groups[group].smoothing != 0)
+            smoothing_used = 1;
+    }
+
+    /* Every corner without a normal in the file adds the normal of its face
+       to the slot of its position and smoothing group, weighted by the
+       corner angle. The face normal comes from Newell's method, its length
+       is twice the face area so larger faces weigh more. */
+    for (group = 0; group < group_count; ++group)
+    {
+        for (face = p_groups[group].face_begin; face < p_groups[group].face_begin + p_groups[group].face_count; ++face)
+        {
+            const unsigned int* p_face;
+            objpar_size_t first;
+            unsigned int face_width;
+            unsigned int key[3];
+            float normal[3];
+
+            first = p_data->p_face_offsets[face];
+            face_width = p_data->p_face_offsets[face + 1] - p_data->p_face_offsets[face];
+            p_face = &p_faces[first * 3];
+            if (face_width < 3)
+                continue;
+
+            normal[0] = 0.0f;
+            normal[1] = 0.0f;
+            normal[2] = 0.0f;
+            for (index = 0; index < face_width; ++index)
+            {
+                float a[3];
+                float b[3];
+
+                objpar_internal_mesh_position(p_data, p_face[index * 3 + OBJPAR_V_IDX], a);
+                objpar_internal_mesh_position(p_data, p_face[((index + 1) % face_width) * 3 + OBJPAR_V_IDX], b);
+                normal[0] += (a[1] - b[1]) * (a[2] + b[2]);
+                normal[1] += (a[2] - b[2]) * (a[0] + b[0]);
+                normal[2] += (a[0] - b[0]) * (a[1] + b[1]);
+            }
+
+            key[1] = (smoothing_used ? p_groups[group].smoothing : 0);
+            key[2] = (smoothing_used && p_groups[group].smoothing == 0 ? face : OBJPAR_NONE);
+            for (index = 0; index < face_width; ++index)
+            {
+                const unsigned int* p_corner = &p_face[index * 3];
+                float prev[3];
+                float curr[3];
+                float next[3];
+                float weight;
+
+                if (p_corner[OBJPAR_VN_IDX] > 0 && p_corner[OBJPAR_VN_IDX] <= p_data->normal_count)
+                    continue;
+
+                key[0] = p_corner[OBJPAR_V_IDX];
+                slot = objpar_internal_mesh_gen_slot(p_gen->p_normal_keys, p_gen->table_mask, key);
+                p_gen->p_corner_normals[first + index] = (unsigned int)slot;
+
+                objpar_internal_mesh_position(p_data, p_face[((index + face_width - 1) % face_width) * 3 + OBJPAR_V_IDX], prev);
+                objpar_internal_mesh_position(p_data, p_corner[OBJPAR_V_IDX], curr);
+                objpar_internal_mesh_position(p_data, p_face[((index + 1) % face_width) * 3 + OBJPAR_V_IDX], next);
+                weight = objpar_internal_angle(prev, curr, next);
+                p_nx[slot] += normal[0] * weight;
+                p_ny[slot] += normal[1] * weight;
+                p_nz[slot] += normal[2] * weight;
+            }
+        }
+    }
+    objpar_internal_normalize(p_nx, p_ny, p_nz, table_size);
+
+    if (!(flags & OBJPAR_MESH_GENERATE_TANGENTS))
+        return;
+
+    p_tx = p_gen->p_tangents;
+    p_ty = p_tx + table_size;
+    p_tz = p_ty + table_size;
+    p_bx = p_tz + table_size;
+    p_by = p_bx + table_size;
+    p_bz = p_by + table_size;
+    memset(p_gen->p_corner_tangents, 0xFF, (objpar_size_t)p_data->corner_count * sizeof(unsigned int));
+    memset(p_gen->p_tangent_keys, 0xFF, table_size * 4 * sizeof(unsigned int));
+    memset(p_gen->p_tangents, 0, table_size * 6 * sizeof(float));
+
+    /* Tangents follow MikkTSpace: the tangent and bitangent of each
+       triangle are projected on the plane of the vertex normal, normalized
+       and added to the vertex weighted by the corner angle. Triangles are
+       the ones the mesh is built with. */
+    for (group = 0; group < group_count; ++group)
+    {
+        for (face = p_groups[group].face_begin; face < p_groups[group].face_begin + p_groups[group].face_count; ++face)
+        {
+            const unsigned int* p_face;
+            objpar_size_t first;
+            unsigned int face_width;
+            unsigned int triangle_count;
+            unsigned int triangle;
+
+            first = p_data->p_face_offsets[face];
+            face_width = p_data->p_face_offsets[face + 1] - p_data->p_face_offsets[face];
+            p_face = &p_faces[first * 3];
+            if (face_width < 3)
+                continue;
+
+            for (index = 0; index < face_width; ++index)
+            {
+                unsigned int key[3];
+
+                objpar_internal_mesh_gen_key(p_data, p_gen, &p_face[index * 3], first + index, key);
+                p_gen->p_corner_tangents[first + index] = objpar_internal_mesh_gen_slot(p_gen->p_tangent_keys, p_gen->table_mask, key);
+            }
+
+            triangle_count = objpar_internal_triangulate(p_data, p_face, face_width, flags, p_scratch);
+            for (triangle = 0; triangle < triangle_count; ++triangle)
+            {
+                float positions[3][3];
+                float texcoords[3][2];
+                float tangent[3];
+                float bitangent[3];
+                float area;
+                unsigned int k;
+                unsigned int j;
+
+                for (k = 0; k < 3; ++k)
+                {
+                    const unsigned int* p_corner = &p_face[p_scratch[triangle * 3 + k] * 3];
+                    unsigned int texcoord = p_corner[OBJPAR_VT_IDX];
+
+                    objpar_internal_mesh_position(p_data, p_corner[OBJPAR_V_IDX], positions[k]);
+                    texcoords[k][0] = 0.0f;
+                    texcoords[k][1] = 0.0f;
+                    if (texcoord > 0 && texcoord <= p_data->texcoord_count)
+                    {
+                        const float* p_source = &p_data->p_texcoords[(objpar_size_t)(texcoord - 1) * p_data->texcoord_width];
+                        texcoords[k][0] = p_source[0];
+                        if (p_data->texcoord_width > 1)
+                            texcoords[k][1] = p_source[1];
+                    }
+                }
+
+                /* Without a texcoord gradient there is nothing to add, those
+                   vertices fall back to an arbitrary tangent. */
+                area = (texcoords[1][0] - texcoords[0][0]) * (texcoords[2][1] - texcoords[0][1]) -
+                    (texcoords[2][0] - texcoords[0][0]) * (texcoords[1][1] - texcoords[0][1]);
+                if (area == 0.0f)
+                    continue;
+
+                for (j = 0; j < 3; ++j)
+                {
+                    float edge1 = positions[1][j] - positions[0][j];
+                    float edge2 = positions[2][j] - positions[0][j];
+                    tangent[j] = (edge1 * (texcoords[2][1] - texcoords[0][1]) - edge2 * (texcoords[1][1] - texcoords[0][1])) / area;
+                    bitangent[j] = (edge2 * (texcoords[1][0] - texcoords[0][0]) - edge1 * (texcoords[2][0] - texcoords[0][0])) / area;
+                }
+
+                for (k = 0; k < 3; ++k)
+                {
+                    float normal[3];
+                    float projected_tangent[3];
+                    float projected_bitangent[3];
+                    float tangent_dot;
+                    float bitangent_dot;
+                    float tangent_length;
+                    float bitangent_length;
+                    float weight;
+
+                    slot = p_gen->p_corner_tangents[first + p_scratch[triangle * 3 + k]];
+                    objpar_internal_mesh_gen_normal(p_data, p_gen, p_gen->p_tangent_keys[slot * 4 + 2], normal);
+
+                    tangent_dot = normal[0] * tangent[0] + normal[1] * tangent[1] + normal[2] * tangent[2];
+                    bitangent_dot = normal[0] * bitangent[0] + normal[1] * bitangent[1] + normal[2] * bitangent[2];
+                    for (j = 0; j < 3; ++j)
+                    {
+                        projected_tangent[j] = tangent[j] - normal[j] * tangent_dot;
+                        projected_bitangent[j] = bitangent[j] - normal[j] * bitangent_dot;
+                    }
+                    tangent_length = objpar_internal_sqrt(projected_tangent[0] * projected_tangent[0] + projected_tangent[1] * projected_tangent[1] + projected_tangent[2] * projected_tangent[2]);
+                    bitangent_length = objpar_internal_sqrt(projected_bitangent[0] * projected_bitangent[0] + projected_bitangent[1] * projected_bitangent[1] + projected_bitangent[2] * projected_bitangent[2]);
+                    if (tangent_length <= 0.0f || bitangent_length <= 0.0f)
+                        continue;
+
+                    weight = objpar_internal_angle(positions[(k + 2) % 3], positions[k], positions[(k + 1) % 3]);
+                    p_tx[slot] += projected_tangent[0] * (weight / tangent_length);
+                    p_ty[slot] += projected_tangent[1] * (weight / tangent_length);
+                    p_tz[slot] += projected_tangent[2] * (weight / tangent_length);
+                    p_bx[slot] += projected_bitangent[0] * (weight / bitangent_length);
+                    p_by[slot] += projected_bitangent[1] * (weight / bitangent_length);
+                    p_bz[slot] += projected_bitangent[2] * (weight / bitangent_length);
                 }
+            }
+        }
+    }
+    objpar_internal_normalize(p_tx, p_ty, p_tz, table_size);
+
+    /* The bitangent is only kept as the sign of w, which replaces its x */
+    for (slot = 0; slot < table_size; ++slot)
+    {
+        float normal[3];
+        float cross[3];
+
+        if (p_gen->p_tangent_keys[slot * 4 + 3] == OBJPAR_NONE)
+            continue;
+
+        objpar_internal_mesh_gen_normal(p_data, p_gen, p_gen->p_tangent_keys[slot * 4 + 2], normal);
+        if (p_tx[slot] == 0.0f && p_ty[slot] == 0.0f && p_tz[slot] == 0.0f)
+        {
+            /* Any direction on the tangent plane, from the axis that is
+               least parallel to the normal. */
+            float axis[3];
+            float length;
+
+            axis[0] = 0.0f;
+            axis[1] = 0.0f;
+            axis[2] = 0.0f;
+            if (OBJPAR_ABS(normal[0]) <= OBJPAR_ABS(normal[1]) && OBJPAR_ABS(normal[0]) <= OBJPAR_ABS(normal[2]))
+                axis[0] = 1.0f;
+            else if (OBJPAR_ABS(normal[1]) <= OBJPAR_ABS(normal[2]))
+                axis[1] = 1.0f;
+            else
+                axis[2] = 1.0f;
+            cross[0] = normal[1] * axis[2] - normal[2] * axis[1];
+            cross[1] = normal[2] * axis[0] - normal[0] * axis[2];
+            cross[2] = normal[0] * axis[1] - normal[1] * axis[0];
+            length = objpar_internal_sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+            if (length <= 0.0f)
+            {
+                cross[0] = 1.0f;
+                length = 1.0f;
+            }
+            p_tx[slot] = cross[0] / length;
+            p_ty[slot] = cross[1] / length;
+            p_tz[slot] = cross[2] / length;
+        }
+
+        cross[0] = normal[1] * p_tz[slot] - normal[2] * p_ty[slot];
+        cross[1] = normal[2] * p_tx[slot] - normal[0] * p_tz[slot];
+        cross[2] = normal[0] * p_ty[slot] - normal[1] * p_tx[slot];
+        p_bx[slot] = (cross[0] * p_bx[slot] + cross[1] * p_by[slot] + cross[2] * p_bz[slot] < 0.0f ? -1.0f : 1.0f);
+    }
+}
+
+unsigned int objpar_internal_mesh_gen_slot(unsigned int* p_keys, unsigned int mask, const unsigned int* p_key)
+{
+    unsigned int slot;
+
+    /* The fourth entry of a slot only marks it as used, any key value is
+       valid including OBJPAR_NONE. */
+    slot = objpar_internal_mesh_hash(p_key) & mask;
+    for (;;)
+    {
+        unsigned int* p_slot = &p_keys[(objpar_size_t)slot * 4];
 
-                p_current = (void*)(p_texcoord + texcoord_width);
+        if (p_slot[3] == OBJPAR_NONE)
+        {
+            p_slot[0] = p_key[0];
+            p_slot[1] = p_key[1];
+            p_slot[2] = p_key[2];
+            p_slot[3] = 0;
+            return slot;
+        }
+        if (p_slot[0] == p_key[0] &&
+            p_slot[1] == p_key[1] &&
+            p_slot[2] == p_key[2])
+        {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+void objpar_internal_mesh_gen_key(const struct objpar_data* p_data, const struct objpar_internal_mesh_gen* p_gen, const unsigned int* p_corner, objpar_size_t corner, unsigned int* p_key)
+{
+    unsigned int normal_slot = p_gen->p_corner_normals[corner];
+
+    p_key[OBJPAR_V_IDX] = p_corner[OBJPAR_V_IDX];
+    p_key[OBJPAR_VT_IDX] = p_corner[OBJPAR_VT_IDX];
+    p_key[OBJPAR_VN_IDX] = (normal_slot != OBJPAR_NONE ? p_data->normal_count + 1 + normal_slot : p_corner[OBJPAR_VN_IDX]);
+}
+
+void objpar_internal_mesh_gen_normal(const struct objpar_data* p_data, const struct objpar_internal_mesh_gen* p_gen, unsigned int normal, float* p_normal)
+{
+    unsigned int j;
+    float length;
+
+    /* Normal of a vertex key, generated ones come after the file normals */
+    if (normal > p_data->normal_count)
+    {
+        objpar_size_t slot = normal - p_data->normal_count - 1;
+        p_normal[0] = p_gen->p_normals[slot];
+        p_normal[1] = p_gen->p_normals[p_gen->table_size + slot];
+        p_normal[2] = p_gen->p_normals[p_gen->table_size * 2 + slot];
+        return;
+    }
+
+    p_normal[0] = 0.0f;
+    p_normal[1] = 0.0f;
+    p_normal[2] = 0.0f;
+    if (normal == 0)
+        return;
+    for (j = 0; j < p_data->normal_width && j < 3; ++j)
+    {
+        p_normal[j] = p_data->p_normals[(objpar_size_t)(normal - 1) * p_data->normal_width + j];
+    }
+    length = objpar_internal_sqrt(p_normal[0] * p_normal[0] + p_normal[1] * p_normal[1] + p_normal[2] * p_normal[2]);
+    if (length > 0.0f)
+    {
+        p_normal[0] /= length;
+        p_normal[1] /= length;
+        p_normal[2] /= length;
+    }
+}
+
+void objpar_internal_mesh_gen_vertex(const struct objpar_internal_mesh_gen* p_gen, const struct objpar_mesh* p_layout, objpar_size_t corner, unsigned int vertex)
+{
+    char* p_vertices = (char*)p_layout->p_vertices;
+    objpar_size_t table_size = p_gen->table_size;
+    unsigned int slot;
+    float vector[4];
+
+    slot = p_gen->p_corner_normals[corner];
+    if (slot != OBJPAR_NONE)
+    {
+        vector[0] = p_gen->p_normals[slot];
+        vector[1] = p_gen->p_normals[table_size + slot];
+        vector[2] = p_gen->p_normals[table_size * 2 + slot];
+        vector[3] = 0.0f;
+        objpar_internal_mesh_attribute(vector, 1, p_gen->normal_width, 1, p_layout->normal_format, 0.0f,
+            p_vertices + p_layout->normal_offset + (objpar_size_t)vertex * p_layout->normal_stride);
+    }
+
+    if (p_gen->p_corner_tangents != OBJPAR_NULL(unsigned int))
+    {
+        slot = p_gen->p_corner_tangents[corner];
+        vector[0] = p_gen->p_tangents[slot];
+        vector[1] = p_gen->p_tangents[table_size + slot];
+        vector[2] = p_gen->p_tangents[table_size * 2 + slot];
+        vector[3] = p_gen->p_tangents[table_size * 3 + slot];
+        objpar_internal_mesh_attribute(vector, 1, 4, 1, p_layout->tangent_format, 0.0f,
+            p_vertices + p_layout->tangent_offset + (objpar_size_t)vertex * p_layout->tangent_stride);
+    }
+}
+
+void objpar_internal_normalize(float* p_x, float* p_y, float* p_z, objpar_size_t count)
+{
+    objpar_size_t index;
+
+    /* Vectors are stored as separate x, y and z arrays so 4 of them are
+       normalized at once. Zero vectors are left as they are. */
+    index = 0;
+#if defined(OBJPAR_SSE2)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+
+        for (; index + 4 <= count; index += 4)
+        {
+            __m128 x = _mm_loadu_ps(p_x + index);
+            __m128 y = _mm_loadu_ps(p_y + index);
+            __m128 z = _mm_loadu_ps(p_z + index);
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+            __m128 scale = _mm_and_ps(_mm_div_ps(one, length), _mm_cmpgt_ps(length, zero));
+
+            _mm_storeu_ps(p_x + index, _mm_mul_ps(x, scale));
+            _mm_storeu_ps(p_y + index, _mm_mul_ps(y, scale));
+            _mm_storeu_ps(p_z + index, _mm_mul_ps(z, scale));
+        }
+    }
+#endif
+    for (; index < count; ++index)
+    {
+        float length = objpar_internal_sqrt(p_x[index] * p_x[index] + p_y[index] * p_y[index] + p_z[index] * p_z[index]);
+        float scale = (length > 0.0f ? 1.0f / length : 0.0f);
+
+        p_x[index] *= scale;
+        p_y[index] *= scale;
+        p_z[index] *= scale;
+    }
+}
+
+float objpar_internal_angle(const float* p_a, const float* p_b, const float* p_c)
+{
+    float u[3];
+    float v[3];
+    float length;
+    float cosine;
+    unsigned int j;
+
+    /* Angle at p_b of the triangle p_a, p_b, p_c */
+    for (j = 0; j < 3; ++j)
+    {
+        u[j] = p_a[j] - p_b[j];
+        v[j] = p_c[j] - p_b[j];
+    }
+    length = objpar_internal_sqrt((u[0] * u[0] + u[1] * u[1] + u[2] * u[2]) * (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]));
+    if (length <= 0.0f)
+        return 0.0f;
+
+    cosine = (u[0] * v[0] + u[1] * v[1] + u[2] * v[2]) / length;
+    if (cosine > 1.0f)
+        cosine = 1.0f;
+    if (cosine < -1.0f)
+        cosine = -1.0f;
+    return objpar_internal_acos(cosine);
+}
+
+float objpar_internal_sqrt(float value)
+{
+#if defined(objpar_sqrt)
+    return (float)objpar_sqrt(value);
+#elif defined(OBJPAR_SSE2)
+    return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(value)));
+#else
+    unsigned int bits;
+    float root;
+    unsigned int iteration;
+
+    if (!(value > 0.0f))
+        return 0.0f;
+
+    /* Halving the exponent bits is within 4% of the root, three Newton
+       steps bring it to full float precision. */
+    memcpy(&bits, &value, sizeof(bits));
+    bits = 0x1FBD1DF5u + (bits >> 1);
+    memcpy(&root, &bits, sizeof(root));
+    for (iteration = 0; iteration < 3; ++iteration)
+    {
+        root = 0.5f * (root + value / root);
+    }
+    return root;
+#endif
+}
+
+float objpar_internal_acos(float value)
+{
+#if defined(objpar_acos)
+    return (float)objpar_acos(value);
+#else
+    float magnitude;
+    float result;
+
+    /* Abramowitz and Stegun 4.4.46, the error is below 2e-8 */
+    magnitude = OBJPAR_ABS(value);
+    result = -0.0012624911f;
+    result = result * magnitude + 0.0066700901f;
+    result = result * magnitude - 0.0170881256f;
+    result = result * magnitude + 0.0308918810f;
+    result = result * magnitude - 0.0501743046f;
+    result = result * magnitude + 0.0889789874f;
+    result = result * magnitude - 0.2145988016f;
+    result = result * magnitude + 1.5707963050f;
+    result *= objpar_internal_sqrt(1.0f - magnitude);
+    return (value < 0.0f ? 3.14159265358979f - result : result);
+#endif
+}
+
+unsigned int objpar_internal_mesh_index(const struct objpar_mesh* p_mesh, objpar_size_t index)
+{
+    if (p_mesh->index_size == sizeof(unsigned short))
+        return ((const unsigned short*)p_mesh->p_indices)[index];
+    if (p_mesh->index_size == sizeof(unsigned int))
+        return ((const unsigned int*)p_mesh->p_indices)[index];
+    return (unsigned int)index;
+}
+
+void objpar_internal_mesh_set_index(struct objpar_mesh* p_mesh, objpar_size_t index, unsigned int vertex)
+{
+    if (p_mesh->index_size == sizeof(unsigned short))
+        ((unsigned short*)p_mesh->p_indices)[index] = (unsigned short)vertex;
+    else
+        ((unsigned int*)p_mesh->p_indices)[index] = vertex;
+}
+
+void objpar_internal_mesh_tipsify(struct objpar_mesh* p_mesh, struct objpar_internal_tipsify* p_state, unsigned int first, unsigned int count)
+{
+    unsigned int first_triangle;
+    unsigned int end_triangle;
+    unsigned int stack_size;
+    unsigned int order_size;
+    unsigned int cursor;
+    unsigned int fan;
+    unsigned int index;
+    unsigned int input_count;
+    unsigned int output_count;
+
+    /* Tipsify (Sander, Nehab and Barczak 2007). Triangles are emitted as
+       fans around one vertex at a time and the next fan is the vertex of
+       the last fan that stays in the cache the longest while it still has
+       triangles left, which runs in linear time unlike score based
+       methods. Only triangles of this range are emitted, p_live starts
+       and ends at 0 for every range. */
+    if (count == 0)
+        return;
+    for (index = first; index < first + count; ++index)
+    {
+        p_state->p_live[objpar_internal_mesh_index(p_mesh, index)] += 1;
+    }
+
+    first_triangle = first / 3;
+    end_triangle = (first + count) / 3;
+    stack_size = 0;
+    order_size = 0;
+    cursor = first;
+    fan = objpar_internal_mesh_index(p_mesh, first);
+    while (fan != OBJPAR_NONE)
+    {
+        unsigned int ring;
+        unsigned int best_priority;
+        unsigned int adjacent;
+
+        ring = stack_size;
+        for (adjacent = p_state->p_offsets[fan]; adjacent < p_state->p_offsets[fan + 1]; ++adjacent)
+        {
+            unsigned int triangle = p_state->p_adjacency[adjacent];
+            unsigned int corner;
+
+            if (triangle < first_triangle || triangle >= end_triangle || p_state->p_emitted[triangle])
+                continue;
+            p_state->p_emitted[triangle] = 1;
+            for (corner = 0; corner < 3; ++corner)
+            {
+                unsigned int vertex = objpar_internal_mesh_index(p_mesh, (objpar_size_t)triangle * 3 + corner);
+
+                p_state->p_order[order_size++] = vertex;
+                p_state->p_stack[stack_size++] = vertex;
+                p_state->p_live[vertex] -= 1;
+                if (p_state->time - p_state->p_stamps[vertex] > p_state->cache_size)
+                    p_state->p_stamps[vertex] = p_state->time++;
             }
-            if (normal_count > 0)
+        }
+
+        /* A vertex that would leave the cache before its remaining
+           triangles (2 new vertices each at most) are emitted gets
+           priority 0, otherwise older vertices come first. */
+        fan = OBJPAR_NONE;
+        best_priority = 0;
+        for (; ring < stack_size; ++ring)
+        {
+            unsigned int vertex = p_state->p_stack[ring];
+            unsigned int age = p_state->time - p_state->p_stamps[vertex];
+            unsigned int priority = 0;
+
+            if (p_state->p_live[vertex] == 0)
+                continue;
+            if ((objpar_internal_u64)age + 2 * (objpar_internal_u64)p_state->p_live[vertex] <= p_state->cache_size)
+                priority = age;
+            if (fan == OBJPAR_NONE || priority > best_priority)
             {
-                unsigned int idx;
-                unsigned int j;
-                float* p_normal = (float*)p_current;
+                fan = p_state->p_stack[ring];
+                best_priority = priority;
+            }
+        }
+
+        /* Dead end, go back to the most recently used vertex with
+           triangles left and then to the next one in input order. */
+        while (fan == OBJPAR_NONE && stack_size > 0)
+        {
+            stack_size -= 1;
+            if (p_state->p_live[p_state->p_stack[stack_size]] > 0)
+                fan = p_state->p_stack[stack_size];
+        }
+        while (fan == OBJPAR_NONE && cursor < first + count)
+        {
+            if (p_state->p_live[objpar_internal_mesh_index(p_mesh, cursor)] > 0)
+                fan = objpar_internal_mesh_index(p_mesh, cursor);
+            else
+                cursor += 1;
+        }
+    }
+
+    /* Meshes exported as strips or already optimized can use the cache
+       better than the new order, keep the input order for those. Stamps
+       are cleared before each run so both start from an empty cache. */
+    for (index = first; index < first + count; ++index)
+        p_state->p_stamps[objpar_internal_mesh_index(p_mesh, index)] = 0;
+    input_count = objpar_internal_mesh_transforms(p_mesh, OBJPAR_NULL(unsigned int), first, count, p_state->cache_size, p_state->p_stamps);
+    for (index = first; index < first + count; ++index)
+        p_state->p_stamps[objpar_internal_mesh_index(p_mesh, index)] = 0;
+    output_count = objpar_internal_mesh_transforms(p_mesh, p_state->p_order, first, count, p_state->cache_size, p_state->p_stamps);
+    if (output_count >= input_count)
+        return;
+
+    for (index = 0; index < order_size; ++index)
+    {
+        objpar_internal_mesh_set_index(p_mesh, (objpar_size_t)first + index, p_state->p_order[index]);
+    }
+}
+
+unsigned int objpar_internal_mesh_transforms(const struct objpar_mesh* p_mesh, const unsigned int* p_order, unsigned int first, unsigned int count, unsigned int cache_size, unsigned int* p_stamps)
+{
+    unsigned int transform_count;
+    unsigned int time;
+    unsigned int index;
+
+    /* A vertex is in the FIFO while less than cache_size vertices entered
+       it after the vertex did. p_order replaces the index buffer when set. */
+    transform_count = 0;
+    time = cache_size + 1;
+    for (index = 0; index < count; ++index)
+    {
+        unsigned int vertex = (p_order != OBJPAR_NULL(unsigned int) ? p_order[index] : objpar_internal_mesh_index(p_mesh, (objpar_size_t)first + index));
+
+        if (time - p_stamps[vertex] > cache_size)
+        {
+            p_stamps[vertex] = time++;
+            transform_count += 1;
+        }
+    }
+    return transform_count;
+}
+
+void objpar_internal_mesh_permute(char* p_vertices, const char* p_copy, int offset, unsigned int stride, const unsigned int* p_remap, unsigned int vertex_count)
+{
+    unsigned int vertex;
+
+    if (offset < 0)
+        return;
+    for (vertex = 0; vertex < vertex_count; ++vertex)
+    {
+        memcpy(p_vertices + offset + (objpar_size_t)p_remap[vertex] * stride, p_copy + offset + (objpar_size_t)vertex * stride, stride);
+    }
+}
+
+void objpar_internal_mesh_read_position(const struct objpar_mesh* p_mesh, unsigned int width, unsigned int vertex, float* p_position)
+{
+    const char* p_vertex;
+    unsigned int component;
+
+    p_vertex = (const char*)p_mesh->p_vertices + p_mesh->position_offset + (objpar_size_t)vertex * p_mesh->position_stride;
+    p_position[0] = 0.0f;
+    p_position[1] = 0.0f;
+    p_position[2] = 0.0f;
+    for (component = 0; component < width && component < 3; ++component)
+    {
+        if (p_mesh->position_format == OBJPAR_FORMAT_HALF)
+        {
+            unsigned short half;
+
+            memcpy(&half, p_vertex + component * sizeof(unsigned short), sizeof(unsigned short));
+            p_position[component] = objpar_internal_half_float(half);
+        }
+        else
+        {
+            memcpy(&p_position[component], p_vertex + component * sizeof(float), sizeof(float));
+        }
+    }
+}
+
+float objpar_internal_half_float(unsigned short value)
+{
+    unsigned int bits;
+    unsigned int exponent;
+    unsigned int mantissa;
+    float result;
+
+    bits = (unsigned int)(value & 0x8000) << 16;
+    exponent = (value >> 10) & 0x1F;
+    mantissa = value & 0x3FF;
+    if (exponent == 0x1F)
+    {
+        bits |= 0x7F800000 | (mantissa << 13);
+    }
+    else if (exponent != 0)
+    {
+        bits |= ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if (mantissa != 0)
+    {
+        /* Subnormal half, normalize into a float */
+        exponent = 113;
+        while (!(mantissa & 0x400))
+        {
+            mantissa <<= 1;
+            exponent -= 1;
+        }
+        bits |= (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+    memcpy(&result, &bits, sizeof(float));
+    return result;
+}
+
+void objpar_internal_meshlet_close(const struct objpar_mesh* p_mesh, unsigned int width, const struct objpar_meshlets* p_meshlets, struct objpar_meshlet* p_meshlet, unsigned int* p_local)
+{
+    const unsigned int* p_vertices;
+    const unsigned char* p_triangles;
+    float position[3];
+    float extremes[6][3];
+    float axis[3];
+    float radius_squared;
+    float min_dot;
+    float length;
+    unsigned int axis_index;
+    unsigned int vertex;
+    unsigned int triangle;
+
+    p_vertices = p_meshlets->p_vertices + p_meshlet->vertex_offset;
+    p_triangles = p_meshlets->p_triangles + p_meshlet->triangle_offset;
+    for (vertex = 0; vertex < p_meshlet->vertex_count; ++vertex)
+    {
+        p_local[p_vertices[vertex]] = OBJPAR_NONE;
+    }
+
+    /* Ritter's sphere. Start from the most distant pair of the points with
+       the smallest and largest x, y and z, then grow the sphere around
+       every point that falls outside. */
+    objpar_internal_mesh_read_position(p_mesh, width, p_vertices[0], position);
+    for (axis_index = 0; axis_index < 6; ++axis_index)
+    {
+        memcpy(extremes[axis_index], position, sizeof(position));
+    }
+    for (vertex = 1; vertex < p_meshlet->vertex_count; ++vertex)
+    {
+        objpar_internal_mesh_read_position(p_mesh, width, p_vertices[vertex], position);
+        for (axis_index = 0; axis_index < 3; ++axis_index)
+        {
+            if (position[axis_index] < extremes[axis_index * 2][axis_index])
+                memcpy(extremes[axis_index * 2], position, sizeof(position));
+            if (position[axis_index] > extremes[axis_index * 2 + 1][axis_index])
+                memcpy(extremes[axis_index * 2 + 1], position, sizeof(position));
+        }
+    }
+    radius_squared = -1.0f;
+    for (axis_index = 0; axis_index < 3; ++axis_index)
+    {
+        const float* p_min = extremes[axis_index * 2];
+        const float* p_max = extremes[axis_index * 2 + 1];
+        float distance_squared = (p_max[0] - p_min[0]) * (p_max[0] - p_min[0]) + (p_max[1] - p_min[1]) * (p_max[1] - p_min[1]) + (p_max[2] - p_min[2]) * (p_max[2] - p_min[2]);
+
+        if (distance_squared > radius_squared)
+        {
+            radius_squared = distance_squared;
+            p_meshlet->center[0] = (p_min[0] + p_max[0]) * 0.5f;
+            p_meshlet->center[1] = (p_min[1] + p_max[1]) * 0.5f;
+            p_meshlet->center[2] = (p_min[2] + p_max[2]) * 0.5f;
+        }
+    }
+    p_meshlet->radius = objpar_internal_sqrt(radius_squared) * 0.5f;
+    for (vertex = 0; vertex < p_meshlet->vertex_count; ++vertex)
+    {
+        float offset[3];
+        float distance;
+
+        objpar_internal_mesh_read_position(p_mesh, width, p_vertices[vertex], position);
+        offset[0] = position[0] - p_meshlet->center[0];
+        offset[1] = position[1] - p_meshlet->center[1];
+        offset[2] = position[2] - p_meshlet->center[2];
+        distance = objpar_internal_sqrt(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+        if (distance > p_meshlet->radius)
+        {
+            float shift = (distance - p_meshlet->radius) * 0.5f / distance;
+
+            p_meshlet->center[0] += offset[0] * shift;
+            p_meshlet->center[1] += offset[1] * shift;
+            p_meshlet->center[2] += offset[2] * shift;
+            p_meshlet->radius = (p_meshlet->radius + distance) * 0.5f;
+        }
+    }
+
+    /* The cone axis is the average of the unit face normals and its
+       spread the largest angle between the axis and a face normal.
+       Degenerate triangles don't face anywhere and are ignored. */
+    axis[0] = 0.0f;
+    axis[1] = 0.0f;
+    axis[2] = 0.0f;
+    for (triangle = 0; triangle < p_meshlet->triangle_count; ++triangle)
+    {
+        float normal[3];
+
+        objpar_internal_meshlet_normal(p_mesh, width, p_vertices, p_triangles + triangle * 3, normal);
+        axis[0] += normal[0];
+        axis[1] += normal[1];
+        axis[2] += normal[2];
+    }
+    length = objpar_internal_sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    p_meshlet->cone_cutoff = 1.0f;
+    p_meshlet->cone_axis[0] = 0.0f;
+    p_meshlet->cone_axis[1] = 0.0f;
+    p_meshlet->cone_axis[2] = 0.0f;
+    if (length <= 0.0f)
+        return;
+    p_meshlet->cone_axis[0] = axis[0] / length;
+    p_meshlet->cone_axis[1] = axis[1] / length;
+    p_meshlet->cone_axis[2] = axis[2] / length;
+
+    min_dot = 1.0f;
+    for (triangle = 0; triangle < p_meshlet->triangle_count; ++triangle)
+    {
+        float normal[3];
+        float dot;
+
+        if (!objpar_internal_meshlet_normal(p_mesh, width, p_vertices, p_triangles + triangle * 3, normal))
+            continue;
+        dot = normal[0] * p_meshlet->cone_axis[0] + normal[1] * p_meshlet->cone_axis[1] + normal[2] * p_meshlet->cone_axis[2];
+        if (dot < min_dot)
+            min_dot = dot;
+    }
+
+    /* cone_cutoff is the sine of the spread, so the test stays a single
+       dot product. Cones wider than a hemisphere can't be culled. */
+    if (min_dot > 0.0f)
+        p_meshlet->cone_cutoff = objpar_internal_sqrt(1.0f - min_dot * min_dot);
+}
+
+unsigned int objpar_internal_meshlet_normal(const struct objpar_mesh* p_mesh, unsigned int width, const unsigned int* p_vertices, const unsigned char* p_triangle, float* p_normal)
+{
+    float a[3];
+    float b[3];
+    float c[3];
+    float length;
+
+    objpar_internal_mesh_read_position(p_mesh, width, p_vertices[p_triangle[0]], a);
+    objpar_internal_mesh_read_position(p_mesh, width, p_vertices[p_triangle[1]], b);
+    objpar_internal_mesh_read_position(p_mesh, width, p_vertices[p_triangle[2]], c);
+    b[0] -= a[0];
+    b[1] -= a[1];
+    b[2] -= a[2];
+    c[0] -= a[0];
+    c[1] -= a[1];
+    c[2] -= a[2];
+    p_normal[0] = b[1] * c[2] - b[2] * c[1];
+    p_normal[1] = b[2] * c[0] - b[0] * c[2];
+    p_normal[2] = b[0] * c[1] - b[1] * c[0];
+    length = objpar_internal_sqrt(p_normal[0] * p_normal[0] + p_normal[1] * p_normal[1] + p_normal[2] * p_normal[2]);
+    if (length <= 0.0f)
+    {
+        p_normal[0] = 0.0f;
+        p_normal[1] = 0.0f;
+        p_normal[2] = 0.0f;
+        return 0;
+    }
+    p_normal[0] /= length;
+    p_normal[1] /= length;
+    p_normal[2] /= length;
+    return 1;
+}
+
+void* objpar_internal_visit_alloc(struct objpar_internal_visit* p_state, objpar_size_t size)
+{
+    void* p_memory;
+
+    p_memory = objpar_malloc(size > 0 ? size : 1);
+    if (p_memory == OBJPAR_NULL(void))
+        p_state->failed = 1;
+    return p_memory;
+}
+
+unsigned int objpar_internal_visit_faces(struct objpar_internal_visit* p_state, unsigned int batch_size, unsigned int corner_count)
+{
+    unsigned int corner_capacity;
+
+    /* The face batch holds batch_size faces of up to 4 corners. It only
+       grows when a single face doesn't fit in an empty batch. */
+    corner_capacity = batch_size * 4;
+    if (corner_capacity < corner_count)
+        corner_capacity = corner_count;
+
+    if (p_state->p_faces != OBJPAR_NULL(unsigned int) && corner_capacity <= p_state->corner_capacity)
+        return 1;
+
+    if (p_state->p_faces != OBJPAR_NULL(unsigned int))
+        objpar_free(p_state->p_faces);
 
-                idx = (p_faces[index + OBJPAR_VN_IDX] - 1) * normal_width;
+    /* Offsets follow the corners in the same allocation */
+    p_state->p_faces = (unsigned int*)objpar_internal_visit_alloc(p_state, sizeof(unsigned int) * (corner_capacity * 3 + batch_size + 1));
+    if (p_state->p_faces == OBJPAR_NULL(unsigned int))
+        return 0;
+
+    p_state->p_face_offsets = p_state->p_faces + corner_capacity * 3;
+    p_state->corner_capacity = corner_capacity;
+    return 1;
+}
+
+void objpar_internal_visit_flush(struct objpar_internal_visit* p_state)
+{
+    const struct objpar_visitor* p_visitor = p_state->p_visitor;
+
+    if (p_state->position_count > 0)
+        p_visitor->p_positions(p_visitor->p_user_data, p_state->p_positions, p_state->position_count, p_state->position_width);
+    if (p_state->normal_count > 0)
+        p_visitor->p_normals(p_visitor->p_user_data, p_state->p_normals, p_state->normal_count, p_state->normal_width);
+    if (p_state->texcoord_count > 0)
+        p_visitor->p_texcoords(p_visitor->p_user_data, p_state->p_texcoords, p_state->texcoord_count, p_state->texcoord_width);
+    if (p_state->face_count > 0)
+    {
+        p_state->p_face_offsets[p_state->face_count] = p_state->corner_count;
+        p_visitor->p_faces(p_visitor->p_user_data, p_state->p_faces, p_state->p_face_offsets, p_state->face_count);
+    }
+
+    p_state->position_count = 0;
+    p_state->normal_count = 0;
+    p_state->texcoord_count = 0;
+    p_state->face_count = 0;
+    p_state->corner_count = 0;
+}
+
+void objpar_internal_mtl_parse(const char* p_string, objpar_size_t string_size, struct objpar_mtl_data* p_cursor)
+{
+    struct objpar_material* p_material;
+    objpar_size_t index;
+
+    /* Without p_materials only material_count and names_size are added
+       up. Otherwise the materials and names are written at the cursor,
+       which is advanced past them. Statements before the first newmtl
+       have no material to go to and are skipped. */
+    p_material = OBJPAR_NULL(struct objpar_material);
+    index = 0;
+    while (index < string_size)
+    {
+        objpar_size_t line_end;
+        objpar_size_t name_end;
+        unsigned int slot;
+        unsigned int key;
+
+        line_end = objpar_internal_line_end(p_string, index, string_size);
+        key = objpar_internal_mtl_key(p_string, &index, line_end, &slot);
+
+        if (key == OBJPAR_INTERNAL_MTL_NEWMTL || key == OBJPAR_INTERNAL_MTL_MAP)
+        {
+            unsigned int name_size;
+
+            if (key == OBJPAR_INTERNAL_MTL_MAP)
+                index = objpar_internal_mtl_options(p_string, index, line_end);
+            name_end = line_end;
+            while (name_end > index && (p_string[name_end - 1] == ' ' || p_string[name_end - 1] == '\t' || p_string[name_end - 1] == '\r'))
+                name_end -= 1;
+            name_size = (unsigned int)(name_end - index) + 1;
+
+            if (p_cursor->p_materials == OBJPAR_NULL(struct objpar_material))
+            {
+                if (key == OBJPAR_INTERNAL_MTL_NEWMTL)
+                    p_cursor->material_count += 1;
+                p_cursor->names_size += name_size;
+                index = line_end + 1;
+                continue;
+            }
+
+            if (key == OBJPAR_INTERNAL_MTL_NEWMTL)
+            {
+                p_material = p_cursor->p_materials++;
+                memset(p_material, 0, sizeof(struct objpar_material));
+                p_material->dissolve = 1.0f;
+                p_material->ior = 1.0f;
+                for (slot = 0; slot < OBJPAR_MAP_COUNT; ++slot)
+                    p_material->maps[slot] = OBJPAR_NONE;
+                p_material->name = p_cursor->names_size;
+                p_cursor->material_count += 1;
+            }
+            else if (p_material != OBJPAR_NULL(struct objpar_material))
+            {
+                p_material->maps[slot] = p_cursor->names_size;
+            }
+
+            /* Maps before the first newmtl still take their bytes so the
+               names stay where the count pass put them. */
+            memcpy(p_cursor->p_names, p_string + index, name_size - 1);
+            p_cursor->p_names[name_size - 1] = 0;
+            p_cursor->p_names += name_size;
+            p_cursor->names_size += name_size;
+        }
+        else if (p_material != OBJPAR_NULL(struct objpar_material) && key != 0)
+        {
+            float values[3];
+            unsigned int value_count;
+            char c0;
 
-                for (j = 0; j < normal_width; ++j)
+            /* Options like "d -halo 0.5" come before the value */
+            c0 = (index < line_end ? p_string[index] : 0);
+            if (c0 == '-' && index + 1 < line_end && !(p_string[index + 1] >= '0' && p_string[index + 1] <= '9') && p_string[index + 1] != '.')
+            {
+                while (index < line_end && p_string[index] != ' ' && p_string[index] != '\t')
+                    index += 1;
+                while (index < line_end && (p_string[index] == ' ' || p_string[index] == '\t'))
+                    index += 1;
+            }
+
+            /* Colors given as a single value are grey, spectral and xyz
+               colors are not supported and leave the color untouched. */
+            value_count = 0;
+            while (value_count < 3 && index < line_end)
+            {
+                c0 = p_string[index];
+                if (c0 == ' ' || c0 == '\t' || c0 == '\r')
                 {
-                    p_normal[j] = p_normals[idx + j];
+                    index += 1;
+                    continue;
                 }
+                if (!((c0 >= '0' && c0 <= '9') || c0 == '-' || c0 == '+' || c0 == '.'))
+                    break;
+                values[value_count++] = objpar_internal_read_float(p_string, &index, line_end);
+            }
+
+            if (value_count > 0)
+            {
+                if (key == OBJPAR_INTERNAL_MTL_COLOR)
+                {
+                    float* p_color;
 
-                p_current = (void*)(p_normal + normal_width);
+                    p_color = (slot == 0 ? p_material->ambient : slot == 1 ? p_material->diffuse : slot == 2 ? p_material->specular : p_material->emissive);
+                    p_color[0] = values[0];
+                    p_color[1] = (value_count > 1 ? values[1] : values[0]);
+                    p_color[2] = (value_count > 2 ? values[2] : values[0]);
+                }
+                else if (key == OBJPAR_INTERNAL_MTL_NS)
+                    p_material->shininess = values[0];
+                else if (key == OBJPAR_INTERNAL_MTL_NI)
+                    p_material->ior = values[0];
+                else if (key == OBJPAR_INTERNAL_MTL_D)
+                    p_material->dissolve = values[0];
+                else if (key == OBJPAR_INTERNAL_MTL_TR)
+                    p_material->dissolve = 1.0f - values[0];
+                else if (key == OBJPAR_INTERNAL_MTL_ILLUM)
+                    p_material->illum = (unsigned int)values[0];
             }
         }
+        index = line_end + 1;
+    }
+}
+
+unsigned int objpar_internal_mtl_key(const char* p_string, objpar_size_t* p_index, objpar_size_t line_end, unsigned int* p_slot)
+{
+    static const char* const p_keywords[] = {
+        "newmtl", "Ka", "Kd", "Ks", "Ke", "Ns", "Ni", "d", "Tr", "illum",
+        "map_Ka", "map_Kd", "map_Ks", "map_Ns", "map_d", "map_Ke", "map_bump", "map_Bump", "bump", "disp"
+    };
+    static const unsigned char keys[] = {
+        OBJPAR_INTERNAL_MTL_NEWMTL, OBJPAR_INTERNAL_MTL_COLOR, OBJPAR_INTERNAL_MTL_COLOR, OBJPAR_INTERNAL_MTL_COLOR, OBJPAR_INTERNAL_MTL_COLOR,
+        OBJPAR_INTERNAL_MTL_NS, OBJPAR_INTERNAL_MTL_NI, OBJPAR_INTERNAL_MTL_D, OBJPAR_INTERNAL_MTL_TR, OBJPAR_INTERNAL_MTL_ILLUM,
+        OBJPAR_INTERNAL_MTL_MAP, OBJPAR_INTERNAL_MTL_MAP, OBJPAR_INTERNAL_MTL_MAP, OBJPAR_INTERNAL_MTL_MAP, OBJPAR_INTERNAL_MTL_MAP,
+        OBJPAR_INTERNAL_MTL_MAP, OBJPAR_INTERNAL_MTL_MAP, OBJPAR_INTERNAL_MTL_MAP, OBJPAR_INTERNAL_MTL_MAP, OBJPAR_INTERNAL_MTL_MAP
+    };
+    static const unsigned char slots[] = {
+        0, 0, 1, 2, 3, 0, 0, 0, 0, 0,
+        OBJPAR_MAP_AMBIENT, OBJPAR_MAP_DIFFUSE, OBJPAR_MAP_SPECULAR, OBJPAR_MAP_SHININESS, OBJPAR_MAP_DISSOLVE,
+        OBJPAR_MAP_EMISSIVE, OBJPAR_MAP_BUMP, OBJPAR_MAP_BUMP, OBJPAR_MAP_BUMP, OBJPAR_MAP_DISPLACEMENT
+    };
+    objpar_size_t index;
+    objpar_size_t keyword_end;
+    unsigned int keyword;
+
+    /* MTL statements are often indented */
+    index = *p_index;
+    while (index < line_end && (p_string[index] == ' ' || p_string[index] == '\t'))
+        index += 1;
+    keyword_end = index;
+    while (keyword_end < line_end && p_string[keyword_end] != ' ' && p_string[keyword_end] != '\t' && p_string[keyword_end] != '\r')
+        keyword_end += 1;
+
+    for (keyword = 0; keyword < sizeof(keys); ++keyword)
+    {
+        if (strlen(p_keywords[keyword]) == keyword_end - index &&
+            memcmp(p_keywords[keyword], p_string + index, keyword_end - index) == 0)
+        {
+            break;
+        }
+    }
+    if (keyword == sizeof(keys))
+        return 0;
+
+    while (keyword_end < line_end && (p_string[keyword_end] == ' ' || p_string[keyword_end] == '\t'))
+        keyword_end += 1;
+    *p_index = keyword_end;
+    *p_slot = slots[keyword];
+    return keys[keyword];
+}
+
+objpar_size_t objpar_internal_mtl_options(const char* p_string, objpar_size_t index, objpar_size_t line_end)
+{
+    /* Texture options come before the file name. Switches like -clamp on
+       take one word, the rest take up to 3 numbers. */
+    while (index + 1 < line_end && p_string[index] == '-')
+    {
+        objpar_size_t option_end;
+        unsigned int word_argument;
+        unsigned int argument_count;
+
+        option_end = index;
+        while (option_end < line_end && p_string[option_end] != ' ' && p_string[option_end] != '\t')
+            option_end += 1;
+        word_argument = ((option_end - index == 6 && memcmp(p_string + index, "-clamp", 6) == 0) ||
+                         (option_end - index == 7 && memcmp(p_string + index, "-blendu", 7) == 0) ||
+                         (option_end - index == 7 && memcmp(p_string + index, "-blendv", 7) == 0) ||
+                         (option_end - index == 8 && memcmp(p_string + index, "-imfchan", 8) == 0) ||
+                         (option_end - index == 5 && memcmp(p_string + index, "-type", 5) == 0) ||
+                         (option_end - index == 3 && memcmp(p_string + index, "-cc", 3) == 0));
+        index = option_end;
+
+        for (argument_count = 0; argument_count < (word_argument ? 1u : 3u); ++argument_count)
+        {
+            objpar_size_t argument_end;
+            char c0;
 
+            while (index < line_end && (p_string[index] == ' ' || p_string[index] == '\t'))
+                index += 1;
+            c0 = (index < line_end ? p_string[index] : 0);
+            if (!word_argument && !((c0 >= '0' && c0 <= '9') || c0 == '.' || c0 == '+' ||
+                (c0 == '-' && index + 1 < line_end && ((p_string[index + 1] >= '0' && p_string[index + 1] <= '9') || p_string[index + 1] == '.'))))
+            {
+                break;
+            }
+            argument_end = index;
+            while (argument_end < line_end && p_string[argument_end] != ' ' && p_string[argument_end] != '\t')
+                argument_end += 1;
+            index = argument_end;
+        }
+        while (index < line_end && (p_string[index] == ' ' || p_string[index] == '\t'))
+            index += 1;
     }
+    return index;
+}
 
-    return 1;
+unsigned int* objpar_internal_mtl_slot(const struct objpar_mtl_data* p_mtl, const char* p_name)
+{
+    /* Same table as the material names of objpar_data, name is the first
+       member of objpar_material and every member is 4 bytes */
+    return objpar_internal_name_slot(p_mtl->p_table, p_mtl->table_size, p_mtl->p_names, &p_mtl->p_materials->name,
+        sizeof(struct objpar_material) / sizeof(unsigned int), p_name);
 }
 
-unsigned int objpar_internal_v(const char* p_string, unsigned int* p_index, unsigned int string_size, float** pp_vbuff, unsigned int vertex_width)
+void objpar_internal_builder_init(struct objpar_internal_builder* p_builder, const struct objpar_allocator* p_allocator)
 {
-    char str[32];
-    unsigned int index;
-    unsigned int comp_count;
-    unsigned int str_size;
-    unsigned int i;
-    char c0;
-    char c1;
-    float* p_vertex;
+    memset(p_builder, 0, sizeof(struct objpar_internal_builder));
+    p_builder->p_allocator = p_allocator;
+}
 
-    index = *p_index;
-    c0 = p_string[index];
-    c1 = p_string[index + 1];
+void objpar_internal_builder_parse(struct objpar_internal_builder* p_builder, const char* p_string, objpar_size_t begin, objpar_size_t end)
+{
+    struct objpar_data* p_counts;
+    objpar_size_t index;
+    unsigned int face_comp_count;
 
-    if (c0 == 'v' && c1 == ' ')
+    p_counts = &p_builder->counts;
+    index = begin;
+    face_comp_count = 3;
+
+    /* The width of each vertex element is taken from the first record of
+       its kind. Every record after that is written with the same width, so
+       the output can be appended without knowing the counts in advance. */
+    while (index < end && !p_builder->failed)
     {
-        if (pp_vbuff == OBJPAR_NULL(float*))
-        {
-            unsigned int space_count = 0;
-            objpar_internal_newline(p_string, p_index, string_size, &space_count);
-            return space_count;
-        }
+        char c0;
+        char c1;
+        objpar_size_t probe;
 
-        p_vertex = *pp_vbuff;
-        comp_count = 0;
-        str_size = 0;
+        c0 = p_string[index];
+        c1 = (index + 1 < end ? p_string[index + 1] : 0);
+        probe = index;
 
-        index += 2;
-        for (i = 0; i < vertex_width; ++i)
+        if (c0 == 'v' && c1 == ' ')
         {
-            p_vertex[i] = 0.0f;
+            float* p_vertex;
+            if (p_builder->position_stride == 0)
+            {
+                p_builder->position_stride = objpar_internal_v(p_string, &probe, end, OBJPAR_NULL(float*), 0);
+                probe = index;
+            }
+            p_vertex = (float*)objpar_internal_arena_push(&p_builder->vertex_arena, p_builder->p_allocator, sizeof(float) * p_builder->position_stride);
+            if (p_vertex == OBJPAR_NULL(float))
+            {
+                p_builder->failed = 1;
+                break;
+            }
+            p_counts->position_width = objpar_internal_v(p_string, &index, end, &p_vertex, p_builder->position_stride);
+            if (p_counts->position_width > p_builder->position_stride)
+            {
+                if (!objpar_internal_arena_widen(&p_builder->vertex_arena, p_builder->p_allocator, &p_builder->position_stride, p_counts->position_width, sizeof(float)))
+                {
+                    p_builder->failed = 1;
+                    break;
+                }
+                p_vertex = (float*)objpar_internal_arena_last(&p_builder->vertex_arena, sizeof(float) * p_builder->position_stride);
+                objpar_internal_v(p_string, &probe, end, &p_vertex, p_builder->position_stride);
+            }
+            if (!objpar_internal_add(&p_counts->position_count, 1))
+            {
+                p_builder->failed = 1;
+                break;
+            }
         }
-        c0 = p_string[index];
-
-        while (c0 != '\n' && c0 != '\r')
+        else if (c0 == 'v' && c1 == 'n')
         {
-            while (c0 > 0x2C && c0 < 0x3A)
+            float* p_normal;
+            if (p_builder->normal_stride == 0)
             {
-                str[str_size++] = c0;
-                c0 = p_string[++index];
+                p_builder->normal_stride = objpar_internal_vn(p_string, &probe, end, OBJPAR_NULL(float*), 0);
+                probe = index;
             }
-            if (str_size > 0)
+            p_normal = (float*)objpar_internal_arena_push(&p_builder->normal_arena, p_builder->p_allocator, sizeof(float) * p_builder->normal_stride);
+            if (p_normal == OBJPAR_NULL(float))
             {
-                float comp;
-                str[str_size] = 0;
-                comp = objpar_atof(str); /* TODO: implement custom objpar_atof */
-                p_vertex[comp_count] = comp;
+                p_builder->failed = 1;
+                break;
+            }
+            p_counts->normal_width = objpar_internal_vn(p_string, &index, end, &p_normal, p_builder->normal_stride);
+            if (p_counts->normal_width > p_builder->normal_stride)
+            {
+                if (!objpar_internal_arena_widen(&p_builder->normal_arena, p_builder->p_allocator, &p_builder->normal_stride, p_counts->normal_width, sizeof(float)))
+                {
+                    p_builder->failed = 1;
+                    break;
+                }
+                p_normal = (float*)objpar_internal_arena_last(&p_builder->normal_arena, sizeof(float) * p_builder->normal_stride);
+                objpar_internal_vn(p_string, &probe, end, &p_normal, p_builder->normal_stride);
+            }
+            if (!objpar_internal_add(&p_counts->normal_count, 1))
+            {
+                p_builder->failed = 1;
+                break;
             }
-            comp_count += 1;
-            if (c0 != '\n')
-                c0 = p_string[++index];
-            str_size = 0;
         }
-        *pp_vbuff = p_vertex + vertex_width;
-        *p_index = index;
-        return 1;
-    }
-    return 0;
-}
-
-unsigned int objpar_internal_vn(const char* p_string, unsigned int* p_index, unsigned int string_size, float** pp_nbuff, unsigned int normal_width)
-{
-    char str[32];
-    unsigned int index;
-    unsigned int comp_count;
-    unsigned int str_size;
-    unsigned int i;
-    char c0;
-    char c1;
-    float* p_normal;
-
-    index = *p_index;
-    c0 = p_string[index];
-    c1 = p_string[index + 1];
-
-    if (c0 == 'v' && c1 == 'n')
-    {
-        if (pp_nbuff == OBJPAR_NULL(float*))
+        else if (c0 == 'v' && c1 == 't')
         {
-            unsigned int space_count = 0;
-            objpar_internal_newline(p_string, p_index, string_size, &space_count);
-            return space_count;
+            float* p_texcoord;
+            if (p_builder->texcoord_stride == 0)
+            {
+                p_builder->texcoord_stride = objpar_internal_vt(p_string, &probe, end, OBJPAR_NULL(float*), 0);
+                probe = index;
+            }
+            p_texcoord = (float*)objpar_internal_arena_push(&p_builder->texcoord_arena, p_builder->p_allocator, sizeof(float) * p_builder->texcoord_stride);
+            if (p_texcoord == OBJPAR_NULL(float))
+            {
+                p_builder->failed = 1;
+                break;
+            }
+            p_counts->texcoord_width = objpar_internal_vt(p_string, &index, end, &p_texcoord, p_builder->texcoord_stride);
+            if (p_counts->texcoord_width > p_builder->texcoord_stride)
+            {
+                if (!objpar_internal_arena_widen(&p_builder->texcoord_arena, p_builder->p_allocator, &p_builder->texcoord_stride, p_counts->texcoord_width, sizeof(float)))
+                {
+                    p_builder->failed = 1;
+                    break;
+                }
+                p_texcoord = (float*)objpar_internal_arena_last(&p_builder->texcoord_arena, sizeof(float) * p_builder->texcoord_stride);
+                objpar_internal_vt(p_string, &probe, end, &p_texcoord, p_builder->texcoord_stride);
+            }
+            if (!objpar_internal_add(&p_counts->texcoord_count, 1))
+            {
+                p_builder->failed = 1;
+                break;
+            }
         }
+        else if (c0 == 'f' && c1 == ' ')
+        {
+            unsigned int* p_face;
+            unsigned int* p_offset;
+            unsigned int first_corner;
+            unsigned int corner_count;
 
-        p_normal = *pp_nbuff;
-        comp_count = 0;
-        str_size = 0;
+            /* Faces are stored with their own number of corners. Room for
+               OBJPAR_FACE_CORNERS is pushed and the unused part given back,
+               only larger faces have their corners counted first. */
+            first_corner = p_counts->corner_count;
+            p_face = (unsigned int*)objpar_internal_arena_push(&p_builder->face_arena, p_builder->p_allocator, sizeof(unsigned int) * face_comp_count * OBJPAR_FACE_CORNERS);
+            p_offset = (unsigned int*)objpar_internal_arena_push(&p_builder->offset_arena, p_builder->p_allocator, sizeof(unsigned int));
+            if (p_face == OBJPAR_NULL(unsigned int) || p_offset == OBJPAR_NULL(unsigned int))
+            {
+                p_builder->failed = 1;
+                break;
+            }
+            if (objpar_internal_f(p_string, &index, end, &p_face, &p_offset, &p_counts->corner_count, OBJPAR_FACE_CORNERS, p_counts))
+            {
+                corner_count = p_counts->corner_count - first_corner;
+                objpar_internal_arena_pop(&p_builder->face_arena, sizeof(unsigned int) * face_comp_count * (OBJPAR_FACE_CORNERS - corner_count));
+            }
+            else
+            {
+                corner_count = objpar_internal_f(p_string, &probe, end, OBJPAR_NULL(unsigned int*), OBJPAR_NULL(unsigned int*), OBJPAR_NULL(unsigned int), 0, OBJPAR_NULL(struct objpar_data));
+                objpar_internal_arena_pop(&p_builder->face_arena, sizeof(unsigned int) * face_comp_count * OBJPAR_FACE_CORNERS);
+                p_face = (unsigned int*)objpar_internal_arena_push(&p_builder->face_arena, p_builder->p_allocator, sizeof(unsigned int) * face_comp_count * corner_count);
+                if (p_face == OBJPAR_NULL(unsigned int))
+                {
+                    p_builder->failed = 1;
+                    break;
+                }
+                objpar_internal_f(p_string, &index, end, &p_face, &p_offset, &p_counts->corner_count, corner_count, p_counts);
+            }
 
-        index += 3;
-        for (i = 0; i < normal_width; ++i)
-        {
-            p_normal[i] = 0.0f;
+            if (corner_count >= OBJPAR_NONE - first_corner || !objpar_internal_add(&p_counts->face_count, 1))
+            {
+                p_builder->failed = 1;
+                break;
+            }
+            if (p_counts->face_count == 1)
+                p_counts->face_width = corner_count;
+            else if (corner_count != p_counts->face_width)
+                p_builder->mixed_faces = 1;
         }
-        c0 = p_string[index];
-
-        while (c0 != '\n' && c0 != '\r')
+        else if (c0 == 'o' || c0 == 'g' || c0 == 's' || c0 == 'u' || c0 == 'm')
         {
-            while (c0 > 0x2C && c0 < 0x3A)
+            struct objpar_group* p_group;
+            char* p_name;
+            unsigned int name_size;
+            unsigned int kind;
+
+            name_size = 0;
+            kind = objpar_internal_g(p_string, &probe, end, OBJPAR_NULL(struct objpar_group*), OBJPAR_NULL(char*), &name_size, 0);
+            if (kind == 0)
             {
-                str[str_size++] = c0;
-                c0 = p_string[++index];
+                objpar_internal_newline(p_string, &index, end, OBJPAR_NULL(unsigned int));
+                continue;
             }
-            if (str_size > 0)
+
+            if (name_size >= OBJPAR_NONE - p_counts->names_size || !objpar_internal_add(&p_counts->group_count, 1))
             {
-                float comp;
-                str[str_size] = 0;
-                comp =  objpar_atof(str); /* TODO: implement custom objpar_atof */
-                p_normal[comp_count] = comp;
+                p_builder->failed = 1;
+                break;
             }
-            comp_count += 1;
-            if (c0 != '\n')
-                c0 = p_string[++index];
-            str_size = 0;
+            p_group = (struct objpar_group*)objpar_internal_arena_push(&p_builder->group_arena, p_builder->p_allocator, sizeof(struct objpar_group));
+            p_name = OBJPAR_NULL(char);
+            if (name_size > 0)
+                p_name = (char*)objpar_internal_arena_push(&p_builder->name_arena, p_builder->p_allocator, name_size);
+            if (p_group == OBJPAR_NULL(struct objpar_group) || (name_size > 0 && p_name == OBJPAR_NULL(char)))
+            {
+                p_builder->failed = 1;
+                break;
+            }
+            objpar_internal_g(p_string, &index, end, &p_group, &p_name, &p_counts->names_size, p_counts->face_count);
+            if (kind == OBJPAR_INTERNAL_MATERIAL)
+                p_counts->material_count += 1;
+            else if (kind == OBJPAR_INTERNAL_LIBRARY)
+                p_counts->library_count += 1;
         }
-        *pp_nbuff = p_normal + normal_width;
-        *p_index = index;
-        return 1;
+        else if (objpar_internal_comment(p_string, &index, end));
+        else objpar_internal_newline(p_string, &index, end, OBJPAR_NULL(unsigned int));
     }
-    return 0;
 }
 
-unsigned int objpar_internal_vt(const char* p_string, unsigned int* p_index, unsigned int string_size, float** pp_tbuff, unsigned int texcoord_width)
+void* objpar_internal_builder_finish(struct objpar_internal_builder* p_builder, struct objpar_data* p_data)
 {
-    char str[32];
-    unsigned int index;
-    unsigned int comp_count;
-    unsigned int str_size;
-    unsigned int i;
-    char c0;
-    char c1;
-    float* p_texcoord;
+    struct objpar_data* p_counts;
+    objpar_internal_u64 total_buffer_size;
+    objpar_size_t offset_buffer_size;
+    objpar_size_t group_buffer_size;
+    void* p_buffer;
+    void* p_curr_buffer;
 
-    index = *p_index;
-    c0 = p_string[index];
-    c1 = p_string[index + 1];
+    p_counts = &p_builder->counts;
+    p_buffer = OBJPAR_NULL(void);
+    offset_buffer_size = (p_counts->face_count > 0 ? p_builder->offset_arena.size + sizeof(unsigned int) : 0);
+    group_buffer_size = (p_counts->group_count > 0 || p_counts->face_count > 0 ? p_builder->group_arena.size + sizeof(struct objpar_group) : 0);
+    total_buffer_size = 0;
 
-    if (c0 == 'v' && c1 == 't')
+    /* The material name table would need more than 2^31 slots */
+    if (p_counts->material_count >= 0x40000000u)
     {
-        if (pp_tbuff == OBJPAR_NULL(float*))
-        {
-            unsigned int space_count = 0;
-            objpar_internal_newline(p_string, p_index, string_size, &space_count);
-            return space_count;
-        }
+        p_builder->failed = 1;
+    }
+    if (!p_builder->failed)
+    {
+        total_buffer_size = sizeof(float) * ((objpar_internal_u64)p_counts->position_count * p_counts->position_width +
+            (objpar_internal_u64)p_counts->normal_count * p_counts->normal_width + (objpar_internal_u64)p_counts->texcoord_count * p_counts->texcoord_width) +
+            p_builder->face_arena.size + offset_buffer_size + group_buffer_size +
+            sizeof(unsigned int) * ((objpar_internal_u64)p_counts->material_count + p_counts->library_count + objpar_internal_name_table_size(p_counts->material_count)) +
+            p_builder->name_arena.size;
+        if (total_buffer_size > (objpar_size_t)-1)
+            p_builder->failed = 1;
+    }
 
-        p_texcoord = *pp_tbuff;
-        comp_count = 0;
-        str_size = 0;
+    if (!p_builder->failed && total_buffer_size > 0)
+    {
+        p_buffer = objpar_internal_alloc(p_builder->p_allocator, (objpar_size_t)total_buffer_size);
+    }
 
-        index += 3;
-        for (i = 0; i < texcoord_width; ++i)
+    if (p_buffer != OBJPAR_NULL(void))
+    {
+        /* Compact the chunks into the same layout objpar uses. */
+        *p_data = p_builder->counts;
+        p_curr_buffer = p_buffer;
+        p_data->p_positions = p_data->position_count > 0 ? (float*)p_curr_buffer : OBJPAR_NULL(float);
+        p_curr_buffer = objpar_internal_arena_narrow(&p_builder->vertex_arena, p_curr_buffer, p_builder->position_stride, p_data->position_width, sizeof(float));
+        p_data->p_normals = p_data->normal_count > 0 ? (float*)p_curr_buffer : OBJPAR_NULL(float);
+        p_curr_buffer = objpar_internal_arena_narrow(&p_builder->normal_arena, p_curr_buffer, p_builder->normal_stride, p_data->normal_width, sizeof(float));
+        p_data->p_texcoords = p_data->texcoord_count > 0 ? (float*)p_curr_buffer : OBJPAR_NULL(float);
+        p_curr_buffer = objpar_internal_arena_narrow(&p_builder->texcoord_arena, p_curr_buffer, p_builder->texcoord_stride, p_data->texcoord_width, sizeof(float));
+        p_data->p_faces = p_data->face_count > 0 ? (unsigned int*)p_curr_buffer : OBJPAR_NULL(unsigned int);
+        p_curr_buffer = objpar_internal_arena_copy(&p_builder->face_arena, p_curr_buffer);
+        p_data->p_face_offsets = OBJPAR_NULL(unsigned int);
+        if (p_data->face_count > 0)
         {
-            p_texcoord[i] = 0.0f;
+            p_data->p_face_offsets = (unsigned int*)p_curr_buffer;
+            objpar_internal_arena_copy(&p_builder->offset_arena, p_curr_buffer);
+            p_data->p_face_offsets[p_data->face_count] = p_data->corner_count;
+            p_curr_buffer = (void*)((char*)p_curr_buffer + offset_buffer_size);
         }
-        c0 = p_string[index];
-
-        while (c0 != '\n' && c0 != '\r')
+        p_data->p_groups = OBJPAR_NULL(struct objpar_group);
+        if (group_buffer_size > 0)
         {
-            while (c0 > 0x2C && c0 < 0x3A)
-            {
-                str[str_size++] = c0;
-                c0 = p_string[++index];
-            }
-            if (str_size > 0)
-            {
-                float comp;
-                str[str_size] = 0;
-                comp = objpar_atof(str); /* TODO: implement custom objpar_atof */
-                p_texcoord[comp_count] = comp;
-            }
-            comp_count += 1;
-            if (c0 != '\n')
-                c0 = p_string[++index];
-            str_size = 0;
+            p_data->p_groups = (struct objpar_group*)p_curr_buffer;
+            objpar_internal_arena_copy(&p_builder->group_arena, p_curr_buffer);
+            p_curr_buffer = (void*)((char*)p_curr_buffer + group_buffer_size);
         }
-        *pp_tbuff = p_texcoord + texcoord_width;
-        *p_index = index;
-        return 1;
+        p_data->p_materials = p_data->material_count > 0 ? (unsigned int*)p_curr_buffer : OBJPAR_NULL(unsigned int);
+        p_curr_buffer = (void*)((unsigned int*)p_curr_buffer + p_data->material_count);
+        p_data->p_libraries = p_data->library_count > 0 ? (unsigned int*)p_curr_buffer : OBJPAR_NULL(unsigned int);
+        p_curr_buffer = (void*)((unsigned int*)p_curr_buffer + p_data->library_count + objpar_internal_name_table_size(p_data->material_count));
+        p_data->p_names = p_data->names_size > 0 ? (char*)p_curr_buffer : OBJPAR_NULL(char);
+        objpar_internal_arena_copy(&p_builder->name_arena, p_curr_buffer);
+        if (p_builder->mixed_faces)
+            p_data->face_width = 0;
+        objpar_internal_groups(p_data);
     }
-    return 0;
+    else
+    {
+        memset(p_data, 0, sizeof(struct objpar_data));
+    }
+
+    objpar_internal_arena_release(&p_builder->vertex_arena, p_builder->p_allocator);
+    objpar_internal_arena_release(&p_builder->normal_arena, p_builder->p_allocator);
+    objpar_internal_arena_release(&p_builder->texcoord_arena, p_builder->p_allocator);
+    objpar_internal_arena_release(&p_builder->face_arena, p_builder->p_allocator);
+    objpar_internal_arena_release(&p_builder->offset_arena, p_builder->p_allocator);
+    objpar_internal_arena_release(&p_builder->group_arena, p_builder->p_allocator);
+    objpar_internal_arena_release(&p_builder->name_arena, p_builder->p_allocator);
+    memset(&p_builder->counts, 0, sizeof(struct objpar_data));
+    p_builder->position_stride = 0;
+    p_builder->normal_stride = 0;
+    p_builder->texcoord_stride = 0;
+    p_builder->mixed_faces = 0;
+    p_builder->failed = 0;
+
+    return p_buffer;
 }
 
-unsigned int objpar_internal_f(const char* p_string, unsigned int* p_index, unsigned int string_size, unsigned int** pp_fbuff, unsigned int face_width)
+unsigned int objpar_internal_stream_carry(struct objpar_stream* p_stream, const char* p_string, objpar_size_t size)
 {
-    char str[32];
-    unsigned int index;
-    unsigned int comp_count;
-    unsigned int comp_offset;
-    unsigned int str_size;
-    unsigned int face_comp_count;
-    unsigned int i;
-    char c0;
-    char c1;
-    unsigned int* p_face;
+    if (size == 0)
+        return 1;
 
-    index = *p_index;
-    c0 = p_string[index];
-    c1 = p_string[index + 1];
-    face_comp_count = 3;
-    if (c0 == 'f' && c1 == ' ')
+    if (p_stream->line_size + size > p_stream->line_capacity)
     {
-        if (pp_fbuff == OBJPAR_NULL(unsigned int*))
+        objpar_size_t capacity;
+        char* p_line;
+
+        capacity = (p_stream->line_capacity > 0 ? p_stream->line_capacity : 256);
+        while (capacity < p_stream->line_size + size)
+            capacity *= 2;
+
+        p_line = (char*)objpar_internal_realloc(p_stream->builder.p_allocator, p_stream->p_line, p_stream->line_size, capacity);
+        if (p_line == OBJPAR_NULL(char))
         {
-            unsigned int space_count = 0;
-            objpar_internal_newline(p_string, p_index, string_size, &space_count);
-            if (space_count < 3)
-                space_count = 3;
-            return space_count;
+            p_stream->builder.failed = 1;
+            return 0;
         }
+        p_stream->p_line = p_line;
+        p_stream->line_capacity = capacity;
+    }
 
-        p_face = *pp_fbuff;
-        comp_count = 0;
-        comp_offset = 0;
-        str_size = 0;
+    memcpy(p_stream->p_line + p_stream->line_size, p_string, size);
+    p_stream->line_size += size;
+    return 1;
+}
 
-        index += 2;
+unsigned int objpar_internal_read_serial(const struct objpar_reader* p_reader, struct objpar_stream* p_stream, char* p_block)
+{
+    for (;;)
+    {
+        objpar_size_t size = p_reader->p_read(p_reader->p_user_data, p_block, OBJPAR_READ_BLOCK_SIZE);
+
+        if (size == 0)
+            return 1;
+        if (size > OBJPAR_READ_BLOCK_SIZE)
+            return 0;
+        if (!objpar_stream_feed(p_stream, p_block, size))
+            return 0;
+    }
+}
+
+void* objpar_internal_arena_push(struct objpar_internal_arena* p_arena, const struct objpar_allocator* p_allocator, unsigned int size)
+{
+    struct objpar_internal_chunk* p_chunk;
+    void* p_memory;
+
+    p_chunk = p_arena->p_last;
+
+    if (p_chunk == OBJPAR_NULL(struct objpar_internal_chunk) ||
+        p_chunk->size + size > p_chunk->capacity)
+    {
+        unsigned int capacity;
+
+        capacity = (p_chunk != OBJPAR_NULL(struct objpar_internal_chunk) ? p_chunk->capacity * 2 : OBJPAR_CHUNK_SIZE);
+        if (capacity > OBJPAR_MAX_CHUNK_SIZE)
+            capacity = OBJPAR_MAX_CHUNK_SIZE;
+        if (capacity < size)
+            capacity = size;
+
+        p_chunk = (struct objpar_internal_chunk*)objpar_internal_alloc(p_allocator, sizeof(struct objpar_internal_chunk) + capacity);
+        if (p_chunk == OBJPAR_NULL(struct objpar_internal_chunk))
+            return OBJPAR_NULL(void);
+
+        p_chunk->p_next = OBJPAR_NULL(struct objpar_internal_chunk);
+        p_chunk->size = 0;
+        p_chunk->capacity = capacity;
+
+        if (p_arena->p_last != OBJPAR_NULL(struct objpar_internal_chunk))
+            p_arena->p_last->p_next = p_chunk;
+        else
+            p_arena->p_first = p_chunk;
+        p_arena->p_last = p_chunk;
+    }
+
+    p_memory = (void*)((char*)(p_chunk + 1) + p_chunk->size);
+    p_chunk->size += size;
+    p_arena->size += size;
+    return p_memory;
+}
+
+void* objpar_internal_arena_copy(struct objpar_internal_arena* p_arena, void* p_buffer)
+{
+    struct objpar_internal_chunk* p_chunk;
+    char* p_curr;
+
+    p_curr = (char*)p_buffer;
+    for (p_chunk = p_arena->p_first; p_chunk != OBJPAR_NULL(struct objpar_internal_chunk); p_chunk = p_chunk->p_next)
+    {
+        memcpy(p_curr, (void*)(p_chunk + 1), p_chunk->size);
+        p_curr += p_chunk->size;
+    }
+    return (void*)p_curr;
+}
+
+void* objpar_internal_arena_narrow(struct objpar_internal_arena* p_arena, void* p_buffer, unsigned int stride, unsigned int width, unsigned int unit)
+{
+    struct objpar_internal_chunk* p_chunk;
+    char* p_curr;
+
+    if (stride == width)
+        return objpar_internal_arena_copy(p_arena, p_buffer);
+
+    /* Records never straddle chunks, so every chunk holds whole ones */
+    p_curr = (char*)p_buffer;
+    for (p_chunk = p_arena->p_first; p_chunk != OBJPAR_NULL(struct objpar_internal_chunk); p_chunk = p_chunk->p_next)
+    {
+        const char* p_record;
+        const char* p_end;
 
-        for (i = 0; i < face_width * face_comp_count; i += 3)
+        p_record = (const char*)(p_chunk + 1);
+        p_end = p_record + p_chunk->size;
+        for (; p_record < p_end; p_record += stride * unit)
         {
-            p_face[i + 0] = 0;
-            p_face[i + 1] = 0;
-            p_face[i + 2] = 0;
+            memcpy(p_curr, p_record, width * unit);
+            p_curr += width * unit;
         }
+    }
+    return (void*)p_curr;
+}
 
-        c0 = p_string[index];
-        while (c0 != '\n' && c0 != '\r')
+unsigned int objpar_internal_arena_widen(struct objpar_internal_arena* p_arena, const struct objpar_allocator* p_allocator, unsigned int* p_stride, unsigned int width, unsigned int unit)
+{
+    struct objpar_internal_arena widened;
+    struct objpar_internal_chunk* p_chunk;
+    unsigned int stride;
+
+    /* Records already stored had no values past their stride, padding
+       them with zeros is what objpar writes for them. Past 4 the stride
+       is doubled so growing widths copy the records a few times only. */
+    stride = (width < 4 ? 4 : width);
+    if (*p_stride >= 4 && stride < *p_stride * 2)
+        stride = *p_stride * 2;
+
+    memset(&widened, 0, sizeof(struct objpar_internal_arena));
+    for (p_chunk = p_arena->p_first; p_chunk != OBJPAR_NULL(struct objpar_internal_chunk); p_chunk = p_chunk->p_next)
+    {
+        const char* p_record;
+        const char* p_end;
+
+        p_record = (const char*)(p_chunk + 1);
+        p_end = p_record + p_chunk->size;
+        for (; p_record < p_end; p_record += *p_stride * unit)
         {
-            while (c0 > 0x2F && c0 < 0x3A)
-            {
-                str[str_size++] = c0;
-                c0 = p_string[++index];
-            }
-            if (str_size > 0)
-            {
-                str[str_size] = 0;
-                p_face[comp_count] = objpar_atoi(str);
-                str_size = str_size;
-            }
-            comp_count += 1;
-            if (c0 != '/' && comp_count % 3 != 0 && comp_count < face_width * face_comp_count)
+            char* p_widened = (char*)objpar_internal_arena_push(&widened, p_allocator, stride * unit);
+            if (p_widened == OBJPAR_NULL(char))
             {
-                comp_count += 2;
-                c0 = p_string[++index];
+                objpar_internal_arena_release(&widened, p_allocator);
+                return 0;
             }
-            else if (c0 != '\n')
-                c0 = p_string[++index];
-            str_size = 0;
+            memcpy(p_widened, p_record, *p_stride * unit);
+            memset(p_widened + *p_stride * unit, 0, (stride - *p_stride) * unit);
         }
-        *p_index = index;
-        *pp_fbuff = p_face + (face_width * face_comp_count);
-        return 1;
     }
-    return 0;
+    objpar_internal_arena_release(p_arena, p_allocator);
+    *p_arena = widened;
+    *p_stride = stride;
+    return 1;
 }
 
-unsigned int objpar_internal_comment(const char* p_string, unsigned int* p_index, unsigned int string_size)
+void* objpar_internal_arena_last(struct objpar_internal_arena* p_arena, unsigned int size)
 {
-    unsigned int index;
-    char c;
+    return (void*)((char*)(p_arena->p_last + 1) + p_arena->p_last->size - size);
+}
 
-    index = *p_index;
-    c = p_string[index];
+void objpar_internal_arena_pop(struct objpar_internal_arena* p_arena, unsigned int size)
+{
+    p_arena->p_last->size -= size;
+    p_arena->size -= size;
+}
 
-    if (c == '#')
+void objpar_internal_arena_release(struct objpar_internal_arena* p_arena, const struct objpar_allocator* p_allocator)
+{
+    struct objpar_internal_chunk* p_chunk;
+
+    p_chunk = p_arena->p_first;
+    while (p_chunk != OBJPAR_NULL(struct objpar_internal_chunk))
+    {
+        struct objpar_internal_chunk* p_next = p_chunk->p_next;
+        objpar_internal_free(p_allocator, p_chunk);
+        p_chunk = p_next;
+    }
+    p_arena->p_first = OBJPAR_NULL(struct objpar_internal_chunk);
+    p_arena->p_last = OBJPAR_NULL(struct objpar_internal_chunk);
+    p_arena->size = 0;
+}
+
+void* objpar_internal_alloc(const struct objpar_allocator* p_allocator, objpar_size_t size)
+{
+    if (p_allocator == OBJPAR_NULL(const struct objpar_allocator))
+        return objpar_malloc(size);
+    return p_allocator->p_alloc(p_allocator->p_user_data, size);
+}
+
+void* objpar_internal_realloc(const struct objpar_allocator* p_allocator, void* p_memory, objpar_size_t old_size, objpar_size_t new_size)
+{
+    void* p_new_memory;
+
+    if (p_allocator != OBJPAR_NULL(const struct objpar_allocator) && p_allocator->p_realloc != 0)
+        return p_allocator->p_realloc(p_allocator->p_user_data, p_memory, old_size, new_size);
+
+    /* The old block stays valid when the new one can't be allocated */
+    p_new_memory = objpar_internal_alloc(p_allocator, new_size);
+    if (p_new_memory != OBJPAR_NULL(void) && p_memory != OBJPAR_NULL(void))
+    {
+        memcpy(p_new_memory, p_memory, (old_size < new_size ? old_size : new_size));
+        objpar_internal_free(p_allocator, p_memory);
+    }
+    return p_new_memory;
+}
+
+void objpar_internal_free(const struct objpar_allocator* p_allocator, void* p_memory)
+{
+    if (p_allocator == OBJPAR_NULL(const struct objpar_allocator))
+        objpar_free(p_memory);
+    else if (p_allocator->p_free != 0)
+        p_allocator->p_free(p_allocator->p_user_data, p_memory);
+}
+
+void* objpar_internal_bump_alloc(void* p_user_data, objpar_size_t size)
+{
+    struct objpar_arena* p_arena;
+    struct objpar_internal_block* p_block;
+    objpar_size_t aligned_size;
+    void* p_memory;
+
+    p_arena = (struct objpar_arena*)p_user_data;
+    aligned_size = (size + OBJPAR_INTERNAL_ARENA_ALIGNMENT - 1) & ~(objpar_size_t)(OBJPAR_INTERNAL_ARENA_ALIGNMENT - 1);
+    if (aligned_size < size)
+        return OBJPAR_NULL(void);
+
+    /* Blocks after the current one are free since the last reset and are
+       used in order. One that is too small is skipped, so a large
+       allocation gets its own block and the others stay reusable. */
+    p_block = p_arena->p_current;
+    while (p_block != OBJPAR_NULL(struct objpar_internal_block) && p_block->capacity - p_block->size < aligned_size)
     {
-        while (c != '\n' && c != '\r')
+        p_block = p_block->p_next;
+        if (p_block != OBJPAR_NULL(struct objpar_internal_block))
+            p_block->size = 0;
+    }
+
+    if (p_block == OBJPAR_NULL(struct objpar_internal_block))
+    {
+        objpar_size_t capacity = (aligned_size > p_arena->block_size ? aligned_size : p_arena->block_size);
+
+        if (capacity > (objpar_size_t)-1 - sizeof(struct objpar_internal_block) - OBJPAR_INTERNAL_ARENA_ALIGNMENT)
+            return OBJPAR_NULL(void);
+        p_block = (struct objpar_internal_block*)objpar_malloc(sizeof(struct objpar_internal_block) + OBJPAR_INTERNAL_ARENA_ALIGNMENT + capacity);
+        if (p_block == OBJPAR_NULL(struct objpar_internal_block))
+            return OBJPAR_NULL(void);
+        p_block->size = 0;
+        p_block->capacity = capacity;
+
+        /* New blocks go after the current one so they are reused first */
+        if (p_arena->p_current != OBJPAR_NULL(struct objpar_internal_block))
         {
-            c = p_string[++index];
+            p_block->p_next = p_arena->p_current->p_next;
+            p_arena->p_current->p_next = p_block;
+        }
+        else
+        {
+            p_block->p_next = p_arena->p_first;
+            p_arena->p_first = p_block;
         }
-        *p_index = ++index;
-        return 1;
     }
-    return 0;
+
+    /* Block data starts at the first aligned address after the header */
+    p_memory = (void*)((char*)(p_block + 1) + ((OBJPAR_INTERNAL_ARENA_ALIGNMENT - sizeof(struct objpar_internal_block) % OBJPAR_INTERNAL_ARENA_ALIGNMENT) % OBJPAR_INTERNAL_ARENA_ALIGNMENT) + p_block->size);
+    p_block->size += aligned_size;
+    p_arena->p_current = p_block;
+    p_arena->p_last = p_memory;
+    return p_memory;
 }
 
-unsigned int objpar_internal_newline(const char* p_string, unsigned int* p_index, unsigned int string_size, unsigned int* p_space_count)
+void* objpar_internal_bump_realloc(void* p_user_data, void* p_memory, objpar_size_t old_size, objpar_size_t new_size)
 {
-    unsigned int index;
-    unsigned int space_count;
-    char c;
+    struct objpar_arena* p_arena;
+    struct objpar_internal_block* p_block;
+    void* p_new_memory;
+    objpar_size_t old_aligned_size;
+    objpar_size_t new_aligned_size;
 
-    space_count = 0;
-    index = *p_index;
-    c = p_string[index];
+    p_arena = (struct objpar_arena*)p_user_data;
+    p_block = p_arena->p_current;
+    old_aligned_size = (old_size + OBJPAR_INTERNAL_ARENA_ALIGNMENT - 1) & ~(objpar_size_t)(OBJPAR_INTERNAL_ARENA_ALIGNMENT - 1);
+    new_aligned_size = (new_size + OBJPAR_INTERNAL_ARENA_ALIGNMENT - 1) & ~(objpar_size_t)(OBJPAR_INTERNAL_ARENA_ALIGNMENT - 1);
 
-    while (c != '\n' && c != '\r')
+    /* The last allocation grows in place while its block has room */
+    if (p_memory != OBJPAR_NULL(void) && p_memory == p_arena->p_last && new_aligned_size >= new_size &&
+        p_block->size - old_aligned_size + new_aligned_size <= p_block->capacity)
     {
-        if (c == ' ' || c == '\t')
-            space_count += 1;
-        c = p_string[++index];
+        p_block->size = p_block->size - old_aligned_size + new_aligned_size;
+        return p_memory;
     }
-    *p_index = ++index;
-    if (p_space_count != OBJPAR_NULL(unsigned int))
-        *p_space_count = space_count;
-    
-    return 1;
+
+    p_new_memory = objpar_internal_bump_alloc(p_user_data, new_size);
+    if (p_new_memory != OBJPAR_NULL(void) && p_memory != OBJPAR_NULL(void))
+    {
+        memcpy(p_new_memory, p_memory, (old_size < new_size ? old_size : new_size));
+    }
+    return p_new_memory;
 }
 
 #if __cplusplus
@@ -0,0 +1,360 @@
+/**
+*
+*      Copyright  2000 Felipe Alfonso <felipe@voidptr.io>
+*      This work is free. You can redistribute it and/or modify it under the
+*      terms of the Do What The Fuck You Want To Public License, Version 2,
+*      as published by Sam Hocevar. See http://www.wtfpl.net/ for more details.
+*
+*
+* objpar.hpp
+* ==========
+*
+* C++11 front-end for objpar.h. The vertex layout is a type made of attributes,
+*
+* `typedef objpar_cpp::vertex<objpar_cpp::pos3, objpar_cpp::uv2, objpar_cpp::norm3> vertex_t;`
+*
+* and objpar_cpp::build_mesh<vertex_t>(data) copies every attribute with the width known at
+* compile time. The result is a move-only objpar_cpp::mesh that owns its vertices, indices and
+* submeshes and hands them out as spans (std::span with C++20).
+*
+* The mesh is built by objpar_build_mesh_ex with float attributes and then copied into the
+* vertex type, so walk order, submeshes, triangulation, generated normals and tangents and the
+* numbering of indexed vertices are the ones of the C API. OBJPAR_MESH_INDEXED,
+* OBJPAR_MESH_EAR_CLIP, OBJPAR_MESH_GENERATE_NORMALS and OBJPAR_MESH_GENERATE_TANGENTS are
+* passed through, tangents are read with a tan4 attribute. A typed vertex is interleaved, so
+* OBJPAR_MESH_DEINTERLEAVE throws std::invalid_argument. Indices are always 32 bit.
+* Attributes the mesh doesn't have are zero and narrower ones are padded with zeros, except
+* the w of a pos4 read from 3 component positions, which is 1.
+*
+* Memory comes from operator new, so allocation failures throw std::bad_alloc. The C mesh is
+* built into a temporary buffer that is released before build_mesh returns.
+*/
+
+
+#ifndef _OBJPAR_HPP_
+#define _OBJPAR_HPP_
+
+#include "objpar.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#include <span>
+#endif
+
+namespace objpar_cpp
+{
+
+namespace detail
+{
+
+/* Attributes of objpar_mesh an attribute of a vertex is copied from */
+enum stream
+{
+    position_stream,
+    texcoord_stream,
+    normal_stream,
+    tangent_stream
+};
+
+}
+
+/* Attributes of a vertex. stream is the attribute of the C mesh it reads
+   and width its number of floats. */
+template <unsigned int Width>
+struct pos
+{
+    static_assert(Width >= 1 && Width <= 4, "positions have 1 to 4 components");
+    static const unsigned int stream = detail::position_stream;
+    static const unsigned int width = Width;
+    float position[Width];
+    float* components() { return position; }
+};
+
+template <unsigned int Width>
+struct uv
+{
+    static_assert(Width >= 1 && Width <= 4, "texcoords have 1 to 4 components");
+    static const unsigned int stream = detail::texcoord_stream;
+    static const unsigned int width = Width;
+    float texcoord[Width];
+    float* components() { return texcoord; }
+};
+
+template <unsigned int Width>
+struct norm
+{
+    static_assert(Width >= 1 && Width <= 4, "normals have 1 to 4 components");
+    static const unsigned int stream = detail::normal_stream;
+    static const unsigned int width = Width;
+    float normal[Width];
+    float* components() { return normal; }
+};
+
+/* Only written with OBJPAR_MESH_GENERATE_TANGENTS, x, y, z and the
+   bitangent sign in w. */
+struct tan4
+{
+    static const unsigned int stream = detail::tangent_stream;
+    static const unsigned int width = 4;
+    float tangent[4];
+    float* components() { return tangent; }
+};
+
+typedef pos<3> pos3;
+typedef pos<4> pos4;
+typedef uv<2> uv2;
+typedef uv<3> uv3;
+typedef norm<3> norm3;
+
+/* The attributes in order and without padding, vertex<pos3, uv2, norm3>
+   has position, texcoord and normal members and is 32 bytes. */
+template <typename... Attributes>
+struct vertex : Attributes...
+{
+};
+
+/* Byte offset of attribute A in vertex V, for the input layout of a
+   graphics API. */
+template <typename V, typename A>
+std::size_t offset()
+{
+    V vertex;
+    return (std::size_t)(reinterpret_cast<const char*>(static_cast<const A*>(&vertex)) - reinterpret_cast<const char*>(&vertex));
+}
+
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+template <typename T>
+using span = std::span<T>;
+#else
+/* The part of std::span used by mesh */
+template <typename T>
+class span
+{
+public:
+    span() : p_data(nullptr), count(0) {}
+    span(T* p_data, std::size_t count) : p_data(p_data), count(count) {}
+
+    T* data() const { return p_data; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T* begin() const { return p_data; }
+    T* end() const { return p_data + count; }
+    T& operator[](std::size_t index) const { return p_data[index]; }
+
+private:
+    T* p_data;
+    std::size_t count;
+};
+#endif
+
+/* Mesh built by build_mesh. It owns its memory and can only be moved,
+   indices is empty unless the mesh was built with OBJPAR_MESH_INDEXED. */
+template <typename V>
+class mesh
+{
+public:
+    mesh() : vertex_count(0), index_count(0) {}
+    mesh(std::unique_ptr<V[]>&& vertices, std::size_t vertex_count, std::unique_ptr<unsigned int[]>&& indices, std::size_t index_count, std::vector<objpar_submesh>&& submeshes) :
+        vertex_array(std::move(vertices)), vertex_count(vertex_count), index_array(std::move(indices)), index_count(index_count), submesh_array(std::move(submeshes)) {}
+    mesh(mesh&& other) :
+        vertex_array(std::move(other.vertex_array)), vertex_count(other.vertex_count), index_array(std::move(other.index_array)), index_count(other.index_count), submesh_array(std::move(other.submesh_array))
+    {
+        other.vertex_count = 0;
+        other.index_count = 0;
+    }
+    mesh& operator=(mesh&& other)
+    {
+        vertex_array = std::move(other.vertex_array);
+        vertex_count = other.vertex_count;
+        index_array = std::move(other.index_array);
+        index_count = other.index_count;
+        submesh_array = std::move(other.submesh_array);
+        other.vertex_count = 0;
+        other.index_count = 0;
+        return *this;
+    }
+    mesh(const mesh&) = delete;
+    mesh& operator=(const mesh&) = delete;
+
+    span<V> vertices() { return span<V>(vertex_array.get(), vertex_count); }
+    span<const V> vertices() const { return span<const V>(vertex_array.get(), vertex_count); }
+    span<const unsigned int> indices() const { return span<const unsigned int>(index_array.get(), index_count); }
+    span<const objpar_submesh> submeshes() const { return span<const objpar_submesh>(submesh_array.data(), submesh_array.size()); }
+    bool empty() const { return vertex_count == 0; }
+
+private:
+    std::unique_ptr<V[]> vertex_array;
+    std::size_t vertex_count;
+    std::unique_ptr<unsigned int[]> index_array;
+    std::size_t index_count;
+    std::vector<objpar_submesh> submesh_array;
+};
+
+namespace detail
+{
+
+/* Float attribute of the C mesh an attribute reads, p_values is null when
+   the mesh doesn't have it. */
+struct source
+{
+    const char* p_values;
+    unsigned int width;
+};
+
+template <typename A>
+void init_source(const objpar_data& data, const objpar_mesh& c_mesh, source& attribute_source)
+{
+    int attribute_offset = c_mesh.position_offset;
+    unsigned int width = data.position_width;
+
+    if (A::stream == texcoord_stream)
+    {
+        attribute_offset = c_mesh.texcoord_offset;
+        width = data.texcoord_width;
+    }
+    else if (A::stream == normal_stream)
+    {
+        /* Generated normals have 3 components when the file has none */
+        attribute_offset = c_mesh.normal_offset;
+        width = (data.normal_count > 0 ? data.normal_width : 3);
+    }
+    else if (A::stream == tangent_stream)
+    {
+        attribute_offset = c_mesh.tangent_offset;
+        width = 4;
+    }
+
+    attribute_source.p_values = (attribute_offset >= 0 ? static_cast<const char*>(c_mesh.p_vertices) + attribute_offset : nullptr);
+    attribute_source.width = (attribute_offset >= 0 ? width : 0);
+}
+
+template <typename A>
+void copy_attribute(A& target, const source& attribute_source, std::size_t vertex_offset)
+{
+    float* p_target = target.components();
+
+    if (attribute_source.width >= A::width)
+    {
+        /* The common case, a constant width copy the compiler unrolls */
+        const float* p_value = reinterpret_cast<const float*>(attribute_source.p_values + vertex_offset);
+        for (unsigned int i = 0; i < A::width; ++i)
+            p_target[i] = p_value[i];
+    }
+    else
+    {
+        const float* p_value = (attribute_source.width > 0 ? reinterpret_cast<const float*>(attribute_source.p_values + vertex_offset) : nullptr);
+        for (unsigned int i = 0; i < A::width; ++i)
+            p_target[i] = (i < attribute_source.width ? p_value[i] : 0.0f);
+        if (A::stream == position_stream && A::width == 4 && attribute_source.width == 3)
+            p_target[3] = 1.0f;
+    }
+}
+
+/* Walks the attribute list at compile time, every copy is inlined with
+   its width as a constant. */
+template <typename V, typename... Attributes>
+struct attributes;
+
+template <typename V>
+struct attributes<V>
+{
+    static const unsigned int width = 0;
+    static void init(const objpar_data&, const objpar_mesh&, source*) {}
+    static void copy(V&, const source*, std::size_t) {}
+};
+
+template <typename V, typename A, typename... Rest>
+struct attributes<V, A, Rest...>
+{
+    static const unsigned int width = A::width + attributes<V, Rest...>::width;
+
+    static void init(const objpar_data& data, const objpar_mesh& c_mesh, source* p_sources)
+    {
+        init_source<A>(data, c_mesh, *p_sources);
+        attributes<V, Rest...>::init(data, c_mesh, p_sources + 1);
+    }
+
+    static void copy(V& target, const source* p_sources, std::size_t vertex_offset)
+    {
+        copy_attribute<A>(static_cast<A&>(target), *p_sources, vertex_offset);
+        attributes<V, Rest...>::copy(target, p_sources + 1, vertex_offset);
+    }
+};
+
+template <typename V>
+struct builder;
+
+template <typename... Attributes>
+struct builder<vertex<Attributes...> >
+{
+    typedef vertex<Attributes...> vertex_type;
+    typedef attributes<vertex_type, Attributes...> attribute_list;
+
+    static_assert(sizeof...(Attributes) > 0, "a vertex needs at least one attribute");
+    static_assert(sizeof(vertex_type) == attribute_list::width * sizeof(float), "the vertex has padding");
+
+    static mesh<vertex_type> build(const objpar_data& data, unsigned int flags)
+    {
+        source sources[sizeof...(Attributes)];
+        std::unique_ptr<char[]> buffer;
+        std::unique_ptr<vertex_type[]> vertices;
+        std::unique_ptr<unsigned int[]> indices;
+        objpar_mesh c_mesh;
+        objpar_size_t buffer_size;
+
+        if (flags & OBJPAR_MESH_DEINTERLEAVE)
+            throw std::invalid_argument("objpar_cpp::build_mesh: a typed vertex can't be built with OBJPAR_MESH_DEINTERLEAVE");
+
+        /* Float attributes keep the copies below to plain loads, sizes and
+           limits are checked by objpar_build_mesh_ex. */
+        buffer_size = objpar_get_mesh_ex_size(&data, flags, nullptr);
+        if (buffer_size == 0)
+            return mesh<vertex_type>();
+        buffer.reset(new char[buffer_size]);
+        if (!objpar_build_mesh_ex(&data, buffer.get(), &c_mesh, flags, nullptr))
+            return mesh<vertex_type>();
+
+        attribute_list::init(data, c_mesh, sources);
+        vertices.reset(new vertex_type[c_mesh.vertex_count]);
+        for (std::size_t vertex = 0; vertex < c_mesh.vertex_count; ++vertex)
+            attribute_list::copy(vertices[vertex], sources, vertex * c_mesh.vertex_stride);
+
+        /* Small indexed meshes have 16 bit indices in the C API */
+        if (c_mesh.index_count > 0)
+        {
+            indices.reset(new unsigned int[c_mesh.index_count]);
+            if (c_mesh.index_size == sizeof(unsigned short))
+            {
+                const unsigned short* p_indices = static_cast<const unsigned short*>(c_mesh.p_indices);
+                std::copy(p_indices, p_indices + c_mesh.index_count, indices.get());
+            }
+            else
+            {
+                const unsigned int* p_indices = static_cast<const unsigned int*>(c_mesh.p_indices);
+                std::copy(p_indices, p_indices + c_mesh.index_count, indices.get());
+            }
+        }
+
+        return mesh<vertex_type>(std::move(vertices), c_mesh.vertex_count, std::move(indices), c_mesh.index_count,
+            std::vector<objpar_submesh>(c_mesh.p_submeshes, c_mesh.p_submeshes + c_mesh.submesh_count));
+    }
+};
+
+}
+
+/* Builds the mesh of data with the vertex layout V, a vertex<...> of
+   attributes. flags takes the OBJPAR_MESH_* flags of objpar_build_mesh_ex
+   except OBJPAR_MESH_DEINTERLEAVE. */
+template <typename V>
+mesh<V> build_mesh(const objpar_data& data, unsigned int flags = 0)
+{
+    return detail::builder<V>::build(data, flags);
+}
+
+}
+
+#endif /* _OBJPAR_HPP_ */
@@ -1,22 +1,83 @@
+#if defined(OBJPAR_ENABLE_THREADS)
+/* Split even the small sample files so the chunk and range boundaries get tested */
+#define OBJPAR_MIN_PARALLEL_SIZE 64
+#define OBJPAR_MIN_PARALLEL_CORNERS 6
+#endif
+/* Small blocks so objpar_stream_read goes around its ring many times */
+#define OBJPAR_READ_BLOCK_SIZE 256
 #include "objpar.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <assert.h>
 
 void* open_file(const char* p_file_name, size_t* p_file_size);
+int same_data(const objpar_data_t* p_a, const objpar_data_t* p_b);
+unsigned int check_face_offsets(const char* p_data, size_t file_size);
+unsigned int check_single_pass(const char* p_data, size_t file_size);
+unsigned int check_stream(const char* p_data, size_t file_size);
+unsigned int check_stream_read(const char* p_data, size_t file_size);
+size_t memory_read(void* p_user_data, void* p_block, size_t size);
+unsigned int check_indexed_mesh(const char* p_data, size_t file_size, unsigned int* p_vertex_count, unsigned int* p_index_count);
+unsigned int triangulated_corner_count(const char* p_data, size_t file_size, unsigned int flags);
+float half_to_float(unsigned short half);
+unsigned int check_vertex_formats(const char* p_data, size_t file_size);
+unsigned int check_generated_normals(const char* p_data, size_t file_size);
+unsigned int check_optimize(const char* p_data, size_t file_size);
+double corner_position_sum(const objpar_mesh_t* p_mesh);
+unsigned int check_meshlets(const char* p_data, size_t file_size);
+unsigned int check_load_model(const char* p_data, size_t file_size);
+unsigned int same_mesh(const objpar_mesh_t* p_a, const objpar_mesh_t* p_b);
+unsigned int check_cache(const char* p_data, size_t file_size);
+unsigned int check_visit(const char* p_data, size_t file_size);
+unsigned int check_groups(const char* p_data, size_t file_size);
+unsigned int check_mtl(const char* p_data, size_t file_size);
+unsigned int check_count_limits(void);
+unsigned int check_negative_indices(void);
+/* Input of check_stream_read. Reads return a different number of bytes
+   every call and fail once fail_offset is reached. */
+typedef struct memory_reader
+{
+    const char* p_data;
+    size_t size;
+    size_t offset;
+    size_t fail_offset;
+    unsigned int call_count;
+} memory_reader_t;
+
+#if defined(OBJPAR_ENABLE_THREADS)
+unsigned int check_parallel(const char* p_data, size_t file_size);
+unsigned int check_build_parallel(const char* p_data, size_t file_size);
+unsigned int check_batch_load(char** pp_files, unsigned int file_count);
+void batch_complete(void* p_user_data, unsigned int item, unsigned int status, objpar_model_t* p_model);
+
+/* Expected models of check_batch_load, item i loads file i % file_count
+   and an item past the files is a path that doesn't exist */
+typedef struct batch_check
+{
+    objpar_model_t* p_expected;
+    unsigned int file_count;
+    unsigned int statuses[64];
+    unsigned int reports[64];
+    unsigned int same[64];
+} batch_check_t;
+#endif
 
 int main()
 {
     unsigned int mesh_index;
-    char* files[5];
+    unsigned int failure_count;
+    char* files[6];
 
     files[0] = "data/plane.obj";
     files[1] = "data/cube.obj";
     files[2] = "data/cube_nontri.obj";
     files[3] = "data/monkey.obj";
     files[4] = "data/teapot.obj";
+    files[5] = "data/groups.obj";
 
-    for (mesh_index = 0; mesh_index < 5; ++mesh_index)
+    for (mesh_index = 0; mesh_index < sizeof(files) / sizeof(files[0]); ++mesh_index)
     {
         void* p_data;
         void* p_buffer;
@@ -82,15 +143,15 @@ int main()
         }
 
         printf("\nFaces:\n");
-        for (index = 0; index < obj_data.face_count * obj_data.face_width * 3; index += obj_data.face_width * 3)
+        for (index = 0; index < obj_data.face_count; ++index)
         {
             unsigned int j;
             putc('\t', stdout);
-            for (j = 0; j < obj_data.face_width * 3; j += 3)
+            for (j = obj_data.p_face_offsets[index] * 3; j < obj_data.p_face_offsets[index + 1] * 3; j += 3)
             {
-                unsigned int v = obj_data.p_faces[index + j + OBJPAR_V_IDX];
-                unsigned int vn = obj_data.p_faces[index + j + OBJPAR_VN_IDX];
-                unsigned int vt = obj_data.p_faces[index + j + OBJPAR_VT_IDX];
+                unsigned int v = obj_data.p_faces[j + OBJPAR_V_IDX];
+                unsigned int vn = obj_data.p_faces[j + OBJPAR_VN_IDX];
+                unsigned int vt = obj_data.p_faces[j + OBJPAR_VT_IDX];
 
                 printf("%u/%u/%u\t", v, vt, vn);
             }
@@ -99,7 +160,7 @@ int main()
         }
 
         /* Build Mesh */
-        if (obj_data.face_width == 3)
+        if (obj_data.face_count > 0)
         {
             unsigned int i;
             unsigned int count;
@@ -154,10 +215,1028 @@ int main()
         }
         free(p_buffer);
     }
+
+    /* The other parsers must give the same arrays as objpar */
+    failure_count = 0;
+    for (mesh_index = 0; mesh_index < sizeof(files) / sizeof(files[0]); ++mesh_index)
+    {
+        void* p_data;
+        size_t file_size;
+        unsigned int vertex_count;
+        unsigned int index_count;
+
+        p_data = open_file(files[mesh_index], &file_size);
+        if (!check_face_offsets((const char*)p_data, file_size))
+        {
+            printf("FAILED: face offsets don't match the face widths on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+        if (!check_single_pass((const char*)p_data, file_size))
+        {
+            printf("FAILED: objpar_single_pass differs from objpar on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+        if (!check_stream((const char*)p_data, file_size))
+        {
+            printf("FAILED: objpar_stream_feed differs from objpar on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+        if (!check_stream_read((const char*)p_data, file_size))
+        {
+            printf("FAILED: objpar_stream_read differs from objpar or ignores a read error on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+        if (!check_indexed_mesh((const char*)p_data, file_size, &vertex_count, &index_count))
+        {
+            printf("FAILED: objpar_build_indexed_mesh doesn't expand to objpar_build_mesh on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+        /* 8 corners with 3 normals each, 2 triangles per side */
+        if (strcmp(files[mesh_index], "data/cube.obj") == 0 && (vertex_count != 24 || index_count != 36))
+        {
+            printf("FAILED: indexed cube has %u vertices and %u indices instead of 24 and 36\n", vertex_count, index_count);
+            failure_count += 1;
+        }
+        /* 6 quads become 12 triangles whichever way they are split */
+        if (strcmp(files[mesh_index], "data/cube_nontri.obj") == 0)
+        {
+            unsigned int flags;
+            for (flags = 0; flags <= (OBJPAR_MESH_INDEXED | OBJPAR_MESH_EAR_CLIP); ++flags)
+            {
+                unsigned int corner_count = triangulated_corner_count((const char*)p_data, file_size, flags);
+                if (corner_count != 36)
+                {
+                    printf("FAILED: quad cube triangulated with flags 0x%x has %u corners instead of 36\n", flags, corner_count);
+                    failure_count += 1;
+                }
+            }
+        }
+        if (!check_vertex_formats((const char*)p_data, file_size))
+        {
+            printf("FAILED: packed vertex formats don't decode to the float mesh on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+        if (!check_generated_normals((const char*)p_data, file_size))
+        {
+            printf("FAILED: generated normals or tangents aren't unit length on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+        if (!check_optimize((const char*)p_data, file_size))
+        {
+            printf("FAILED: objpar_optimize_mesh made the ACMR worse or changed the triangles on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+        if (!check_meshlets((const char*)p_data, file_size))
+        {
+            printf("FAILED: meshlets break their limits or don't cover the mesh on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+        if (!check_load_model((const char*)p_data, file_size))
+        {
+            printf("FAILED: objpar_load_model differs from objpar_build_mesh_ex or kept its scratch on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+        if (!check_cache((const char*)p_data, file_size))
+        {
+            printf("FAILED: cache doesn't load back or accepts a stale source on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+        if (!check_visit((const char*)p_data, file_size))
+        {
+            printf("FAILED: objpar_visit records differ from objpar on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+        if (strcmp(files[mesh_index], "data/groups.obj") == 0 && !check_groups((const char*)p_data, file_size))
+        {
+            printf("FAILED: wrong group ranges, materials or submeshes on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+        if (strcmp(files[mesh_index], "data/groups.obj") == 0 && !check_mtl((const char*)p_data, file_size))
+        {
+            printf("FAILED: wrong materials from data/scene.mtl and data/other.mtl for %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+#if defined(OBJPAR_ENABLE_THREADS)
+        if (!check_parallel((const char*)p_data, file_size))
+        {
+            printf("FAILED: objpar_parallel differs from objpar on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+        if (!check_build_parallel((const char*)p_data, file_size))
+        {
+            printf("FAILED: objpar_build_mesh_parallel differs from objpar_build_mesh_ex on %s\n", files[mesh_index]);
+            failure_count += 1;
+        }
+#endif
+        free(p_data);
+    }
+    if (!check_count_limits())
+    {
+        printf("FAILED: counts that don't fit in 32 bits aren't rejected\n");
+        failure_count += 1;
+    }
+    if (!check_negative_indices())
+    {
+        printf("FAILED: negative indices don't resolve to absolute ones or objpar_validate is wrong\n");
+        failure_count += 1;
+    }
+#if defined(OBJPAR_ENABLE_THREADS)
+    if (!check_batch_load(files, sizeof(files) / sizeof(files[0])))
+    {
+        printf("FAILED: objpar_batch_load statuses or models are wrong\n");
+        failure_count += 1;
+    }
+#endif
+    if (failure_count > 0)
+        return 1;
+
     getchar();
     return 0;
 }
 
+int same_data(const objpar_data_t* p_a, const objpar_data_t* p_b)
+{
+    if (p_a->position_count != p_b->position_count || p_a->position_width != p_b->position_width ||
+        p_a->normal_count != p_b->normal_count || p_a->normal_width != p_b->normal_width ||
+        p_a->texcoord_count != p_b->texcoord_count || p_a->texcoord_width != p_b->texcoord_width ||
+        p_a->face_count != p_b->face_count || p_a->face_width != p_b->face_width ||
+        p_a->corner_count != p_b->corner_count || p_a->group_count != p_b->group_count ||
+        p_a->material_count != p_b->material_count || p_a->library_count != p_b->library_count ||
+        p_a->names_size != p_b->names_size)
+    {
+        return 0;
+    }
+
+    /* Empty arrays can be NULL on one side only */
+    return (p_a->position_count == 0 || memcmp(p_a->p_positions, p_b->p_positions, sizeof(float) * p_a->position_count * p_a->position_width) == 0) &&
+           (p_a->normal_count == 0 || memcmp(p_a->p_normals, p_b->p_normals, sizeof(float) * p_a->normal_count * p_a->normal_width) == 0) &&
+           (p_a->texcoord_count == 0 || memcmp(p_a->p_texcoords, p_b->p_texcoords, sizeof(float) * p_a->texcoord_count * p_a->texcoord_width) == 0) &&
+           (p_a->face_count == 0 || memcmp(p_a->p_face_offsets, p_b->p_face_offsets, sizeof(unsigned int) * (p_a->face_count + 1)) == 0) &&
+           (p_a->corner_count == 0 || memcmp(p_a->p_faces, p_b->p_faces, sizeof(unsigned int) * p_a->corner_count * 3) == 0) &&
+           (p_a->group_count == 0 || memcmp(p_a->p_groups, p_b->p_groups, sizeof(objpar_group_t) * p_a->group_count) == 0) &&
+           (p_a->material_count == 0 || memcmp(p_a->p_materials, p_b->p_materials, sizeof(unsigned int) * p_a->material_count) == 0) &&
+           (p_a->library_count == 0 || memcmp(p_a->p_libraries, p_b->p_libraries, sizeof(unsigned int) * p_a->library_count) == 0) &&
+           (p_a->names_size == 0 || memcmp(p_a->p_names, p_b->p_names, p_a->names_size) == 0);
+}
+
+unsigned int check_face_offsets(const char* p_data, size_t file_size)
+{
+    objpar_data_t obj_data;
+    void* p_buffer;
+    unsigned int index;
+    unsigned int mixed;
+    unsigned int same;
+
+    p_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_buffer, &obj_data);
+
+    /* Offsets start at 0, never go back and end at the corner count. The
+       face width is only set when every face has that many corners. */
+    mixed = 0;
+    same = obj_data.face_count == 0 || obj_data.p_face_offsets[0] == 0;
+    for (index = 0; index < obj_data.face_count && same; ++index)
+    {
+        unsigned int corner_count = obj_data.p_face_offsets[index + 1] - obj_data.p_face_offsets[index];
+        same = obj_data.p_face_offsets[index + 1] >= obj_data.p_face_offsets[index];
+        if (obj_data.face_width != 0)
+            same = same && corner_count == obj_data.face_width;
+        else if (index > 0 && corner_count != obj_data.p_face_offsets[1] - obj_data.p_face_offsets[0])
+            mixed = 1;
+    }
+    same = same && (obj_data.face_count == 0 || obj_data.p_face_offsets[obj_data.face_count] == obj_data.corner_count);
+    same = same && (obj_data.face_width != 0 || obj_data.face_count == 0 || mixed);
+
+    free(p_buffer);
+    return same;
+}
+
+unsigned int check_single_pass(const char* p_data, size_t file_size)
+{
+    objpar_data_t serial_data;
+    objpar_data_t single_data;
+    void* p_serial_buffer;
+    void* p_single_buffer;
+    unsigned int same;
+
+    p_serial_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_serial_buffer, &serial_data);
+
+    p_single_buffer = objpar_single_pass(p_data, file_size, &single_data);
+    same = p_single_buffer != NULL && same_data(&serial_data, &single_data);
+
+    objpar_free(p_single_buffer);
+    free(p_serial_buffer);
+    return same;
+}
+
+unsigned int check_stream(const char* p_data, size_t file_size)
+{
+    objpar_data_t serial_data;
+    void* p_serial_buffer;
+    size_t chunk_sizes[4];
+    unsigned int chunk_index;
+    unsigned int same;
+
+    p_serial_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_serial_buffer, &serial_data);
+
+    /* Single bytes split every record, odd sizes cut lines at changing
+       places and the last one feeds the whole file at once. */
+    chunk_sizes[0] = 1;
+    chunk_sizes[1] = 7;
+    chunk_sizes[2] = 4093;
+    chunk_sizes[3] = file_size;
+    same = 1;
+    for (chunk_index = 0; chunk_index < 4 && same; ++chunk_index)
+    {
+        objpar_stream_t stream;
+        objpar_data_t stream_data;
+        void* p_stream_buffer;
+        size_t offset;
+
+        objpar_stream_init(&stream);
+        for (offset = 0; offset < file_size && same; offset += chunk_sizes[chunk_index])
+        {
+            size_t chunk_size = file_size - offset;
+            if (chunk_size > chunk_sizes[chunk_index])
+                chunk_size = chunk_sizes[chunk_index];
+            same = objpar_stream_feed(&stream, p_data + offset, chunk_size);
+        }
+        p_stream_buffer = objpar_stream_finish(&stream, &stream_data);
+        same = same && p_stream_buffer != NULL && same_data(&serial_data, &stream_data);
+        objpar_free(p_stream_buffer);
+    }
+    free(p_serial_buffer);
+    return same;
+}
+
+unsigned int check_stream_read(const char* p_data, size_t file_size)
+{
+    objpar_data_t serial_data;
+    objpar_data_t read_data;
+    objpar_reader_t reader;
+    memory_reader_t memory;
+    objpar_arena_t arena;
+    void* p_serial_buffer;
+    void* p_read_buffer;
+    unsigned int same;
+
+    p_serial_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_serial_buffer, &serial_data);
+
+    memset(&memory, 0, sizeof(memory));
+    memory.p_data = p_data;
+    memory.size = file_size;
+    memory.fail_offset = (size_t)-1;
+    reader.p_user_data = &memory;
+    reader.p_read = memory_read;
+
+    /* Default allocator */
+    p_read_buffer = objpar_stream_read(&reader, NULL, &read_data);
+    same = p_read_buffer != NULL && same_data(&serial_data, &read_data);
+    objpar_free(p_read_buffer);
+
+    /* Arena */
+    objpar_arena_init(&arena, 0);
+    memory.offset = 0;
+    p_read_buffer = objpar_stream_read(&reader, &arena.allocator, &read_data);
+    same = same && p_read_buffer != NULL && same_data(&serial_data, &read_data);
+
+    /* A read error halfway through fails the whole parse */
+    memory.offset = 0;
+    memory.fail_offset = file_size / 2;
+    same = same && objpar_stream_read(&reader, &arena.allocator, &read_data) == NULL;
+    objpar_arena_release(&arena);
+
+    free(p_serial_buffer);
+    return same;
+}
+
+size_t memory_read(void* p_user_data, void* p_block, size_t size)
+{
+    memory_reader_t* p_memory = (memory_reader_t*)p_user_data;
+    size_t read_size;
+
+    if (p_memory->offset >= p_memory->fail_offset)
+        return OBJPAR_READ_ERROR;
+
+    /* Short reads like a decompressor that stops at its frame ends */
+    read_size = (size_t)(p_memory->call_count++ * 37) % size + 1;
+    if (read_size > p_memory->size - p_memory->offset)
+        read_size = p_memory->size - p_memory->offset;
+    memcpy(p_block, p_memory->p_data + p_memory->offset, read_size);
+    p_memory->offset += read_size;
+    return read_size;
+}
+
+unsigned int check_indexed_mesh(const char* p_data, size_t file_size, unsigned int* p_vertex_count, unsigned int* p_index_count)
+{
+    objpar_data_t obj_data;
+    objpar_mesh_t flat_mesh;
+    objpar_mesh_t indexed_mesh;
+    void* p_buffer;
+    void* p_flat_buffer;
+    void* p_indexed_buffer;
+    unsigned int index;
+    unsigned int same;
+
+    p_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_buffer, &obj_data);
+    *p_vertex_count = 0;
+    *p_index_count = 0;
+    same = 1;
+
+    p_flat_buffer = malloc(objpar_get_mesh_size(&obj_data));
+    p_indexed_buffer = malloc(objpar_get_indexed_mesh_size(&obj_data));
+    if (objpar_build_mesh(&obj_data, p_flat_buffer, &flat_mesh) &&
+        objpar_build_indexed_mesh(&obj_data, p_indexed_buffer, &indexed_mesh))
+    {
+        const char* p_flat_vertices = (const char*)flat_mesh.p_vertices;
+        const char* p_indexed_vertices = (const char*)indexed_mesh.p_vertices;
+
+        /* Looking every index up must give back the unindexed vertices */
+        same = indexed_mesh.vertex_stride == flat_mesh.vertex_stride && indexed_mesh.index_count == flat_mesh.vertex_count;
+        for (index = 0; index < indexed_mesh.index_count && same; ++index)
+        {
+            unsigned int vertex_index;
+            if (indexed_mesh.index_size == 2)
+                vertex_index = ((const unsigned short*)indexed_mesh.p_indices)[index];
+            else
+                vertex_index = ((const unsigned int*)indexed_mesh.p_indices)[index];
+            same = vertex_index < indexed_mesh.vertex_count &&
+                memcmp(p_flat_vertices + index * flat_mesh.vertex_stride, p_indexed_vertices + vertex_index * indexed_mesh.vertex_stride, flat_mesh.vertex_stride) == 0;
+        }
+        *p_vertex_count = indexed_mesh.vertex_count;
+        *p_index_count = indexed_mesh.index_count;
+    }
+    free(p_indexed_buffer);
+    free(p_flat_buffer);
+    free(p_buffer);
+    return same;
+}
+
+unsigned int triangulated_corner_count(const char* p_data, size_t file_size, unsigned int flags)
+{
+    objpar_data_t obj_data;
+    objpar_mesh_t obj_mesh;
+    void* p_buffer;
+    void* p_mesh_buffer;
+    unsigned int corner_count;
+
+    p_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_buffer, &obj_data);
+
+    corner_count = 0;
+    p_mesh_buffer = malloc(objpar_get_mesh_ex_size(&obj_data, flags, NULL));
+    if (objpar_build_mesh_ex(&obj_data, p_mesh_buffer, &obj_mesh, flags, NULL))
+        corner_count = (flags & OBJPAR_MESH_INDEXED) ? obj_mesh.index_count : obj_mesh.vertex_count;
+
+    free(p_mesh_buffer);
+    free(p_buffer);
+    return corner_count;
+}
+
+float half_to_float(unsigned short half)
+{
+    unsigned int exponent = (half >> 10) & 0x1F;
+    unsigned int mantissa = half & 0x3FF;
+    float value;
+
+    if (exponent == 0)
+        value = (float)ldexp((double)mantissa, -24);
+    else
+        value = (float)ldexp((double)(mantissa | 0x400), (int)exponent - 25);
+    return (half & 0x8000) ? -value : value;
+}
+
+unsigned int check_vertex_formats(const char* p_data, size_t file_size)
+{
+    objpar_data_t obj_data;
+    objpar_mesh_t float_mesh;
+    void* p_buffer;
+    void* p_float_buffer;
+    unsigned int test_index;
+    unsigned int same;
+
+    p_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_buffer, &obj_data);
+    if (obj_data.face_count == 0)
+    {
+        free(p_buffer);
+        return 1;
+    }
+
+    p_float_buffer = malloc(objpar_get_mesh_size(&obj_data));
+    same = objpar_build_mesh(&obj_data, p_float_buffer, &float_mesh);
+
+    /* Both normal packings, interleaved and in separate streams */
+    for (test_index = 0; test_index < 4 && same; ++test_index)
+    {
+        objpar_vertex_format_t format;
+        objpar_mesh_t packed_mesh;
+        void* p_packed_buffer;
+        unsigned int flags;
+        unsigned int vertex;
+
+        format.position_format = OBJPAR_FORMAT_HALF;
+        format.texcoord_format = OBJPAR_FORMAT_HALF;
+        format.normal_format = (test_index & 1) ? OBJPAR_FORMAT_SNORM_10_10_10_2 : OBJPAR_FORMAT_OCT16;
+        format.tangent_format = OBJPAR_FORMAT_FLOAT;
+        flags = (test_index & 2) ? OBJPAR_MESH_DEINTERLEAVE : 0;
+
+        p_packed_buffer = malloc(objpar_get_mesh_ex_size(&obj_data, flags, &format));
+        same = objpar_build_mesh_ex(&obj_data, p_packed_buffer, &packed_mesh, flags, &format) &&
+            packed_mesh.vertex_count == float_mesh.vertex_count;
+        for (vertex = 0; vertex < packed_mesh.vertex_count && same; ++vertex)
+        {
+            const char* p_float_vertex = (const char*)float_mesh.p_vertices + vertex * float_mesh.vertex_stride;
+            const char* p_packed_vertices = (const char*)packed_mesh.p_vertices;
+            unsigned int j;
+
+            /* Half floats keep 11 significant bits */
+            if (float_mesh.position_offset >= 0)
+            {
+                const float* p_expected = (const float*)(p_float_vertex + float_mesh.position_offset);
+                const unsigned short* p_half = (const unsigned short*)(p_packed_vertices + packed_mesh.position_offset + vertex * packed_mesh.position_stride);
+                for (j = 0; j < obj_data.position_width; ++j)
+                    same = same && fabs(half_to_float(p_half[j]) - p_expected[j]) <= fabs(p_expected[j]) / 1024.0 + 1e-4;
+            }
+            if (float_mesh.texcoord_offset >= 0)
+            {
+                const float* p_expected = (const float*)(p_float_vertex + float_mesh.texcoord_offset);
+                const unsigned short* p_half = (const unsigned short*)(p_packed_vertices + packed_mesh.texcoord_offset + vertex * packed_mesh.texcoord_stride);
+                for (j = 0; j < obj_data.texcoord_width; ++j)
+                    same = same && fabs(half_to_float(p_half[j]) - p_expected[j]) <= fabs(p_expected[j]) / 1024.0 + 1e-4;
+            }
+            if (float_mesh.normal_offset >= 0)
+            {
+                const float* p_expected = (const float*)(p_float_vertex + float_mesh.normal_offset);
+                unsigned int packed;
+                float decoded[3];
+                float length;
+
+                memcpy(&packed, p_packed_vertices + packed_mesh.normal_offset + vertex * packed_mesh.normal_stride, sizeof(packed));
+                if (format.normal_format == OBJPAR_FORMAT_OCT16)
+                {
+                    /* Unfold the octahedron and compare directions */
+                    decoded[0] = (float)(short)(packed & 0xFFFF) / 32767.0f;
+                    decoded[1] = (float)(short)(packed >> 16) / 32767.0f;
+                    decoded[2] = 1.0f - (float)fabs(decoded[0]) - (float)fabs(decoded[1]);
+                    if (decoded[2] < 0.0f)
+                    {
+                        float x = decoded[0];
+                        decoded[0] = (1.0f - (float)fabs(decoded[1])) * (x < 0.0f ? -1.0f : 1.0f);
+                        decoded[1] = (1.0f - (float)fabs(x)) * (decoded[1] < 0.0f ? -1.0f : 1.0f);
+                    }
+                    length = (float)sqrt(p_expected[0] * p_expected[0] + p_expected[1] * p_expected[1] + p_expected[2] * p_expected[2]);
+                    if (length > 0.0f)
+                    {
+                        float decoded_length = (float)sqrt(decoded[0] * decoded[0] + decoded[1] * decoded[1] + decoded[2] * decoded[2]);
+                        float cosine = (decoded[0] * p_expected[0] + decoded[1] * p_expected[1] + decoded[2] * p_expected[2]) / (decoded_length * length);
+                        same = same && cosine > 0.9999f;
+                    }
+                }
+                else
+                {
+                    /* Sign extend each 10 bit component */
+                    for (j = 0; j < 3; ++j)
+                    {
+                        int value = (int)((packed >> (10 * j)) & 0x3FF);
+                        if (value >= 512)
+                            value -= 1024;
+                        decoded[j] = (float)value / 511.0f;
+                        same = same && fabs(decoded[j] - p_expected[j]) <= 1.0 / 511.0;
+                    }
+                }
+            }
+        }
+        free(p_packed_buffer);
+    }
+
+    free(p_float_buffer);
+    free(p_buffer);
+    return same;
+}
+
+unsigned int check_generated_normals(const char* p_data, size_t file_size)
+{
+    objpar_data_t obj_data;
+    void* p_buffer;
+    unsigned int test_index;
+    unsigned int same;
+
+    p_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_buffer, &obj_data);
+    same = 1;
+
+    /* Normals read from the file are kept as they are, so only files
+       without vn have every normal generated */
+    for (test_index = 0; test_index < 2 && obj_data.face_count > 0 && obj_data.normal_count == 0; ++test_index)
+    {
+        objpar_mesh_t obj_mesh;
+        void* p_mesh_buffer;
+        unsigned int flags;
+        unsigned int vertex;
+
+        flags = OBJPAR_MESH_GENERATE_TANGENTS | (test_index == 1 ? OBJPAR_MESH_INDEXED : 0);
+        p_mesh_buffer = malloc(objpar_get_mesh_ex_size(&obj_data, flags, NULL));
+        same = objpar_build_mesh_ex(&obj_data, p_mesh_buffer, &obj_mesh, flags, NULL) &&
+            obj_mesh.normal_offset >= 0 && obj_mesh.tangent_offset >= 0;
+        for (vertex = 0; vertex < obj_mesh.vertex_count && same; ++vertex)
+        {
+            const char* p_vertex = (const char*)obj_mesh.p_vertices + vertex * obj_mesh.vertex_stride;
+            const float* p_normal = (const float*)(p_vertex + obj_mesh.normal_offset);
+            const float* p_tangent = (const float*)(p_vertex + obj_mesh.tangent_offset);
+            double normal_length = sqrt(p_normal[0] * p_normal[0] + p_normal[1] * p_normal[1] + p_normal[2] * p_normal[2]);
+            double tangent_length = sqrt(p_tangent[0] * p_tangent[0] + p_tangent[1] * p_tangent[1] + p_tangent[2] * p_tangent[2]);
+            double cosine = p_normal[0] * p_tangent[0] + p_normal[1] * p_tangent[1] + p_normal[2] * p_tangent[2];
+
+            /* Tangents are orthogonal to the normal and w is the bitangent sign */
+            same = fabs(normal_length - 1.0) < 1e-3 && fabs(tangent_length - 1.0) < 1e-3 &&
+                fabs(cosine) < 1e-3 && (p_tangent[3] == 1.0f || p_tangent[3] == -1.0f);
+        }
+        free(p_mesh_buffer);
+    }
+
+    free(p_buffer);
+    return same;
+}
+
+unsigned int check_optimize(const char* p_data, size_t file_size)
+{
+    objpar_data_t obj_data;
+    objpar_mesh_t obj_mesh;
+    objpar_mesh_stats_t before;
+    objpar_mesh_stats_t after;
+    void* p_buffer;
+    void* p_mesh_buffer;
+    void* p_stats_scratch;
+    void* p_scratch;
+    double sum_before;
+    double sum_after;
+    unsigned int same;
+
+    p_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_buffer, &obj_data);
+    if (obj_data.face_count == 0)
+    {
+        free(p_buffer);
+        return 1;
+    }
+
+    p_mesh_buffer = malloc(objpar_get_indexed_mesh_size(&obj_data));
+    same = objpar_build_indexed_mesh(&obj_data, p_mesh_buffer, &obj_mesh) != 0;
+    p_stats_scratch = malloc(objpar_get_mesh_stats_size(&obj_mesh));
+    p_scratch = malloc(objpar_get_optimize_size(&obj_mesh));
+
+    /* The triangles can only move, so the positions of all corners add up
+       to the same sum in any order */
+    objpar_mesh_stats(&obj_mesh, 0, p_stats_scratch, &before);
+    sum_before = corner_position_sum(&obj_mesh);
+    same = same && objpar_optimize_mesh(&obj_mesh, 0, p_scratch) != 0;
+    objpar_mesh_stats(&obj_mesh, 0, p_stats_scratch, &after);
+    sum_after = corner_position_sum(&obj_mesh);
+
+    same = same && after.triangle_count == before.triangle_count && after.acmr <= before.acmr &&
+        fabs(sum_after - sum_before) <= 1e-6 * (fabs(sum_before) + 1.0);
+
+    free(p_scratch);
+    free(p_stats_scratch);
+    free(p_mesh_buffer);
+    free(p_buffer);
+    return same;
+}
+
+double corner_position_sum(const objpar_mesh_t* p_mesh)
+{
+    double sum;
+    unsigned int corner;
+
+    sum = 0.0;
+    for (corner = 0; corner < p_mesh->index_count; ++corner)
+    {
+        unsigned int vertex;
+        const float* p_position;
+
+        if (p_mesh->index_size == sizeof(unsigned short))
+            vertex = ((const unsigned short*)p_mesh->p_indices)[corner];
+        else
+            vertex = ((const unsigned int*)p_mesh->p_indices)[corner];
+        p_position = (const float*)((const char*)p_mesh->p_vertices + p_mesh->position_offset + vertex * p_mesh->position_stride);
+        sum += p_position[0] + 2.0 * p_position[1] + 3.0 * p_position[2];
+    }
+    return sum;
+}
+
+unsigned int check_meshlets(const char* p_data, size_t file_size)
+{
+    static const unsigned int limits[3][2] = { { 64, 124 }, { 16, 8 }, { 3, 1 } };
+    objpar_data_t obj_data;
+    objpar_mesh_t obj_mesh;
+    void* p_buffer;
+    void* p_mesh_buffer;
+    unsigned int test_index;
+    unsigned int same;
+
+    p_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_buffer, &obj_data);
+    if (obj_data.face_count == 0)
+    {
+        free(p_buffer);
+        return 1;
+    }
+
+    p_mesh_buffer = malloc(objpar_get_indexed_mesh_size(&obj_data));
+    same = objpar_build_indexed_mesh(&obj_data, p_mesh_buffer, &obj_mesh) != 0;
+
+    /* Meshlets are cut from the index buffer in order, so walking them
+       gives back every triangle of the mesh */
+    for (test_index = 0; test_index < sizeof(limits) / sizeof(limits[0]) && same; ++test_index)
+    {
+        objpar_meshlets_t meshlets;
+        void* p_meshlet_buffer;
+        unsigned int meshlet_index;
+        unsigned int corner;
+
+        p_meshlet_buffer = malloc(objpar_get_meshlets_size(&obj_data, &obj_mesh, limits[test_index][0], limits[test_index][1]));
+        same = objpar_build_meshlets(&obj_data, &obj_mesh, limits[test_index][0], limits[test_index][1], p_meshlet_buffer, &meshlets) != 0 &&
+            meshlets.triangle_count * 3 == obj_mesh.index_count;
+        corner = 0;
+        for (meshlet_index = 0; meshlet_index < meshlets.meshlet_count && same; ++meshlet_index)
+        {
+            const objpar_meshlet_t* p_meshlet = &meshlets.p_meshlets[meshlet_index];
+            unsigned int j;
+
+            same = p_meshlet->vertex_count <= limits[test_index][0] && p_meshlet->triangle_count <= limits[test_index][1];
+            for (j = 0; j < p_meshlet->triangle_count * 3 && same; ++j, ++corner)
+            {
+                unsigned int local = meshlets.p_triangles[p_meshlet->triangle_offset + j];
+                unsigned int vertex = meshlets.p_vertices[p_meshlet->vertex_offset + local];
+                unsigned int expected;
+                const float* p_position;
+                float dx;
+                float dy;
+                float dz;
+
+                if (obj_mesh.index_size == sizeof(unsigned short))
+                    expected = ((const unsigned short*)obj_mesh.p_indices)[corner];
+                else
+                    expected = ((const unsigned int*)obj_mesh.p_indices)[corner];
+                p_position = (const float*)((const char*)obj_mesh.p_vertices + obj_mesh.position_offset + vertex * obj_mesh.position_stride);
+                dx = p_position[0] - p_meshlet->center[0];
+                dy = p_position[1] - p_meshlet->center[1];
+                dz = p_position[2] - p_meshlet->center[2];
+                same = local < p_meshlet->vertex_count && vertex == expected &&
+                    (float)sqrt(dx * dx + dy * dy + dz * dz) <= p_meshlet->radius * 1.0001f + 1e-5f;
+            }
+        }
+        free(p_meshlet_buffer);
+    }
+
+    free(p_mesh_buffer);
+    free(p_buffer);
+    return same;
+}
+
+unsigned int check_load_model(const char* p_data, size_t file_size)
+{
+    const unsigned int flags = OBJPAR_MESH_INDEXED | OBJPAR_MESH_GENERATE_NORMALS | OBJPAR_MESH_GENERATE_TANGENTS;
+    objpar_data_t obj_data;
+    objpar_mesh_t obj_mesh;
+    objpar_model_t model;
+    objpar_arena_t arena;
+    void* p_buffer;
+    void* p_mesh_buffer;
+    size_t mesh_size;
+    unsigned int same;
+
+    p_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_buffer, &obj_data);
+    if (obj_data.face_count == 0)
+    {
+        free(p_buffer);
+        return 1;
+    }
+
+    mesh_size = objpar_get_mesh_ex_size(&obj_data, flags, NULL);
+    p_mesh_buffer = malloc(mesh_size);
+    same = objpar_build_mesh_ex(&obj_data, p_mesh_buffer, &obj_mesh, flags, NULL) != 0;
+
+    /* Default allocator, a failed load leaves an empty model */
+    if (same)
+    {
+        same = objpar_load_model(p_data, file_size, flags, NULL, NULL, &model) &&
+            same_data(&model.data, &obj_data) && same_mesh(&model.mesh, &obj_mesh);
+        objpar_free_model(NULL, &model);
+    }
+
+    /* Arena, the mesh is its last allocation so it shrinks in place and
+       the next allocation starts where the kept vertices end */
+    objpar_arena_init(&arena, 0);
+    if (same && objpar_load_model(p_data, file_size, flags, NULL, &arena.allocator, &model))
+    {
+        char* p_next = (char*)arena.allocator.p_alloc(arena.allocator.p_user_data, 1);
+        size_t used_size = (size_t)((char*)model.mesh.p_vertices - (char*)model.p_mesh_buffer) +
+            (size_t)model.mesh.vertex_count * model.mesh.vertex_stride;
+
+        same = same_data(&model.data, &obj_data) && same_mesh(&model.mesh, &obj_mesh) &&
+            p_next >= (char*)model.p_mesh_buffer + used_size && p_next < (char*)model.p_mesh_buffer + used_size + 64;
+        objpar_free_model(&arena.allocator, &model);
+    }
+    else
+    {
+        same = 0;
+    }
+    objpar_arena_release(&arena);
+
+    free(p_mesh_buffer);
+    free(p_buffer);
+    return same;
+}
+
+unsigned int same_mesh(const objpar_mesh_t* p_a, const objpar_mesh_t* p_b)
+{
+    if (p_a->vertex_count != p_b->vertex_count || p_a->vertex_stride != p_b->vertex_stride ||
+        p_a->index_count != p_b->index_count || p_a->index_size != p_b->index_size ||
+        p_a->submesh_count != p_b->submesh_count)
+    {
+        return 0;
+    }
+    return memcmp(p_a->p_vertices, p_b->p_vertices, (size_t)p_a->vertex_count * p_a->vertex_stride) == 0 &&
+        (p_a->index_count == 0 || memcmp(p_a->p_indices, p_b->p_indices, (size_t)p_a->index_count * p_a->index_size) == 0) &&
+        memcmp(p_a->p_submeshes, p_b->p_submeshes, p_a->submesh_count * sizeof(objpar_submesh_t)) == 0;
+}
+
+unsigned int check_cache(const char* p_data, size_t file_size)
+{
+    objpar_data_t obj_data;
+    objpar_data_t cached_data;
+    objpar_mesh_t obj_mesh;
+    objpar_mesh_t cached_mesh;
+    objpar_mesh_t* p_mesh;
+    objpar_hash_t hash;
+    void* p_buffer;
+    void* p_mesh_buffer;
+    void* p_cache;
+    unsigned int cache_size;
+    unsigned int same;
+
+    p_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_buffer, &obj_data);
+
+    p_mesh = NULL;
+    p_mesh_buffer = NULL;
+    if (obj_data.face_count > 0)
+    {
+        p_mesh_buffer = malloc(objpar_get_indexed_mesh_size(&obj_data));
+        if (objpar_build_indexed_mesh(&obj_data, p_mesh_buffer, &obj_mesh))
+            p_mesh = &obj_mesh;
+    }
+
+    hash = objpar_hash(p_data, file_size);
+    cache_size = objpar_get_cache_size(&obj_data, p_mesh);
+    p_cache = malloc(cache_size);
+    same = objpar_cache_write(&obj_data, p_mesh, file_size, hash, p_cache) &&
+        objpar_cache_load(p_cache, cache_size, file_size, hash, &cached_data, p_mesh != NULL ? &cached_mesh : NULL) &&
+        same_data(&obj_data, &cached_data);
+    if (same && p_mesh != NULL)
+    {
+        same = cached_mesh.vertex_count == obj_mesh.vertex_count && cached_mesh.vertex_stride == obj_mesh.vertex_stride &&
+            cached_mesh.index_count == obj_mesh.index_count && cached_mesh.index_size == obj_mesh.index_size &&
+            memcmp(cached_mesh.p_vertices, obj_mesh.p_vertices, obj_mesh.vertex_count * obj_mesh.vertex_stride) == 0 &&
+            memcmp(cached_mesh.p_indices, obj_mesh.p_indices, obj_mesh.index_count * obj_mesh.index_size) == 0;
+    }
+
+    /* A different source or a truncated cache must be rejected. Arrays
+       are padded to less than 64 bytes, so dropping 64 cuts the last one. */
+    same = same && !objpar_cache_load(p_cache, cache_size, file_size, hash + 1, &cached_data, NULL);
+    same = same && !objpar_cache_load(p_cache, cache_size, file_size + 1, hash, &cached_data, NULL);
+    same = same && !objpar_cache_load(p_cache, cache_size - 64, file_size, hash, &cached_data, NULL);
+
+    free(p_cache);
+    free(p_mesh_buffer);
+    free(p_buffer);
+    return same;
+}
+
+unsigned int check_groups(const char* p_data, size_t file_size)
+{
+    /* face_begin, face_count, material and smoothing of every range */
+    static const unsigned int expected_groups[6][4] = {
+        { 0, 2, 0, 1 }, { 2, 1, 1, 1 }, { 3, 1, 0, 0 }, { 4, 2, 0, 0 }, { 6, 1, 2, 0 }, { 7, 1, 2, 0 }
+    };
+    static const char* expected_objects[6] = { "Box One", "Box One", "Box One", "", "", "" };
+    static const char* expected_names[6] = { "front", "front", "front", "", "", "tail" };
+    static const char* expected_materials[3] = { "red", "blue", "green" };
+    /* Triangulated corners of each material */
+    static const unsigned int expected_submeshes[3] = { 15, 6, 6 };
+    objpar_data_t obj_data;
+    objpar_mesh_t obj_mesh;
+    void* p_buffer;
+    void* p_mesh_buffer;
+    unsigned int index;
+    unsigned int same;
+
+    p_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_buffer, &obj_data);
+
+    same = obj_data.group_count == 6 && obj_data.material_count == 3 && obj_data.library_count == 1 &&
+        strcmp(obj_data.p_names + obj_data.p_libraries[0], "scene.mtl other.mtl") == 0;
+    for (index = 0; index < 6 && same; ++index)
+    {
+        const objpar_group_t* p_group = &obj_data.p_groups[index];
+        same = p_group->face_begin == expected_groups[index][0] && p_group->face_count == expected_groups[index][1] &&
+            p_group->material == expected_groups[index][2] && p_group->smoothing == expected_groups[index][3] &&
+            strcmp(obj_data.p_names + p_group->object, expected_objects[index]) == 0 &&
+            strcmp(obj_data.p_names + p_group->group, expected_names[index]) == 0;
+    }
+    for (index = 0; index < 3 && same; ++index)
+    {
+        same = strcmp(obj_data.p_names + obj_data.p_materials[index], expected_materials[index]) == 0;
+    }
+
+    p_mesh_buffer = malloc(objpar_get_mesh_size(&obj_data));
+    same = same && objpar_build_mesh(&obj_data, p_mesh_buffer, &obj_mesh) && obj_mesh.submesh_count == 3;
+    for (index = 0; index < 3 && same; ++index)
+    {
+        same = obj_mesh.p_submeshes[index].material == index && obj_mesh.p_submeshes[index].count == expected_submeshes[index] &&
+            obj_mesh.p_submeshes[index].first == (index > 0 ? obj_mesh.p_submeshes[index - 1].first + obj_mesh.p_submeshes[index - 1].count : 0);
+    }
+
+    free(p_mesh_buffer);
+    free(p_buffer);
+    return same;
+}
+
+unsigned int check_mtl(const char* p_data, size_t file_size)
+{
+    objpar_data_t obj_data;
+    objpar_mtl_data_t mtl_data;
+    const objpar_material_t* p_red;
+    const objpar_material_t* p_blue;
+    const objpar_material_t* p_green;
+    const char* libraries[2];
+    objpar_size_t library_sizes[2];
+    unsigned int remap[3];
+    void* p_buffer;
+    void* p_mtl_buffer;
+    size_t size;
+    unsigned int same;
+
+    p_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_buffer, &obj_data);
+
+    libraries[0] = (const char*)open_file("data/scene.mtl", &size);
+    library_sizes[0] = size;
+    libraries[1] = (const char*)open_file("data/other.mtl", &size);
+    library_sizes[1] = size;
+    p_mtl_buffer = malloc(objpar_get_mtl_size(libraries, library_sizes, 2));
+
+    /* red is defined in both libraries, the first definition wins */
+    same = objpar_mtl(libraries, library_sizes, 2, p_mtl_buffer, &mtl_data) && mtl_data.material_count == 4 &&
+        objpar_mtl_find(&mtl_data, "red") == 0 && objpar_mtl_find(&mtl_data, "blue") == 1 &&
+        objpar_mtl_find(&mtl_data, "green") == 2 && objpar_mtl_find(&mtl_data, "missing") == OBJPAR_NONE;
+    if (same)
+    {
+        p_red = &mtl_data.p_materials[0];
+        p_blue = &mtl_data.p_materials[1];
+        p_green = &mtl_data.p_materials[2];
+        same = p_red->diffuse[0] == 1.0f && p_red->ambient[0] == 0.1f && p_red->shininess == 32.0f && p_red->illum == 2 &&
+            p_red->maps[OBJPAR_MAP_DIFFUSE] != OBJPAR_NONE && strcmp(mtl_data.p_names + p_red->maps[OBJPAR_MAP_DIFFUSE], "textures/red.png") == 0 &&
+            p_blue->dissolve == 0.75f && p_blue->maps[OBJPAR_MAP_DIFFUSE] == OBJPAR_NONE &&
+            p_blue->maps[OBJPAR_MAP_BUMP] != OBJPAR_NONE && strcmp(mtl_data.p_names + p_blue->maps[OBJPAR_MAP_BUMP], "textures/blue_bump.png") == 0 &&
+            p_green->dissolve == 0.5f && p_green->ior == 1.5f && mtl_data.p_materials[3].diffuse[0] == 0.5f;
+    }
+
+    /* groups.obj uses red, blue and green in that order */
+    same = same && obj_data.material_count == 3 && objpar_mtl_resolve(&mtl_data, &obj_data, remap) == 3 &&
+        remap[0] == 0 && remap[1] == 1 && remap[2] == 2;
+
+    free(p_mtl_buffer);
+    free((void*)libraries[1]);
+    free((void*)libraries[0]);
+    free(p_buffer);
+    return same;
+}
+
+/* Records seen by the visitor callbacks, checked against objpar */
+typedef struct visit_check
+{
+    const objpar_data_t* p_expected;
+    unsigned int position_count;
+    unsigned int normal_count;
+    unsigned int texcoord_count;
+    unsigned int face_count;
+    unsigned int corner_count;
+    unsigned int same;
+} visit_check_t;
+
+static void visit_positions(void* p_user_data, const float* p_positions, unsigned int count, unsigned int width)
+{
+    visit_check_t* p_check = (visit_check_t*)p_user_data;
+    const objpar_data_t* p_expected = p_check->p_expected;
+
+    if (width == p_expected->position_width && p_check->position_count + count <= p_expected->position_count)
+        p_check->same = p_check->same && memcmp(p_positions, p_expected->p_positions + p_check->position_count * width, sizeof(float) * count * width) == 0;
+    p_check->position_count += count;
+}
+
+static void visit_normals(void* p_user_data, const float* p_normals, unsigned int count, unsigned int width)
+{
+    visit_check_t* p_check = (visit_check_t*)p_user_data;
+    (void)p_normals;
+    (void)width;
+    p_check->normal_count += count;
+}
+
+static void visit_texcoords(void* p_user_data, const float* p_texcoords, unsigned int count, unsigned int width)
+{
+    visit_check_t* p_check = (visit_check_t*)p_user_data;
+    (void)p_texcoords;
+    (void)width;
+    p_check->texcoord_count += count;
+}
+
+static void visit_faces(void* p_user_data, const unsigned int* p_faces, const unsigned int* p_face_offsets, unsigned int count)
+{
+    visit_check_t* p_check = (visit_check_t*)p_user_data;
+    const objpar_data_t* p_expected = p_check->p_expected;
+    unsigned int corner_count = p_face_offsets[count] - p_face_offsets[0];
+
+    if (p_check->corner_count + corner_count <= p_expected->corner_count)
+        p_check->same = p_check->same && memcmp(p_faces, p_expected->p_faces + p_check->corner_count * 3, sizeof(unsigned int) * corner_count * 3) == 0;
+    p_check->face_count += count;
+    p_check->corner_count += corner_count;
+}
+
+unsigned int check_visit(const char* p_data, size_t file_size)
+{
+    objpar_data_t obj_data;
+    void* p_buffer;
+    unsigned int batch_size;
+    unsigned int same;
+
+    p_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_buffer, &obj_data);
+
+    /* One record per call, a size that splits faces across batches and
+       the default size */
+    same = 1;
+    for (batch_size = 0; batch_size <= 7 && same; batch_size += 1 + (batch_size == 1) * 5)
+    {
+        objpar_visitor_t visitor;
+        visit_check_t check;
+
+        memset(&check, 0, sizeof(check));
+        check.p_expected = &obj_data;
+        check.same = 1;
+        memset(&visitor, 0, sizeof(visitor));
+        visitor.p_user_data = &check;
+        visitor.batch_size = batch_size;
+        visitor.p_positions = visit_positions;
+        visitor.p_normals = visit_normals;
+        visitor.p_texcoords = visit_texcoords;
+        visitor.p_faces = visit_faces;
+
+        same = objpar_visit(p_data, file_size, &visitor) && check.same &&
+            check.position_count == obj_data.position_count && check.normal_count == obj_data.normal_count &&
+            check.texcoord_count == obj_data.texcoord_count && check.face_count == obj_data.face_count &&
+            check.corner_count == obj_data.corner_count;
+    }
+
+    free(p_buffer);
+    return same;
+}
+
+#if defined(OBJPAR_ENABLE_THREADS)
+unsigned int check_parallel(const char* p_data, size_t file_size)
+{
+    objpar_data_t serial_data;
+    void* p_serial_buffer;
+    unsigned int thread_count;
+    unsigned int same;
+
+    p_serial_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_serial_buffer, &serial_data);
+
+    /* Every thread count moves the chunk boundaries, which changes the
+       prefix sums that place the records. */
+    same = 1;
+    for (thread_count = 1; thread_count <= 8 && same; ++thread_count)
+    {
+        objpar_data_t parallel_data;
+        void* p_parallel_buffer;
+
+        p_parallel_buffer = malloc(objpar_parallel_get_size(p_data, file_size, thread_count));
+        objpar_parallel(p_data, file_size, p_parallel_buffer, &parallel_data, thread_count);
+        same = same_data(&serial_data, &parallel_data);
+        free(p_parallel_buffer);
+    }
+    free(p_serial_buffer);
+    return same;
+}
+#endif
+
 void* open_file(const char* p_file_name, size_t* p_file_size)
 {
     FILE* p_file;
@@ -186,3 +1265,217 @@ void* open_file(const char* p_file_name, size_t* p_file_size)
     *p_file_size = size;
     return p_file_data;
 }
+
+unsigned int check_count_limits(void)
+{
+    objpar_data_t counts;
+    objpar_data_t range_counts;
+
+    /* Inputs this large can't be parsed here, so the merge of per range
+       counts and the layout are fed the counts directly */
+    memset(&counts, 0, sizeof(counts));
+    memset(&range_counts, 0, sizeof(range_counts));
+    counts.corner_count = OBJPAR_NONE - 2;
+    range_counts.corner_count = 1;
+    if (!objpar_internal_merge(&counts, &range_counts) || counts.corner_count != OBJPAR_NONE - 1)
+        return 0;
+    if (objpar_internal_merge(&counts, &range_counts))
+        return 0;
+
+    memset(&counts, 0, sizeof(counts));
+    counts.group_count = 0x40000000;
+    counts.material_count = 0x40000000;
+    if (objpar_internal_layout(&counts, NULL, NULL) != 0)
+        return 0;
+
+    /* Positions alone need more than 4 GB, only 64 bit targets can hold them */
+    memset(&counts, 0, sizeof(counts));
+    counts.position_count = 0x80000000u;
+    counts.position_width = 4;
+    return objpar_internal_layout(&counts, NULL, NULL) == (sizeof(size_t) > 4 ? (size_t)0x80000000u * 16 : 0);
+}
+
+unsigned int check_negative_indices(void)
+{
+    const char* p_absolute =
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\n"
+        "f 1/1/1 2/1/1 3/1/1\n"
+        "v 1 1 0\n"
+        "f 2/1/1 4/1/1 3/1/1\n";
+    const char* p_relative =
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\n"
+        "f -3/-1/-1 -2/-1/-1 -1/-1/-1\n"
+        "v 1 1 0\n"
+        "f -3/-1/-1 -1/-1/-1 -2/-1/-1\n";
+    /* v 4, vt 2, v -4 and vn 3 are out of range */
+    const char* p_invalid =
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\n"
+        "f 1/1 2/2 4\n"
+        "f -4 1 2\n"
+        "f 1//3 2 3\n";
+    objpar_data_t absolute_data;
+    objpar_data_t relative_data;
+    void* p_absolute_buffer;
+    void* p_relative_buffer;
+    unsigned int passed;
+
+    p_absolute_buffer = malloc(objpar_get_size(p_absolute, strlen(p_absolute)));
+    objpar(p_absolute, strlen(p_absolute), p_absolute_buffer, &absolute_data);
+    p_relative_buffer = malloc(objpar_get_size(p_relative, strlen(p_relative)));
+    objpar(p_relative, strlen(p_relative), p_relative_buffer, &relative_data);
+
+    /* Every other parser has to resolve them the same way objpar does */
+    passed = same_data(&absolute_data, &relative_data) && objpar_validate(&relative_data) == 0 &&
+        check_single_pass(p_relative, strlen(p_relative)) && check_stream(p_relative, strlen(p_relative)) &&
+        check_visit(p_relative, strlen(p_relative));
+#if defined(OBJPAR_ENABLE_THREADS)
+    passed = passed && check_parallel(p_relative, strlen(p_relative));
+#endif
+    free(p_relative_buffer);
+    free(p_absolute_buffer);
+
+    p_relative_buffer = malloc(objpar_get_size(p_invalid, strlen(p_invalid)));
+    objpar(p_invalid, strlen(p_invalid), p_relative_buffer, &relative_data);
+    passed = passed && objpar_validate(&relative_data) == 4 && relative_data.p_faces[3 * 3 + OBJPAR_V_IDX] == OBJPAR_NONE;
+    free(p_relative_buffer);
+    return passed;
+}
+
+#if defined(OBJPAR_ENABLE_THREADS)
+unsigned int check_build_parallel(const char* p_data, size_t file_size)
+{
+    static const unsigned int flags[6] = {
+        0,
+        OBJPAR_MESH_EAR_CLIP,
+        OBJPAR_MESH_DEINTERLEAVE,
+        OBJPAR_MESH_GENERATE_NORMALS | OBJPAR_MESH_GENERATE_TANGENTS,
+        OBJPAR_MESH_DEINTERLEAVE | OBJPAR_MESH_GENERATE_NORMALS,
+        OBJPAR_MESH_INDEXED
+    };
+    objpar_data_t obj_data;
+    objpar_vertex_format_t format;
+    void* p_buffer;
+    unsigned int test_index;
+    unsigned int same;
+
+    p_buffer = malloc(objpar_get_size(p_data, file_size));
+    objpar(p_data, file_size, p_buffer, &obj_data);
+    if (obj_data.face_count == 0)
+    {
+        free(p_buffer);
+        return 1;
+    }
+
+    /* Odd tests also use packed formats so the generic expand path is split too */
+    memset(&format, 0, sizeof(format));
+    format.position_format = OBJPAR_FORMAT_HALF;
+    format.texcoord_format = OBJPAR_FORMAT_HALF;
+    format.normal_format = OBJPAR_FORMAT_OCT16;
+    format.tangent_format = OBJPAR_FORMAT_FLOAT;
+
+    same = 1;
+    for (test_index = 0; test_index < 2 * sizeof(flags) / sizeof(flags[0]) && same; ++test_index)
+    {
+        const objpar_vertex_format_t* p_format = (test_index & 1) ? &format : NULL;
+        unsigned int test_flags = flags[test_index / 2];
+        objpar_mesh_t serial_mesh;
+        objpar_mesh_t parallel_mesh;
+        void* p_serial_buffer;
+        void* p_parallel_buffer;
+        size_t mesh_size;
+
+        mesh_size = objpar_get_mesh_ex_size(&obj_data, test_flags, p_format);
+        p_serial_buffer = malloc(mesh_size);
+        p_parallel_buffer = malloc(mesh_size);
+        same = objpar_build_mesh_ex(&obj_data, p_serial_buffer, &serial_mesh, test_flags, p_format) != 0 &&
+            objpar_build_mesh_parallel(&obj_data, p_parallel_buffer, &parallel_mesh, test_flags, p_format, 4) != 0 &&
+            same_mesh(&parallel_mesh, &serial_mesh) &&
+            parallel_mesh.position_offset == serial_mesh.position_offset && parallel_mesh.position_stride == serial_mesh.position_stride &&
+            parallel_mesh.texcoord_offset == serial_mesh.texcoord_offset && parallel_mesh.texcoord_stride == serial_mesh.texcoord_stride &&
+            parallel_mesh.normal_offset == serial_mesh.normal_offset && parallel_mesh.normal_stride == serial_mesh.normal_stride &&
+            parallel_mesh.tangent_offset == serial_mesh.tangent_offset && parallel_mesh.tangent_stride == serial_mesh.tangent_stride;
+        free(p_parallel_buffer);
+        free(p_serial_buffer);
+    }
+
+    free(p_buffer);
+    return same;
+}
+
+unsigned int check_batch_load(char** pp_files, unsigned int file_count)
+{
+    objpar_batch_item_t items[64];
+    objpar_batch_t batch;
+    batch_check_t check;
+    void* p_strings[8];
+    unsigned int item_count;
+    unsigned int i;
+    unsigned int same;
+
+    memset(&check, 0, sizeof(check));
+    check.p_expected = (objpar_model_t*)malloc(file_count * sizeof(objpar_model_t));
+    check.file_count = file_count;
+    same = file_count <= 8;
+    for (i = 0; i < file_count && same; ++i)
+    {
+        size_t file_size;
+
+        p_strings[i] = open_file(pp_files[i], &file_size);
+        same = objpar_load_model((const char*)p_strings[i], file_size, OBJPAR_MESH_INDEXED, NULL, NULL, &check.p_expected[i]);
+        items[i].p_path = NULL;
+        items[i].p_string = (const char*)p_strings[i];
+        items[i].string_size = file_size;
+    }
+
+    /* Every file is listed a few times with missing files in between, a
+       file that can't be read must not stop the others */
+    item_count = 0;
+    while (same && item_count + file_count + 1 <= 64)
+    {
+        for (i = 0; i < file_count; ++i)
+            items[item_count++] = items[i];
+        items[item_count].p_path = "data/missing.obj";
+        items[item_count].p_string = NULL;
+        items[item_count].string_size = 0;
+        item_count += 1;
+    }
+
+    memset(&batch, 0, sizeof(batch));
+    batch.p_items = items;
+    batch.item_count = item_count;
+    batch.thread_count = 4;
+    batch.flags = OBJPAR_MESH_INDEXED;
+    batch.p_user_data = &check;
+    batch.p_complete = batch_complete;
+    if (same)
+        same = objpar_batch_load(&batch) == item_count - item_count / (file_count + 1);
+
+    for (i = 0; i < item_count && same; ++i)
+    {
+        unsigned int expected = (i % (file_count + 1) == file_count ? OBJPAR_LOAD_READ_ERROR : OBJPAR_LOAD_OK);
+        same = check.reports[i] == 1 && check.statuses[i] == expected && check.same[i];
+    }
+
+    for (i = 0; i < file_count; ++i)
+    {
+        objpar_free_model(NULL, &check.p_expected[i]);
+        free(p_strings[i]);
+    }
+    free(check.p_expected);
+    return same;
+}
+
+void batch_complete(void* p_user_data, unsigned int item, unsigned int status, objpar_model_t* p_model)
+{
+    batch_check_t* p_check = (batch_check_t*)p_user_data;
+    unsigned int file = item % (p_check->file_count + 1);
+
+    /* Each item is reported by one worker only, so the slots aren't shared */
+    p_check->reports[item] += 1;
+    p_check->statuses[item] = status;
+    if (status == OBJPAR_LOAD_OK)
+        p_check->same[item] = file < p_check->file_count && same_mesh(&p_model->mesh, &p_check->p_expected[file].mesh);
+    else
+        p_check->same[item] = 1;
+}
+#endif
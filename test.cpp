@@ -0,0 +1,162 @@
+/* Builds the sample files with objpar.hpp and compares every vertex,
+   index and submesh with objpar_build_mesh_ex. Compile it as C++11 or
+   later from the repository root, like test.c. */
+#include "objpar.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+typedef objpar_cpp::vertex<objpar_cpp::pos3, objpar_cpp::uv2, objpar_cpp::norm3, objpar_cpp::tan4> full_vertex_t;
+typedef objpar_cpp::vertex<objpar_cpp::pos4, objpar_cpp::norm3> position_vertex_t;
+
+static_assert(sizeof(full_vertex_t) == 12 * sizeof(float), "vertices have no padding");
+
+/* Checks width floats of an attribute against the float attribute of the
+   C mesh, narrower and missing ones are zero padded and the w of a pos4
+   read from 3 components is 1. */
+bool same_attribute(const float* p_values, unsigned int width, const objpar_mesh& c_mesh, int attribute_offset, unsigned int source_width, unsigned int vertex, bool position)
+{
+    const float* p_source = nullptr;
+
+    if (attribute_offset < 0)
+        source_width = 0;
+    else
+        p_source = reinterpret_cast<const float*>(static_cast<const char*>(c_mesh.p_vertices) + attribute_offset + (std::size_t)vertex * c_mesh.vertex_stride);
+
+    for (unsigned int i = 0; i < width; ++i)
+    {
+        float expected = (i < source_width ? p_source[i] : 0.0f);
+        if (position && width == 4 && source_width == 3 && i == 3)
+            expected = 1.0f;
+        if (std::memcmp(&p_values[i], &expected, sizeof(float)) != 0)
+            return false;
+    }
+    return true;
+}
+
+template <typename V>
+bool same_topology(const objpar_cpp::mesh<V>& cpp_mesh, const objpar_mesh& c_mesh)
+{
+    if (cpp_mesh.vertices().size() != c_mesh.vertex_count || cpp_mesh.indices().size() != c_mesh.index_count ||
+        cpp_mesh.submeshes().size() != c_mesh.submesh_count)
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < c_mesh.index_count; ++i)
+    {
+        unsigned int index = (c_mesh.index_size == sizeof(unsigned short) ?
+            static_cast<const unsigned short*>(c_mesh.p_indices)[i] : static_cast<const unsigned int*>(c_mesh.p_indices)[i]);
+        if (cpp_mesh.indices()[i] != index)
+            return false;
+    }
+    for (unsigned int i = 0; i < c_mesh.submesh_count; ++i)
+    {
+        if (cpp_mesh.submeshes()[i].first != c_mesh.p_submeshes[i].first ||
+            cpp_mesh.submeshes()[i].count != c_mesh.p_submeshes[i].count ||
+            cpp_mesh.submeshes()[i].material != c_mesh.p_submeshes[i].material)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool check_build_mesh(const objpar_data& data, unsigned int flags)
+{
+    std::vector<char> buffer(objpar_get_mesh_ex_size(&data, flags, nullptr));
+    objpar_mesh c_mesh;
+    unsigned int normal_width;
+
+    if (buffer.empty() || !objpar_build_mesh_ex(&data, buffer.data(), &c_mesh, flags, nullptr))
+        return objpar_cpp::build_mesh<full_vertex_t>(data, flags).empty();
+
+    objpar_cpp::mesh<full_vertex_t> full_mesh = objpar_cpp::build_mesh<full_vertex_t>(data, flags);
+    objpar_cpp::mesh<position_vertex_t> position_mesh = objpar_cpp::build_mesh<position_vertex_t>(data, flags);
+    if (!same_topology(full_mesh, c_mesh) || !same_topology(position_mesh, c_mesh))
+        return false;
+
+    normal_width = (data.normal_count > 0 ? data.normal_width : 3);
+    for (unsigned int vertex = 0; vertex < c_mesh.vertex_count; ++vertex)
+    {
+        const full_vertex_t& full = full_mesh.vertices()[vertex];
+        const position_vertex_t& position = position_mesh.vertices()[vertex];
+
+        if (!same_attribute(full.position, 3, c_mesh, c_mesh.position_offset, data.position_width, vertex, true) ||
+            !same_attribute(full.texcoord, 2, c_mesh, c_mesh.texcoord_offset, data.texcoord_width, vertex, false) ||
+            !same_attribute(full.normal, 3, c_mesh, c_mesh.normal_offset, normal_width, vertex, false) ||
+            !same_attribute(full.tangent, 4, c_mesh, c_mesh.tangent_offset, 4, vertex, false) ||
+            !same_attribute(position.position, 4, c_mesh, c_mesh.position_offset, data.position_width, vertex, true) ||
+            !same_attribute(position.normal, 3, c_mesh, c_mesh.normal_offset, normal_width, vertex, false))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    static const char* files[] = {
+        "data/plane.obj",
+        "data/cube.obj",
+        "data/cube_nontri.obj",
+        "data/monkey.obj",
+        "data/teapot.obj",
+        "data/groups.obj"
+    };
+    static const unsigned int flags[] = {
+        0,
+        OBJPAR_MESH_INDEXED,
+        OBJPAR_MESH_INDEXED | OBJPAR_MESH_EAR_CLIP,
+        OBJPAR_MESH_GENERATE_NORMALS,
+        OBJPAR_MESH_INDEXED | OBJPAR_MESH_GENERATE_NORMALS | OBJPAR_MESH_GENERATE_TANGENTS
+    };
+    unsigned int failure_count = 0;
+
+    if (objpar_cpp::offset<full_vertex_t, objpar_cpp::norm3>() != 5 * sizeof(float) ||
+        objpar_cpp::offset<full_vertex_t, objpar_cpp::tan4>() != 8 * sizeof(float))
+    {
+        std::printf("FAILED: attribute offsets don't follow the declaration order\n");
+        failure_count += 1;
+    }
+
+    for (const char* p_file_name : files)
+    {
+        std::ifstream file(p_file_name, std::ios::binary);
+        std::vector<char> text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::vector<char> buffer(objpar_get_size(text.data(), text.size()));
+        objpar_data data;
+        bool rejected;
+
+        objpar(text.data(), text.size(), buffer.data(), &data);
+        for (unsigned int test_flags : flags)
+        {
+            if (!check_build_mesh(data, test_flags))
+            {
+                std::printf("FAILED: objpar_cpp::build_mesh with flags 0x%x differs from objpar_build_mesh_ex on %s\n", test_flags, p_file_name);
+                failure_count += 1;
+            }
+        }
+
+        rejected = false;
+        try
+        {
+            objpar_cpp::build_mesh<full_vertex_t>(data, OBJPAR_MESH_DEINTERLEAVE);
+        }
+        catch (const std::invalid_argument&)
+        {
+            rejected = true;
+        }
+        if (!rejected)
+        {
+            std::printf("FAILED: objpar_cpp::build_mesh accepted OBJPAR_MESH_DEINTERLEAVE on %s\n", p_file_name);
+            failure_count += 1;
+        }
+    }
+
+    return failure_count > 0 ? 1 : 0;
+}